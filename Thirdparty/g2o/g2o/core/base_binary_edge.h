@@ -29,6 +29,7 @@
 
 #include <iostream>
 #include <limits>
+#include <algorithm>
 
 #include "base_edge.h"
 #include "robust_kernel.h"
@@ -90,6 +91,8 @@ namespace g2o {
 
       virtual void constructQuadraticForm() ;
 
+      virtual void constructQuadraticForm(double* const* A, double* const* b, double* const* H);
+
       virtual void mapHessianMemory(double* d, int i, int j, bool rowMajor);
 
       using BaseEdge<D,E>::resize;
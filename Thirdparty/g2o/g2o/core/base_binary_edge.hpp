@@ -57,6 +57,31 @@ void BaseBinaryEdge<D, E, VertexXiType, VertexXjType>::constructQuadraticForm()
   VertexXiType* from = static_cast<VertexXiType*>(_vertices[0]);
   VertexXjType* to   = static_cast<VertexXjType*>(_vertices[1]);
 
+  bool fromNotFixed = !(from->fixed());
+  bool toNotFixed = !(to->fixed());
+
+  if (fromNotFixed || toNotFixed) {
+    double* const A[2] = {from->A().data(), to->A().data()};
+    double* const b[2] = {from->b().data(), to->b().data()};
+    double* const H[1] = {_hessianRowMajor ? _hessianTransposed.data() : _hessian.data()};
+#ifdef G2O_OPENMP
+    from->lockQuadraticForm();
+    to->lockQuadraticForm();
+#endif
+    constructQuadraticForm(A, b, H);
+#ifdef G2O_OPENMP
+    to->unlockQuadraticForm();
+    from->unlockQuadraticForm();
+#endif
+  }
+}
+
+template <int D, typename E, typename VertexXiType, typename VertexXjType>
+void BaseBinaryEdge<D, E, VertexXiType, VertexXjType>::constructQuadraticForm(double* const* A_, double* const* b_, double* const* H_)
+{
+  VertexXiType* from = static_cast<VertexXiType*>(_vertices[0]);
+  VertexXjType* to   = static_cast<VertexXjType*>(_vertices[1]);
+
   // get the Jacobian of the nodes in the manifold domain
   const JacobianXiOplusType& A = jacobianOplusXi();
   const JacobianXjOplusType& B = jacobianOplusXj();
@@ -66,27 +91,30 @@ void BaseBinaryEdge<D, E, VertexXiType, VertexXjType>::constructQuadraticForm()
   bool toNotFixed = !(to->fixed());
 
   if (fromNotFixed || toNotFixed) {
-#ifdef G2O_OPENMP
-    from->lockQuadraticForm();
-    to->lockQuadraticForm();
-#endif
+    typename VertexXiType::HessianBlockType fromA(A_[0], Di, Di);
+    typename VertexXjType::HessianBlockType toA(A_[1], Dj, Dj);
+    Eigen::Map<Matrix<double, Di, 1> > fromB(b_[0]);
+    Eigen::Map<Matrix<double, Dj, 1> > toB(b_[1]);
+    HessianBlockType hessian(H_[0], Di, Dj);
+    HessianBlockTransposedType hessianTransposed(H_[0], Dj, Di);
+
     const InformationType& omega = _information;
     Matrix<double, D, 1> omega_r = - omega * _error;
     if (this->robustKernel() == 0) {
       if (fromNotFixed) {
         Matrix<double, VertexXiType::Dimension, D> AtO = A.transpose() * omega;
-        from->b().noalias() += A.transpose() * omega_r;
-        from->A().noalias() += AtO*A;
+        fromB.noalias() += A.transpose() * omega_r;
+        fromA.noalias() += AtO*A;
         if (toNotFixed ) {
           if (_hessianRowMajor) // we have to write to the block as transposed
-            _hessianTransposed.noalias() += B.transpose() * AtO.transpose();
+            hessianTransposed.noalias() += B.transpose() * AtO.transpose();
           else
-            _hessian.noalias() += AtO * B;
+            hessian.noalias() += AtO * B;
         }
       } 
       if (toNotFixed) {
-        to->b().noalias() += B.transpose() * omega_r;
-        to->A().noalias() += B.transpose() * omega * B;
+        toB.noalias() += B.transpose() * omega_r;
+        toA.noalias() += B.transpose() * omega * B;
       }
     } else { // robust (weighted) error according to some kernel
       double error = this->chi2();
@@ -98,24 +126,20 @@ void BaseBinaryEdge<D, E, VertexXiType, VertexXjType>::constructQuadraticForm()
 
       omega_r *= rho[1];
       if (fromNotFixed) {
-        from->b().noalias() += A.transpose() * omega_r;
-        from->A().noalias() += A.transpose() * weightedOmega * A;
+        fromB.noalias() += A.transpose() * omega_r;
+        fromA.noalias() += A.transpose() * weightedOmega * A;
         if (toNotFixed ) {
           if (_hessianRowMajor) // we have to write to the block as transposed
-            _hessianTransposed.noalias() += B.transpose() * weightedOmega * A;
+            hessianTransposed.noalias() += B.transpose() * weightedOmega * A;
           else
-            _hessian.noalias() += A.transpose() * weightedOmega * B;
+            hessian.noalias() += A.transpose() * weightedOmega * B;
         }
       } 
       if (toNotFixed) {
-        to->b().noalias() += B.transpose() * omega_r;
-        to->A().noalias() += B.transpose() * weightedOmega * B;
+        toB.noalias() += B.transpose() * omega_r;
+        toA.noalias() += B.transpose() * weightedOmega * B;
       }
     }
-#ifdef G2O_OPENMP
-    to->unlockQuadraticForm();
-    from->unlockQuadraticForm();
-#endif
   }
 }
 
@@ -139,10 +163,14 @@ void BaseBinaryEdge<D, E, VertexXiType, VertexXjType>::linearizeOplus()
   if (!iNotFixed && !jNotFixed)
     return;
 
-#ifdef G2O_OPENMP
-  vi->lockQuadraticForm();
-  vj->lockQuadraticForm();
-#endif
+  // the vertices are perturbed in place, lock them in a fixed order
+  OptimizableGraph::Vertex* first = vi;
+  OptimizableGraph::Vertex* second = vj;
+  if (second < first)
+    std::swap(first, second);
+  first->lockEstimate();
+  if (second != first)
+    second->lockEstimate();
 
   const double delta = 1e-9;
   const double scalar = 1.0 / (2*delta);
@@ -198,10 +226,9 @@ void BaseBinaryEdge<D, E, VertexXiType, VertexXjType>::linearizeOplus()
   } // end dimension
 
   _error = errorBeforeNumeric;
-#ifdef G2O_OPENMP
-  vj->unlockQuadraticForm();
-  vi->unlockQuadraticForm();
-#endif
+  if (second != first)
+    second->unlockEstimate();
+  first->unlockEstimate();
 }
 
 template <int D, typename E, typename VertexXiType, typename VertexXjType>
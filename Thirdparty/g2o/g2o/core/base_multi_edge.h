@@ -30,6 +30,7 @@
 #include <iostream>
 #include <iomanip>
 #include <limits>
+#include <algorithm>
 
 #include <Eigen/StdVector>
 
@@ -86,6 +87,8 @@ namespace g2o {
 
       virtual void constructQuadraticForm() ;
 
+      virtual void constructQuadraticForm(double* const* A, double* const* b, double* const* H);
+
       virtual void mapHessianMemory(double* d, int i, int j, bool rowMajor);
 
       using BaseEdge<D,E>::computeError;
@@ -100,7 +103,9 @@ namespace g2o {
       std::vector<HessianHelper> _hessian;
       std::vector<JacobianType, aligned_allocator<JacobianType> > _jacobianOplus; ///< jacobians of the edge (w.r.t. oplus)
 
-      void computeQuadraticForm(const InformationType& omega, const ErrorVector& weightedError);
+      //! adds the quadratic form to A_, b_ and H_ as in constructQuadraticForm(A, b, H), or to the Hessian if A_ is 0
+      void computeQuadraticForm(const InformationType& omega, const ErrorVector& weightedError,
+          double* const* A_ = 0, double* const* b_ = 0, double* const* H_ = 0);
 
     public:
       EIGEN_MAKE_ALIGNED_OPERATOR_NEW
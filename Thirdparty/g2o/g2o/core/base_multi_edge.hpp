@@ -34,6 +34,12 @@ namespace internal {
 
 template <int D, typename E>
 void BaseMultiEdge<D, E>::constructQuadraticForm()
+{
+  constructQuadraticForm(0, 0, 0);
+}
+
+template <int D, typename E>
+void BaseMultiEdge<D, E>::constructQuadraticForm(double* const* A_, double* const* b_, double* const* H_)
 {
   if (this->robustKernel()) {
     double error = this->chi2();
@@ -41,9 +47,9 @@ void BaseMultiEdge<D, E>::constructQuadraticForm()
     this->robustKernel()->robustify(error, rho);
     Matrix<double, D, 1> omega_r = - _information * _error;
     omega_r *= rho[1];
-    computeQuadraticForm(this->robustInformation(rho), omega_r);
+    computeQuadraticForm(this->robustInformation(rho), omega_r, A_, b_, H_);
   } else {
-    computeQuadraticForm(_information, - _information * _error);
+    computeQuadraticForm(_information, - _information * _error, A_, b_, H_);
   }
 }
 
@@ -62,12 +68,14 @@ void BaseMultiEdge<D, E>::linearizeOplus(JacobianWorkspace& jacobianWorkspace)
 template <int D, typename E>
 void BaseMultiEdge<D, E>::linearizeOplus()
 {
-#ifdef G2O_OPENMP
-  for (size_t i = 0; i < _vertices.size(); ++i) {
-    OptimizableGraph::Vertex* v = static_cast<OptimizableGraph::Vertex*>(_vertices[i]);
-    v->lockQuadraticForm();
-  }
-#endif
+  // the vertices are perturbed in place, lock them in a fixed order
+  std::vector<OptimizableGraph::Vertex*> lockOrder(_vertices.size());
+  for (size_t i = 0; i < _vertices.size(); ++i)
+    lockOrder[i] = static_cast<OptimizableGraph::Vertex*>(_vertices[i]);
+  std::sort(lockOrder.begin(), lockOrder.end());
+  lockOrder.erase(std::unique(lockOrder.begin(), lockOrder.end()), lockOrder.end());
+  for (size_t i = 0; i < lockOrder.size(); ++i)
+    lockOrder[i]->lockEstimate();
 
   const double delta = 1e-9;
   const double scalar = 1.0 / (2*delta);
@@ -116,12 +124,8 @@ void BaseMultiEdge<D, E>::linearizeOplus()
   }
   _error = errorBeforeNumeric;
 
-#ifdef G2O_OPENMP
-  for (int i = (int)(_vertices.size()) - 1; i >= 0; --i) {
-    OptimizableGraph::Vertex* v = static_cast<OptimizableGraph::Vertex*>(_vertices[i]);
-    v->unlockQuadraticForm();
-  }
-#endif
+  for (int i = (int)(lockOrder.size()) - 1; i >= 0; --i)
+    lockOrder[i]->unlockEstimate();
 
 }
 
@@ -168,8 +172,10 @@ bool BaseMultiEdge<D, E>::allVerticesFixed() const
 }
 
 template <int D, typename E>
-void BaseMultiEdge<D, E>::computeQuadraticForm(const InformationType& omega, const ErrorVector& weightedError)
+void BaseMultiEdge<D, E>::computeQuadraticForm(const InformationType& omega, const ErrorVector& weightedError,
+    double* const* A_, double* const* b_, double* const* H_)
 {
+  const bool external = A_ != 0;
   for (size_t i = 0; i < _vertices.size(); ++i) {
     OptimizableGraph::Vertex* from = static_cast<OptimizableGraph::Vertex*>(_vertices[i]);
     bool istatus = !(from->fixed());
@@ -180,12 +186,13 @@ void BaseMultiEdge<D, E>::computeQuadraticForm(const InformationType& omega, con
       MatrixXd AtO = A.transpose() * omega;
       int fromDim = from->dimension();
       assert(fromDim >= 0);
-      Eigen::Map<MatrixXd> fromMap(from->hessianData(), fromDim, fromDim);
-      Eigen::Map<VectorXd> fromB(from->bData(), fromDim);
+      Eigen::Map<MatrixXd> fromMap(external ? A_[i] : from->hessianData(), fromDim, fromDim);
+      Eigen::Map<VectorXd> fromB(external ? b_[i] : from->bData(), fromDim);
 
       // ii block in the hessian
 #ifdef G2O_OPENMP
-      from->lockQuadraticForm();
+      if (!external)
+        from->lockQuadraticForm();
 #endif
       fromMap.noalias() += AtO * A;
       fromB.noalias() += A.transpose() * weightedError;
@@ -194,7 +201,8 @@ void BaseMultiEdge<D, E>::computeQuadraticForm(const InformationType& omega, con
       for (size_t j = i+1; j < _vertices.size(); ++j) {
         OptimizableGraph::Vertex* to = static_cast<OptimizableGraph::Vertex*>(_vertices[j]);
 #ifdef G2O_OPENMP
-        to->lockQuadraticForm();
+        if (!external)
+          to->lockQuadraticForm();
 #endif
         bool jstatus = !(to->fixed());
         if (jstatus) {
@@ -202,19 +210,22 @@ void BaseMultiEdge<D, E>::computeQuadraticForm(const InformationType& omega, con
           int idx = internal::computeUpperTriangleIndex(i, j);
           assert(idx < (int)_hessian.size());
           HessianHelper& hhelper = _hessian[idx];
+          HessianBlockType hessian(external ? H_[idx] : hhelper.matrix.data(), hhelper.matrix.rows(), hhelper.matrix.cols());
           if (hhelper.transposed) { // we have to write to the block as transposed
-            hhelper.matrix.noalias() += B.transpose() * AtO.transpose();
+            hessian.noalias() += B.transpose() * AtO.transpose();
           } else {
-            hhelper.matrix.noalias() += AtO * B;
+            hessian.noalias() += AtO * B;
           }
         }
 #ifdef G2O_OPENMP
-        to->unlockQuadraticForm();
+        if (!external)
+          to->unlockQuadraticForm();
 #endif
       }
 
 #ifdef G2O_OPENMP
-      from->unlockQuadraticForm();
+      if (!external)
+        from->unlockQuadraticForm();
 #endif
     }
 
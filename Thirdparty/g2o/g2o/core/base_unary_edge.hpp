@@ -44,30 +44,45 @@ void BaseUnaryEdge<D, E, VertexXiType>::constructQuadraticForm()
 {
   VertexXiType* from=static_cast<VertexXiType*>(_vertices[0]);
 
+  bool istatus = !from->fixed();
+  if (istatus) {
+    double* const A[1] = {from->A().data()};
+    double* const b[1] = {from->b().data()};
+#ifdef G2O_OPENMP
+    from->lockQuadraticForm();
+#endif
+    constructQuadraticForm(A, b, 0);
+#ifdef G2O_OPENMP
+    from->unlockQuadraticForm();
+#endif
+  }
+}
+
+template <int D, typename E, typename VertexXiType>
+void BaseUnaryEdge<D, E, VertexXiType>::constructQuadraticForm(double* const* A_, double* const* b_, double* const*)
+{
+  VertexXiType* from=static_cast<VertexXiType*>(_vertices[0]);
+
   // chain rule to get the Jacobian of the nodes in the manifold domain
   const JacobianXiOplusType& A = jacobianOplusXi();
   const InformationType& omega = _information;
 
   bool istatus = !from->fixed();
   if (istatus) {
-#ifdef G2O_OPENMP
-    from->lockQuadraticForm();
-#endif
+    typename VertexXiType::HessianBlockType fromA(A_[0], VertexXiType::Dimension, VertexXiType::Dimension);
+    Eigen::Map<Matrix<double, VertexXiType::Dimension, 1> > fromB(b_[0]);
     if (this->robustKernel()) {
       double error = this->chi2();
       Eigen::Vector3d rho;
       this->robustKernel()->robustify(error, rho);
       InformationType weightedOmega = this->robustInformation(rho);
 
-      from->b().noalias() -= rho[1] * A.transpose() * omega * _error;
-      from->A().noalias() += A.transpose() * weightedOmega * A;
+      fromB.noalias() -= rho[1] * A.transpose() * omega * _error;
+      fromA.noalias() += A.transpose() * weightedOmega * A;
     } else {
-      from->b().noalias() -= A.transpose() * omega * _error;
-      from->A().noalias() += A.transpose() * omega * A;
+      fromB.noalias() -= A.transpose() * omega * _error;
+      fromA.noalias() += A.transpose() * omega * A;
     }
-#ifdef G2O_OPENMP
-    from->unlockQuadraticForm();
-#endif
   }
 }
 
@@ -87,9 +102,8 @@ void BaseUnaryEdge<D, E, VertexXiType>::linearizeOplus()
   if (vi->fixed())
     return;
 
-#ifdef G2O_OPENMP
-  vi->lockQuadraticForm();
-#endif
+  // the vertex is perturbed in place
+  vi->lockEstimate();
 
   const double delta = 1e-9;
   const double scalar = 1.0 / (2*delta);
@@ -117,9 +131,7 @@ void BaseUnaryEdge<D, E, VertexXiType>::linearizeOplus()
   } // end dimension
 
   _error = errorBeforeNumeric;
-#ifdef G2O_OPENMP
-  vi->unlockQuadraticForm();
-#endif
+  vi->unlockEstimate();
 }
 
 template <int D, typename E, typename VertexXiType>
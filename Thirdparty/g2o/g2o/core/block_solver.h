@@ -32,6 +32,7 @@
 #include "sparse_block_matrix.h"
 #include "sparse_block_matrix_diagonal.h"
 #include "openmp_mutex.h"
+#include "parallel_linearizer.h"
 #include "../../config.h"
 
 namespace g2o {
@@ -166,6 +167,8 @@ namespace g2o {
       std::vector<OpenMPMutex> _coefficientsMutex;
 #    endif
 
+      ParallelLinearizer _parallelLinearizer;
+
       bool _doSchur;
 
       double* _coefficients;
@@ -33,6 +33,7 @@
 #include <limits>
 #include <cmath>
 #include <typeinfo>
+#include <mutex>
 
 #include "openmp_mutex.h"
 #include "hyper_graph.h"
@@ -336,6 +337,17 @@ namespace g2o {
          */
         void unlockQuadraticForm() { _quadraticFormMutex.unlock();}
 
+        /**
+         * lock for the estimate of this vertex, held while it is perturbed in place by the numeric
+         * differentiation of an edge, so that edges sharing it can be linearized by several threads.
+         * Edges of one optimization are expected to be either all numeric or all analytic
+         */
+        void lockEstimate() { _estimateMutex.lock();}
+        /**
+         * unlock the estimate of this vertex
+         */
+        void unlockEstimate() { _estimateMutex.unlock();}
+
         //! read the vertex from a stream, i.e., the internal state of the vertex
         virtual bool read(std::istream& is) = 0;
         //! write the vertex to a stream
@@ -353,6 +365,7 @@ namespace g2o {
         int _dimension;
         int _colInHessian;
         OpenMPMutex _quadraticFormMutex;
+        std::mutex _estimateMutex;
 
         CacheContainer* _cacheContainer;
 
@@ -437,6 +450,15 @@ namespace g2o {
          */
         virtual void constructQuadraticForm() = 0;
 
+        /**
+         * Same as constructQuadraticForm(), but the blocks are added to the given memory instead of
+         * the one of the vertices and the one mapped by mapHessianMemory: A[i] and b[i] receive the
+         * Hessian block and the b vector of vertex i, H[k] the off diagonal block of the vertices
+         * i < j with k = j*(j-1)/2 + i, in the layout given to mapHessianMemory. Entries of fixed
+         * vertices are not used. Takes no lock.
+         */
+        virtual void constructQuadraticForm(double* const* A, double* const* b, double* const* H) = 0;
+
         /**
          * maps the internal matrix to some external memory location,
          * you need to provide the memory before calling constructQuadraticForm
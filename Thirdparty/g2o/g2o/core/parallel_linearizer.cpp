@@ -0,0 +1,228 @@
+// g2o - General Graph Optimization
+// Copyright (C) 2011 R. Kuemmerle, G. Grisetti, W. Burgard
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+// IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+// TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "parallel_linearizer.h"
+
+#include <algorithm>
+#include <cassert>
+
+#include "sparse_optimizer.h"
+
+using namespace std;
+
+namespace g2o {
+
+namespace {
+  // blocks in the buffers start on 32 byte boundaries, as the Hessian blocks may be mapped aligned
+  inline int alignedSize(int size)
+  {
+    return (size + 3) & ~3;
+  }
+
+  struct BlockDataCompare
+  {
+    template <typename Block>
+    bool operator() (const Block& b1, const Block& b2) const
+    {
+      return b1.data < b2.data;
+    }
+  };
+}
+
+ParallelLinearizer::ParallelLinearizer() :
+  _valid(false), _numEdges(0), _numChunks(0), _bufferSize(0)
+{
+}
+
+void ParallelLinearizer::resize(int numEdges)
+{
+  _valid = true;
+  _numEdges = numEdges;
+  _offDiagonalBlocks.clear();
+  _numChunks = 0;
+}
+
+void ParallelLinearizer::setOffDiagonalBlock(int k, int i, int j, double* block, int size)
+{
+  assert(i < j);
+  OffDiagonalBlock b;
+  b.edge = k;
+  b.pair = ((j-1) * j) / 2 + i;
+  b.data = block;
+  b.size = size;
+  b.offset = -1;
+  _offDiagonalBlocks.push_back(b);
+}
+
+void ParallelLinearizer::buildPlan(SparseOptimizer* optimizer, int numChunks)
+{
+  const SparseOptimizer::EdgeContainer& edges = optimizer->activeEdges();
+  const SparseOptimizer::VertexContainer& vertices = optimizer->indexMapping();
+
+  _numChunks = numChunks;
+  _chunkBegin.resize(numChunks + 1);
+  vector<int> edgeChunk(_numEdges);
+  for (int c = 0; c <= numChunks; ++c)
+    _chunkBegin[c] = static_cast<int>(static_cast<long>(_numEdges) * c / numChunks);
+  for (int c = 0; c < numChunks; ++c)
+    fill(edgeChunk.begin() + _chunkBegin[c], edgeChunk.begin() + _chunkBegin[c+1], c);
+
+  // chunk writing to the quadratic form of each vertex, -2 if several do
+  vector<int> vertexChunk(vertices.size(), -1);
+  _targetBegin.resize(_numEdges + 1);
+  int numTargets = 0;
+  for (int k = 0; k < _numEdges; ++k) {
+    const OptimizableGraph::Edge* e = edges[k];
+    const int n = static_cast<int>(e->vertices().size());
+    _targetBegin[k] = numTargets;
+    numTargets += 2*n + (n * (n-1)) / 2;
+    for (int i = 0; i < n; ++i) {
+      const OptimizableGraph::Vertex* v = static_cast<const OptimizableGraph::Vertex*>(e->vertex(i));
+      const int h = v->hessianIndex();
+      if (h < 0)
+        continue;
+      if (vertexChunk[h] == -1)
+        vertexChunk[h] = edgeChunk[k];
+      else if (vertexChunk[h] != edgeChunk[k])
+        vertexChunk[h] = -2;
+    }
+  }
+  _targetBegin[_numEdges] = numTargets;
+
+  // place of the shared quadratic forms in the buffers, b follows A
+  _sharedBlocks.clear();
+  _bufferSize = 0;
+  vector<int> vertexOffset(vertices.size(), -1);
+  for (size_t h = 0; h < vertices.size(); ++h) {
+    if (vertexChunk[h] != -2)
+      continue;
+    OptimizableGraph::Vertex* v = vertices[h];
+    const int dim = v->dimension();
+    SharedBlock A = {v->hessianData(), dim * dim, _bufferSize};
+    SharedBlock b = {v->bData(), dim, _bufferSize + alignedSize(dim * dim)};
+    _sharedBlocks.push_back(A);
+    _sharedBlocks.push_back(b);
+    vertexOffset[h] = _bufferSize;
+    _bufferSize += alignedSize(dim * dim) + alignedSize(dim);
+  }
+
+  // off diagonal blocks are shared if edges of several chunks map to them
+  vector<OffDiagonalBlock> sortedBlocks(_offDiagonalBlocks);
+  sort(sortedBlocks.begin(), sortedBlocks.end(), BlockDataCompare());
+  for (size_t s = 0; s < sortedBlocks.size(); ) {
+    size_t end = s + 1;
+    bool shared = false;
+    while (end < sortedBlocks.size() && sortedBlocks[end].data == sortedBlocks[s].data) {
+      shared = shared || edgeChunk[sortedBlocks[end].edge] != edgeChunk[sortedBlocks[s].edge];
+      ++end;
+    }
+    if (shared) {
+      SharedBlock H = {sortedBlocks[s].data, sortedBlocks[s].size, _bufferSize};
+      _sharedBlocks.push_back(H);
+      for (size_t t = s; t < end; ++t)
+        sortedBlocks[t].offset = _bufferSize;
+      _bufferSize += alignedSize(sortedBlocks[s].size);
+    }
+    s = end;
+  }
+
+  _buffers.resize(numChunks);
+  for (int c = 0; c < numChunks; ++c)
+    _buffers[c].assign(_bufferSize, 0.);
+  _workspaces.assign(numChunks, optimizer->jacobianWorkspace());
+
+  // where each edge writes its quadratic form
+  _targets.assign(numTargets, 0);
+  for (int k = 0; k < _numEdges; ++k) {
+    OptimizableGraph::Edge* e = edges[k];
+    const int n = static_cast<int>(e->vertices().size());
+    double* buffer = _buffers[edgeChunk[k]].data();
+    double** A = &_targets[_targetBegin[k]];
+    double** b = A + n;
+    for (int i = 0; i < n; ++i) {
+      OptimizableGraph::Vertex* v = static_cast<OptimizableGraph::Vertex*>(e->vertex(i));
+      const int h = v->hessianIndex();
+      if (h < 0)
+        continue;
+      if (vertexOffset[h] >= 0) {
+        A[i] = buffer + vertexOffset[h];
+        b[i] = buffer + vertexOffset[h] + alignedSize(v->dimension() * v->dimension());
+      } else {
+        A[i] = v->hessianData();
+        b[i] = v->bData();
+      }
+    }
+  }
+  for (size_t s = 0; s < sortedBlocks.size(); ++s) {
+    const OffDiagonalBlock& block = sortedBlocks[s];
+    double** H = &_targets[_targetBegin[block.edge]] + 2 * edges[block.edge]->vertices().size();
+    if (block.offset >= 0)
+      H[block.pair] = _buffers[edgeChunk[block.edge]].data() + block.offset;
+    else
+      H[block.pair] = block.data;
+  }
+}
+
+bool ParallelLinearizer::linearize(SparseOptimizer* optimizer)
+{
+  const SparseOptimizer::EdgeContainer& edges = optimizer->activeEdges();
+  const int numChunks = optimizer->numThreads();
+  if (! _valid || numChunks <= 1 || static_cast<int>(edges.size()) != _numEdges)
+    return false;
+
+  if (numChunks != _numChunks)
+    buildPlan(optimizer, numChunks);
+
+  optimizer->parallelFor()(numChunks, [this, &edges](int c) {
+    fill(_buffers[c].begin(), _buffers[c].end(), 0.);
+    JacobianWorkspace& jacobianWorkspace = _workspaces[c];
+    for (int k = _chunkBegin[c]; k < _chunkBegin[c+1]; ++k) {
+      OptimizableGraph::Edge* e = edges[k];
+      const int n = static_cast<int>(e->vertices().size());
+      double* const* targets = &_targets[_targetBegin[k]];
+      e->linearizeOplus(jacobianWorkspace);
+      e->constructQuadraticForm(targets, targets + n, targets + 2*n);
+    }
+  });
+
+  // sum up the shared blocks, in chunk order whatever thread ran them
+  const int numShared = static_cast<int>(_sharedBlocks.size());
+  optimizer->parallelFor()(numChunks, [this, numShared, numChunks](int c) {
+    const int end = static_cast<int>(static_cast<long>(numShared) * (c+1) / numChunks);
+    for (int s = static_cast<int>(static_cast<long>(numShared) * c / numChunks); s < end; ++s) {
+      const SharedBlock& block = _sharedBlocks[s];
+      for (int t = 0; t < numChunks; ++t) {
+        const double* src = _buffers[t].data() + block.offset;
+        for (int i = 0; i < block.size; ++i)
+          block.data[i] += src[i];
+      }
+    }
+  });
+
+  return true;
+}
+
+} // end namespace
@@ -0,0 +1,112 @@
+// g2o - General Graph Optimization
+// Copyright (C) 2011 R. Kuemmerle, G. Grisetti, W. Burgard
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+// IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+// TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef G2O_PARALLEL_LINEARIZER_H
+#define G2O_PARALLEL_LINEARIZER_H
+
+#include <vector>
+#include <Eigen/Core>
+
+#include "jacobian_workspace.h"
+
+namespace g2o {
+
+  class SparseOptimizer;
+
+  /**
+   * \brief linearizes the active edges of an optimizer in chunks run in parallel
+   *
+   * Each chunk is a range of consecutive active edges, linearized with its own Jacobian workspace.
+   * The Hessian blocks and b vectors touched by a single chunk are written in place. The ones
+   * shared by several chunks are accumulated in a buffer per chunk and summed up in chunk order
+   * afterwards, so the quadratic forms are built without locking.
+   */
+  class ParallelLinearizer
+  {
+    public:
+      ParallelLinearizer();
+
+      /**
+       * forgets the structure, to be called before the Hessian is mapped for the active edges
+       */
+      void resize(int numEdges);
+
+      /**
+       * records the off diagonal block mapped for the vertices i < j of the k-th active edge
+       * @param size: number of elements of the block
+       */
+      void setOffDiagonalBlock(int k, int i, int j, double* block, int size);
+
+      //! the recorded blocks no longer match the Hessian, linearize() fails until the next resize()
+      void invalidate() { _valid = false;}
+
+      /**
+       * linearizes the active edges of the optimizer and adds their quadratic forms to the
+       * Hessian and to the b vector of the vertices, in optimizer->numThreads() chunks.
+       * The blocks have to be cleared before.
+       * @returns false if the structure is not known, the caller then linearizes sequentially
+       */
+      bool linearize(SparseOptimizer* optimizer);
+
+    protected:
+      struct OffDiagonalBlock
+      {
+        int edge;
+        int pair;
+        double* data;
+        int size;
+        int offset;                             ///< place in the buffers if shared, -1 otherwise
+      };
+
+      //! a block shared by several chunks and its place in the buffers
+      struct SharedBlock
+      {
+        double* data;
+        int size;
+        int offset;
+      };
+
+      typedef std::vector<double, Eigen::aligned_allocator<double> > BufferType;
+
+      void buildPlan(SparseOptimizer* optimizer, int numChunks);
+
+      bool _valid;
+      int _numEdges;
+      std::vector<OffDiagonalBlock> _offDiagonalBlocks;
+
+      int _numChunks;                           ///< chunks of the current plan, 0 if not built
+      std::vector<int> _chunkBegin;             ///< first active edge of each chunk
+      std::vector<int> _targetBegin;            ///< first target of each edge
+      std::vector<double*> _targets;            ///< A, b of each vertex and H of each pair, per edge
+      std::vector<SharedBlock> _sharedBlocks;
+      int _bufferSize;
+      std::vector<BufferType> _buffers;
+      std::vector<JacobianWorkspace> _workspaces;
+  };
+
+} // end namespace
+
+#endif
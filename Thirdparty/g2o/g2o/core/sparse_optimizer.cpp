@@ -48,7 +48,7 @@ namespace g2o{
 
 
   SparseOptimizer::SparseOptimizer() :
-    _forceStopFlag(0), _verbose(false), _algorithm(0), _computeBatchStatistics(false)
+    _forceStopFlag(0), _verbose(false), _algorithm(0), _computeBatchStatistics(false), _numThreads(1)
   {
     _graphActions.resize(AT_NUM_ELEMENTS);
   }
@@ -67,12 +67,22 @@ namespace g2o{
         (*(*it))(this);
     }
 
+    if (_numThreads > 1 && _activeEdges.size() > 50) {
+      const int numEdges = static_cast<int>(_activeEdges.size());
+      const int numChunks = _numThreads;
+      _parallelFor(numChunks, [this, numEdges, numChunks](int c) {
+        const int end = static_cast<int>(static_cast<long>(numEdges) * (c+1) / numChunks);
+        for (int k = static_cast<int>(static_cast<long>(numEdges) * c / numChunks); k < end; ++k)
+          _activeEdges[k]->computeError();
+      });
+    } else {
 #   ifdef G2O_OPENMP
 #   pragma omp parallel for default (shared) if (_activeEdges.size() > 50)
 #   endif
-    for (int k = 0; k < static_cast<int>(_activeEdges.size()); ++k) {
-      OptimizableGraph::Edge* e = _activeEdges[k];
-      e->computeError();
+      for (int k = 0; k < static_cast<int>(_activeEdges.size()); ++k) {
+        OptimizableGraph::Edge* e = _activeEdges[k];
+        e->computeError();
+      }
     }
 
 #  ifndef NDEBUG
@@ -87,6 +97,12 @@ namespace g2o{
 
   }
 
+  void SparseOptimizer::setParallelFor(int numThreads, const ParallelFor& parallelFor)
+  {
+    _numThreads = parallelFor ? numThreads : 1;
+    _parallelFor = parallelFor;
+  }
+
   double SparseOptimizer::activeChi2( ) const
   {
     double chi = 0.0;
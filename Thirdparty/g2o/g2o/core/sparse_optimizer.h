@@ -34,6 +34,7 @@
 #include "batch_stats.h"
 
 #include <map>
+#include <functional>
 
 namespace g2o {
 
@@ -244,6 +245,19 @@ namespace g2o {
      */
     virtual void clear();
 
+    /**
+     * runs f(i) for every i in [0,n) and returns when all the calls are done, e.g., on a thread pool
+     */
+    typedef std::function<void(int, const std::function<void(int)>&)> ParallelFor;
+
+    /**
+     * splits the loops over the active edges (errors, Jacobians and quadratic forms) in numThreads
+     * chunks run through parallelFor. numThreads <= 1 (the default) runs them sequentially.
+     */
+    void setParallelFor(int numThreads, const ParallelFor& parallelFor);
+    int numThreads() const { return _numThreads;}
+    const ParallelFor& parallelFor() const { return _parallelFor;}
+
     /**
      * computes the error vectors of all edges in the activeSet, and caches them
      */
@@ -306,6 +320,9 @@ namespace g2o {
 
     BatchStatisticsContainer _batchStatistics;   ///< global statistics of the optimizer, e.g., timing, num-non-zeros
     bool _computeBatchStatistics;
+
+    int _numThreads;
+    ParallelFor _parallelFor;
   };
 } // end namespace
 
@@ -0,0 +1,108 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef DESCRIPTORSTORE_H
+#define DESCRIPTORSTORE_H
+
+#include<opencv2/core/core.hpp>
+
+#include<atomic>
+#include<cstring>
+#include<stdint.h>
+
+namespace ORB_SLAM2
+{
+
+// Descriptor matrices of Frames and KeyFrames: one contiguous block,
+// 32-byte aligned, one 32-byte row per keypoint.
+class DescriptorStore
+{
+public:
+
+    static const int DESCRIPTOR_BYTES = 32;
+    static const int ALIGNMENT = 32;
+
+    // N x 32 CV_8U matrix, continuous and aligned. It is a view of a larger
+    // reference counted buffer, so it can be shared and released like any cv::Mat.
+    static cv::Mat Allocate(int N);
+
+    // Deep copy into an aligned matrix
+    static cv::Mat Clone(const cv::Mat &Descriptors);
+
+    // Descriptors are not modified once extracted, so an aligned matrix is shared
+    // instead of copied. Others are cloned.
+    static cv::Mat Share(const cv::Mat &Descriptors);
+
+    static bool IsAligned(const cv::Mat &Descriptors);
+};
+
+// Descriptor of a MapPoint. A single writer (holding the MapPoint feature mutex)
+// updates it, readers copy it out without locking (sequence lock).
+class alignas(32) AtomicDescriptor
+{
+public:
+
+    AtomicDescriptor()
+    {
+        mnSeq.store(0,std::memory_order_relaxed);
+        for(int i=0; i<4; i++)
+            mWords[i].store(0,std::memory_order_relaxed);
+    }
+
+    void Store(const unsigned char* pDesc)
+    {
+        uint64_t w[4];
+        memcpy(w,pDesc,DescriptorStore::DESCRIPTOR_BYTES);
+
+        const unsigned int seq = mnSeq.load(std::memory_order_relaxed);
+        mnSeq.store(seq+1,std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for(int i=0; i<4; i++)
+            mWords[i].store(w[i],std::memory_order_relaxed);
+        mnSeq.store(seq+2,std::memory_order_release);
+    }
+
+    void Load(unsigned char* pDesc) const
+    {
+        uint64_t w[4];
+        unsigned int seq0, seq1;
+        do
+        {
+            seq0 = mnSeq.load(std::memory_order_acquire);
+            for(int i=0; i<4; i++)
+                w[i] = mWords[i].load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            seq1 = mnSeq.load(std::memory_order_relaxed);
+        }
+        while((seq0 & 1) || seq0!=seq1);
+
+        memcpy(pDesc,w,DescriptorStore::DESCRIPTOR_BYTES);
+    }
+
+protected:
+
+    std::atomic<uint64_t> mWords[4];
+    std::atomic<unsigned int> mnSeq;
+};
+
+} //namespace ORB_SLAM
+
+#endif // DESCRIPTORSTORE_H
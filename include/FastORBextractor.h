@@ -0,0 +1,59 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef FASTORBEXTRACTOR_H
+#define FASTORBEXTRACTOR_H
+
+#include "ORBextractor.h"
+
+
+namespace ORB_SLAM2
+{
+
+// Low-cost ORB backend for low-power platforms: at most MAX_LEVELS pyramid levels,
+// descriptors computed on the levels without Gaussian blur, and keypoints distributed
+// on a regular grid instead of the octree. Descriptors remain compatible with the
+// ORB vocabulary, at the price of less repeatable matches.
+class FastORBextractor : public ORBextractor
+{
+public:
+
+    static const int MAX_LEVELS = 4;
+
+    FastORBextractor(int nfeatures, float scaleFactor, int nlevels,
+                     int iniThFAST, int minThFAST);
+
+    virtual ~FastORBextractor(){}
+
+    virtual std::string GetBackend() const {
+        return FAST_BACKEND;
+    }
+
+protected:
+
+    // Keeps the strongest keypoint of each cell of a grid of about nFeatures cells
+    virtual std::vector<cv::KeyPoint> DistributeKeyPoints(const std::vector<cv::KeyPoint>& vToDistributeKeys, const int &minX,
+                                                          const int &maxX, const int &minY, const int &maxY, const int &nFeatures, const int &level);
+};
+
+} //namespace ORB_SLAM
+
+#endif // FASTORBEXTRACTOR_H
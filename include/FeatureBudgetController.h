@@ -0,0 +1,77 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef FEATUREBUDGETCONTROLLER_H
+#define FEATUREBUDGETCONTROLLER_H
+
+namespace ORB_SLAM2
+{
+
+// Closed-loop control of the number of features extracted per frame. The budget grows
+// quickly when tracking is weak (few inliers in the local map tracking) and shrinks slowly
+// while tracking is comfortable or the frame time exceeds its target. The initial FAST
+// threshold rises as the budget shrinks, so easy scenes also produce fewer candidates.
+class FeatureBudgetController
+{
+public:
+
+    FeatureBudgetController(int nMinFeatures, int nMaxFeatures, int iniThFAST, int minThFAST,
+                            int nTargetInliers, float targetFrameTime);
+
+    // Updates the budget with the last frame: inliers of the local map tracking (0 if tracking
+    // failed) and time spent on the frame in seconds. Returns true if the budget changed.
+    bool Update(int nInliers, float frameTime);
+
+    int GetNumFeatures() const {
+        return mnFeatures;
+    }
+
+    int GetIniThFAST() const {
+        return mnIniThFAST;
+    }
+
+    int GetMinThFAST() const {
+        return mnMinThFAST;
+    }
+
+protected:
+
+    int mnMinFeatures;
+    int mnMaxFeatures;
+    int mnBaseIniThFAST;
+    int mnMinThFAST;
+    int mnTargetInliers;
+    float mfTargetFrameTime;
+
+    // Smoothed measurements
+    float mfInliers;
+    float mfFrameTime;
+
+    // Budget before rounding
+    float mfFeatures;
+
+    int mnFeatures;
+    int mnIniThFAST;
+};
+
+} //namespace ORB_SLAM
+
+#endif // FEATUREBUDGETCONTROLLER_H
@@ -0,0 +1,132 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef FEATUREEXTRACTOR_H
+#define FEATUREEXTRACTOR_H
+
+#include <vector>
+#include <string>
+#include <functional>
+#include <opencv/cv.h>
+
+
+namespace ORB_SLAM2
+{
+
+class ThreadPool;
+
+// Keypoint and descriptor extraction backend used by Frame. Keypoints are detected on a
+// scale pyramid and described with 256-bit binary descriptors, so that every backend
+// works with the ORB vocabulary and matcher.
+class FeatureExtractor
+{
+public:
+
+    FeatureExtractor(int nfeatures, float scaleFactor, int nlevels);
+
+    virtual ~FeatureExtractor(){}
+
+    // Backend names accepted in the settings file
+    static const std::string ORB_BACKEND;
+    static const std::string FAST_BACKEND;
+
+    // Creates the extractor of the given backend. Returns NULL if the name is unknown.
+    static FeatureExtractor* Create(const std::string &backend, int nfeatures, float scaleFactor,
+                                    int nlevels, int iniThFAST, int minThFAST);
+
+    // Compute the keypoints and descriptors on an image.
+    // Mask is ignored in the current implementations.
+    virtual void operator()( cv::InputArray image, cv::InputArray mask,
+      std::vector<cv::KeyPoint>& keypoints,
+      cv::OutputArray descriptors) = 0;
+
+    virtual std::string GetBackend() const = 0;
+
+    // Extracts both images of a stereo pair. The levels of the two pyramids are processed
+    // in the same parallel loops, so a pool larger than 2 threads is used (NULL: sequential).
+    static void ExtractStereo(FeatureExtractor &left, const cv::Mat &imLeft,
+                              std::vector<cv::KeyPoint> &keysLeft, cv::Mat &descLeft,
+                              FeatureExtractor &right, const cv::Mat &imRight,
+                              std::vector<cv::KeyPoint> &keysRight, cv::Mat &descRight,
+                              ThreadPool* pThreadPool);
+
+    // Requests a new number of features and FAST thresholds. They are used from the next
+    // image on, so the budget can be changed while another thread is extracting.
+    virtual void SetFeatureBudget(int nfeatures, int iniThFAST, int minThFAST) = 0;
+
+    int inline GetLevels(){
+        return nlevels;}
+
+    float inline GetScaleFactor(){
+        return scaleFactor;}
+
+    std::vector<float> inline GetScaleFactors(){
+        return mvScaleFactor;
+    }
+
+    std::vector<float> inline GetInverseScaleFactors(){
+        return mvInvScaleFactor;
+    }
+
+    std::vector<float> inline GetScaleSigmaSquares(){
+        return mvLevelSigma2;
+    }
+
+    std::vector<float> inline GetInverseScaleSigmaSquares(){
+        return mvInvLevelSigma2;
+    }
+
+    // Pyramid levels are processed in parallel on this pool (NULL: sequential)
+    void inline SetThreadPool(ThreadPool* pThreadPool){
+        mpThreadPool = pThreadPool;
+    }
+
+    // Pyramid of the last image, used by the stereo matching.
+    // Levels may be views into buffers overwritten by the next frame.
+    std::vector<cv::Mat> mvImagePyramid;
+
+protected:
+
+    void ForEachLevel(const std::function<void(int)> &f);
+
+    // Steps of an extraction, in this order. The level steps of different levels may run in
+    // parallel, the other steps run on one thread.
+    virtual void BeginExtraction(const cv::Mat &image) = 0;
+    virtual void DetectLevel(int level) = 0;
+    virtual void AllocateDescriptors(cv::OutputArray descriptors) = 0;
+    virtual void DescribeLevel(int level) = 0;
+    virtual void EndExtraction(std::vector<cv::KeyPoint> &keypoints) = 0;
+
+    int nfeatures;
+    double scaleFactor;
+    int nlevels;
+
+    std::vector<float> mvScaleFactor;
+    std::vector<float> mvInvScaleFactor;
+    std::vector<float> mvLevelSigma2;
+    std::vector<float> mvInvLevelSigma2;
+
+    ThreadPool* mpThreadPool;
+};
+
+} //namespace ORB_SLAM
+
+#endif // FEATUREEXTRACTOR_H
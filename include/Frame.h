@@ -28,7 +28,8 @@
 #include "Thirdparty/DBoW2/DBoW2/FeatureVector.h"
 #include "ORBVocabulary.h"
 #include "KeyFrame.h"
-#include "ORBextractor.h"
+#include "FeatureExtractor.h"
+#include "UndistortionMap.h"
 
 #include <opencv2/opencv.hpp>
 
@@ -45,17 +46,24 @@ class Frame
 public:
     Frame();
 
-    // Copy constructor.
+    // Copy constructor. Descriptors are shared with the copy.
     Frame(const Frame &frame);
 
+    // Frames are handed over (from the constructors, the pipeline, to mLastFrame) without copying their features
+    Frame(Frame &&frame) = default;
+    Frame& operator=(const Frame &frame) = default;
+    Frame& operator=(Frame &&frame) = default;
+
     // Constructor for stereo cameras.
-    Frame(const cv::Mat &imLeft, const cv::Mat &imRight, const double &timeStamp, ORBextractor* extractorLeft, ORBextractor* extractorRight, ORBVocabulary* voc, cv::Mat &K, cv::Mat &distCoef, const float &bf, const float &thDepth);
+    Frame(const cv::Mat &imLeft, const cv::Mat &imRight, const double &timeStamp, FeatureExtractor* extractorLeft, FeatureExtractor* extractorRight, ORBVocabulary* voc, cv::Mat &K, cv::Mat &distCoef, const float &bf, const float &thDepth);
 
-    // Constructor for RGB-D cameras.
-    Frame(const cv::Mat &imGray, const cv::Mat &imDepth, const double &timeStamp, ORBextractor* extractor,ORBVocabulary* voc, cv::Mat &K, cv::Mat &distCoef, const float &bf, const float &thDepth);
+    // Constructor for RGB-D cameras. The depth map is CV_32F in meters, or CV_16U raw values
+    // scaled by depthMapFactor at each keypoint.
+    Frame(const cv::Mat &imGray, const cv::Mat &imDepth, const double &timeStamp, FeatureExtractor* extractor,ORBVocabulary* voc, cv::Mat &K, cv::Mat &distCoef, const float &bf, const float &thDepth,
+          const float &depthMapFactor=1.0f, const int depthMedianRadius=0);
 
     // Constructor for Monocular cameras.
-    Frame(const cv::Mat &imGray, const double &timeStamp, ORBextractor* extractor,ORBVocabulary* voc, cv::Mat &K, cv::Mat &distCoef, const float &bf, const float &thDepth);
+    Frame(const cv::Mat &imGray, const double &timeStamp, FeatureExtractor* extractor,ORBVocabulary* voc, cv::Mat &K, cv::Mat &distCoef, const float &bf, const float &thDepth);
 
     // Extract ORB on the image. 0 for left image and 1 for right image.
     void ExtractORB(int flag, const cv::Mat &im);
@@ -63,6 +71,10 @@ public:
     // Compute Bag of Words representation.
     void ComputeBoW();
 
+    // Takes the next frame id. Tracking calls it when it starts tracking the frame, so frames
+    // built ahead and dropped by the pipeline do not take one.
+    void AssignId();
+
     // Set the camera pose.
     void SetPose(cv::Mat Tcw);
 
@@ -90,10 +102,12 @@ public:
 
     // Search a match for each keypoint in the left image to a keypoint in the right image.
     // If there is a match, depth is computed and the right coordinate associated to the left keypoint is stored.
+    // Rows are split in bands matched in parallel.
     void ComputeStereoMatches();
 
     // Associate a "right" coordinate to a keypoint if there is valid depth in the depthmap.
-    void ComputeStereoFromRGBD(const cv::Mat &imDepth);
+    // With medianRadius>0 the depth is the median of the valid values around the keypoint.
+    void ComputeStereoFromRGBD(const cv::Mat &imDepth, const float depthMapFactor=1.0f, const int medianRadius=0);
 
     // Backprojects a keypoint (if stereo/depth info available) into 3D world coordinates.
     cv::Mat UnprojectStereo(const int &i);
@@ -103,7 +117,7 @@ public:
     ORBVocabulary* mpORBvocabulary;
 
     // Feature extractor. The right is used only in the stereo case.
-    ORBextractor* mpORBextractorLeft, *mpORBextractorRight;
+    FeatureExtractor* mpORBextractorLeft, *mpORBextractorRight;
 
     // Frame timestamp.
     double mTimeStamp;
@@ -158,7 +172,9 @@ public:
     // Keypoints are assigned to cells in a grid to reduce matching complexity when projecting MapPoints.
     static float mfGridElementWidthInv;
     static float mfGridElementHeightInv;
-    std::vector<std::size_t> mGrid[FRAME_GRID_COLS][FRAME_GRID_ROWS];
+    // Keypoints of cell (i,j) are mvGridIndices[mvGridStart[k]..mvGridStart[k+1]), k = i*FRAME_GRID_ROWS+j
+    std::vector<unsigned int> mvGridStart;
+    std::vector<unsigned int> mvGridIndices;
 
     // Camera pose.
     cv::Mat mTcw;
@@ -187,13 +203,20 @@ public:
 
     static bool mbInitialComputations;
 
+    // Workers shared by the frame constructors (NULL: sequential)
+    static ThreadPool* mpThreadPool;
+
+    // Undistortion table of the camera, built by Tracking before the frames that read it
+    static UndistortionMap mUndistortionMap;
+
 
 private:
 
     // Undistort keypoints given OpenCV distortion parameters.
     // Only for the RGB-D case. Stereo must be already rectified!
-    // (called in the constructor).
-    void UndistortKeyPoints();
+    // (called in the constructor). Uses the undistortion table if it was built for imSize,
+    // cv::undistortPoints otherwise.
+    void UndistortKeyPoints(const cv::Size &imSize);
 
     // Computes image bounds for the undistorted image (called in the constructor).
     void ComputeImageBounds(const cv::Mat &imLeft);
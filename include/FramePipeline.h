@@ -0,0 +1,100 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef FRAMEPIPELINE_H
+#define FRAMEPIPELINE_H
+
+#include "Frame.h"
+
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+
+namespace ORB_SLAM2
+{
+
+// Builds Frames (color conversion, feature extraction, undistortion, grid assignment) on a
+// worker thread ahead of tracking. Jobs run one at a time and are retrieved in submission order.
+class FramePipeline
+{
+public:
+
+    class Output
+    {
+    public:
+        Frame frame;
+        cv::Mat imGray;
+        // Seconds spent building the frame
+        double dPreprocessTime;
+        std::chrono::steady_clock::time_point tSubmitted;
+    };
+
+    // Builds a frame and its grayscale image
+    typedef std::function<void(Frame&, cv::Mat&)> Job;
+
+    // At most nCapacity jobs are queued or waiting to be retrieved
+    FramePipeline(int nCapacity);
+    ~FramePipeline();
+
+    // Blocks while the pipeline is full
+    void Submit(const Job &job);
+
+    // Jobs submitted and not retrieved yet
+    int Size();
+
+    // Waits for the oldest job and returns its output (NULL if there are no jobs)
+    std::shared_ptr<Output> Retrieve();
+
+    // Waits for the running job and discards all of them
+    void Clear();
+
+protected:
+
+    class Entry
+    {
+    public:
+        Job job;
+        std::shared_ptr<Output> pOutput;
+        bool bDone;
+    };
+
+    void Run();
+
+    int mnCapacity;
+
+    std::mutex mMutex;
+    std::condition_variable mCond;
+    std::deque<std::shared_ptr<Entry> > mdEntries;
+    // Entries before this index have been started by the worker
+    size_t mnStarted;
+    bool mbRunning;
+    bool mbStop;
+
+    std::thread mWorker;
+};
+
+} //namespace ORB_SLAM
+
+#endif // FRAMEPIPELINE_H
@@ -0,0 +1,89 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef HAMMINGDISTANCE_H
+#define HAMMINGDISTANCE_H
+
+#include<cstddef>
+
+namespace ORB_SLAM2
+{
+
+// Hamming distance between 256-bit ORB descriptors (32 bytes).
+// The kernel (scalar, POPCNT, AVX2, AVX-512 VPOPCNTDQ) is selected once at
+// start-up from the CPU features, all kernels return exactly the same values.
+class HammingDistance
+{
+public:
+
+    static const int DESCRIPTOR_BYTES = 32;
+
+    // Distance between two descriptors
+    static inline int Compute(const unsigned char* a, const unsigned char* b)
+    {
+        return mpfPair(a,b);
+    }
+
+    // Distance from a query to N descriptors stored contiguously, step bytes apart
+    static inline void ComputeOneToMany(const unsigned char* q, const unsigned char* pRows, size_t step,
+                                        int N, int* pDists)
+    {
+        mpfContiguous(q,pRows,step,N,pDists);
+    }
+
+    // Distance from a query to the rows vIdx[0..N) of a descriptor matrix
+    static inline void ComputeOneToMany(const unsigned char* q, const unsigned char* pRows, size_t step,
+                                        const size_t* pIdx, int N, int* pDists)
+    {
+        mpfIndexed(q,pRows,step,pIdx,N,pDists);
+    }
+
+    static inline void ComputeOneToMany(const unsigned char* q, const unsigned char* pRows, size_t step,
+                                        const unsigned int* pIdx, int N, int* pDists)
+    {
+        mpfIndexed32(q,pRows,step,pIdx,N,pDists);
+    }
+
+    // Name of the selected kernel
+    static const char* GetBackendName();
+
+    // Force the portable scalar kernel (debugging / benchmarking)
+    static void UseScalar();
+
+public:
+
+    typedef int (*PairFunc)(const unsigned char*, const unsigned char*);
+    typedef void (*ContiguousFunc)(const unsigned char*, const unsigned char*, size_t, int, int*);
+    typedef void (*IndexedFunc)(const unsigned char*, const unsigned char*, size_t, const size_t*, int, int*);
+    typedef void (*Indexed32Func)(const unsigned char*, const unsigned char*, size_t, const unsigned int*, int, int*);
+
+protected:
+
+    static PairFunc mpfPair;
+    static ContiguousFunc mpfContiguous;
+    static IndexedFunc mpfIndexed;
+    static Indexed32Func mpfIndexed32;
+    static const char* mpBackendName;
+};
+
+} //namespace ORB_SLAM
+
+#endif // HAMMINGDISTANCE_H
@@ -145,10 +145,15 @@ public:
     // Variables used by the tracking
     long unsigned int mnTrackReferenceForFrame;
     long unsigned int mnFuseTargetForKF;
+    // Points of the current frame observed by the keyframe (valid if mnTrackVoteForFrame is the frame id)
+    long unsigned int mnTrackVoteForFrame;
+    int mnTrackVotes;
 
     // Variables used by the local mapping
     long unsigned int mnBALocalForKF;
     long unsigned int mnBAFixedForKF;
+    // Index in the LocalBundleAdjuster of the last local BA including it
+    int mnBAVertexIdx;
 
     // Variables used by the keyframe database
     long unsigned int mnLoopQuery;
@@ -216,8 +221,9 @@ protected:
     KeyFrameDatabase* mpKeyFrameDB;
     ORBVocabulary* mpORBvocabulary;
 
-    // Grid over the image to speed up feature matching
-    std::vector< std::vector <std::vector<size_t> > > mGrid;
+    // Grid over the image to speed up feature matching (cell layout of Frame::mvGridStart)
+    std::vector<unsigned int> mvGridStart;
+    std::vector<unsigned int> mvGridIndices;
 
     std::map<KeyFrame*,int> mConnectedKeyFrameWeights;
     std::vector<KeyFrame*> mvpOrderedConnectedKeyFrames;
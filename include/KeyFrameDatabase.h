@@ -55,7 +55,8 @@ public:
    std::vector<KeyFrame *> DetectLoopCandidates(KeyFrame* pKF, float minScore);
 
    // Relocalization
-   std::vector<KeyFrame*> DetectRelocalizationCandidates(Frame* F);
+   // If bSortByScore, candidates are sorted by decreasing accumulated score
+   std::vector<KeyFrame*> DetectRelocalizationCandidates(Frame* F, bool bSortByScore=false);
 
 public:
    // for serialization
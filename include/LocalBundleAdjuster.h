@@ -0,0 +1,178 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef LOCALBUNDLEADJUSTER_H
+#define LOCALBUNDLEADJUSTER_H
+
+#include <vector>
+#include <Eigen/Core>
+#include <Eigen/StdVector>
+
+#include "Thirdparty/g2o/g2o/types/se3quat.h"
+#include "ThreadPool.h"
+
+namespace ORB_SLAM2
+{
+
+// Bundle adjustment of a local window: keyframe poses (some fixed) and points observed by
+// monocular or stereo edges with a Huber kernel. It takes the same Levenberg-Marquardt steps as g2o
+// (BlockSolver_6_3, VertexSE3Expmap, VertexSBAPointXYZ and EdgeSE3ProjectXYZ/EdgeStereoSE3ProjectXYZ
+// edges), but keeps the problem in contiguous arrays reused across windows. Points are eliminated
+// with the Schur complement and the reduced pose system is solved densely. Linearization and
+// elimination run in chunks of points on the thread pool.
+class LocalBundleAdjuster
+{
+public:
+
+    typedef Eigen::Matrix<double,6,6> Matrix6d;
+    typedef Eigen::Matrix<double,6,1> Vector6d;
+    typedef Eigen::Matrix<double,6,3> Matrix6x3d;
+
+    LocalBundleAdjuster();
+
+    void SetThreadPool(ThreadPool* pThreadPool);
+
+    // Starts each optimization from the damping reached by the previous one (also from the previous
+    // window) instead of computing it from the Hessian
+    void SetWarmStart(const bool bWarmStart);
+
+    // Removes the keyframes, points and edges of the previous window
+    void Clear();
+
+    int AddKeyFrame(const g2o::SE3Quat &Tcw, const bool bFixed, const float fx, const float fy,
+                    const float cx, const float cy, const float bf);
+
+    // The edges of a point are added right after it. Monocular edge if ur<0.
+    int AddPoint(const Eigen::Vector3d &Xw);
+    int AddEdge(const int nKeyFrame, const float u, const float v, const float ur,
+                const float invSigma2, const float delta);
+
+    int NumEdges() const {
+        return mvEdges.size();
+    }
+
+    // Inactive edges are left out of the optimization, as edges of level 1 in g2o
+    void SetActive(const int nEdge, const bool bActive) {
+        mvEdges[nEdge].bActive = bActive;
+    }
+
+    void SetRobust(const int nEdge, const bool bRobust) {
+        mvEdges[nEdge].bRobust = bRobust;
+    }
+
+    // Runs at most nIterations, stops early if *pbStopFlag is set. As in g2o, the chi2 of an edge is the
+    // one of the last evaluation while it was active (the last step may have been rejected).
+    void Optimize(const int nIterations, bool* pbStopFlag=NULL);
+
+    double GetChi2(const int nEdge) const {
+        return mvEdges[nEdge].chi2;
+    }
+
+    // Depth of the point in the keyframe of the edge at the current estimate
+    bool IsDepthPositive(const int nEdge) const;
+
+    const g2o::SE3Quat &GetPose(const int nKeyFrame) const {
+        return mvPoses[nKeyFrame];
+    }
+
+    const Eigen::Vector3d &GetPoint(const int nPoint) const {
+        return mvPoints[nPoint];
+    }
+
+protected:
+
+    struct Edge
+    {
+        int nKeyFrame, nPoint;
+        double u, v, ur;
+        double invSigma2, delta;
+        bool bActive, bRobust;
+        double chi2;
+    };
+
+    // Partial sums of a chunk of points
+    struct ChunkSums
+    {
+        double chi;
+        double scale;
+        Eigen::MatrixXd S;
+        Eigen::VectorXd r;
+    };
+
+    // Errors of the active edges at the trial (or current) estimate, returns the robust chi2.
+    // If bLinearize, also builds the blocks of the normal equations.
+    double Evaluate(const bool bTrial, const bool bLinearize);
+    void EvaluateChunk(const int nChunk, const bool bTrial, const bool bLinearize);
+
+    // Solves the damped system by eliminating the points and sets the trial estimate.
+    // Returns false if the reduced system could not be factorized.
+    bool SolveAndUpdate(const double lambda, double &scale);
+    void EliminateChunk(const int nChunk, const double lambda);
+    void BackSubstituteChunk(const int nChunk, const double lambda, const bool bSolved);
+
+    // Index of the active points and poses in the system
+    void SetupActive();
+
+    void ForEachChunk(const std::function<void(int)> &f);
+
+    ThreadPool* mpThreadPool;
+    bool mbWarmStart;
+    double mLastLambda;
+
+    // Keyframes, current and trial estimate
+    std::vector<g2o::SE3Quat,Eigen::aligned_allocator<g2o::SE3Quat> > mvPoses;
+    std::vector<g2o::SE3Quat,Eigen::aligned_allocator<g2o::SE3Quat> > mvTrialPoses;
+    std::vector<unsigned char> mvbFixed;
+    std::vector<float> mvfx, mvfy, mvcx, mvcy, mvbf;
+    // Rotation and translation of the poses evaluated
+    std::vector<Eigen::Matrix3d> mvR;
+    std::vector<Eigen::Vector3d> mvt;
+    // Column of each pose in the reduced system, -1 if fixed or without active edges
+    std::vector<int> mvPoseCol;
+    int mnPoseCols;
+
+    // Points, current and trial estimate. The edges of point i are [mvPointEdges[i],mvPointEdges[i+1]).
+    std::vector<Eigen::Vector3d> mvPoints;
+    std::vector<Eigen::Vector3d> mvTrialPoints;
+    std::vector<int> mvPointEdges;
+    std::vector<unsigned char> mvbPointActive;
+
+    std::vector<Edge> mvEdges;
+
+    // Linear system: point blocks, pose-point blocks and pose blocks of the edges, pose blocks
+    std::vector<Eigen::Matrix3d> mvHll, mvHllInv;
+    std::vector<Eigen::Vector3d> mvbl;
+    std::vector<Matrix6x3d,Eigen::aligned_allocator<Matrix6x3d> > mvHpl;
+    std::vector<Matrix6d,Eigen::aligned_allocator<Matrix6d> > mvHppEdge;
+    std::vector<Vector6d,Eigen::aligned_allocator<Vector6d> > mvbpEdge;
+    std::vector<Matrix6d,Eigen::aligned_allocator<Matrix6d> > mvHpp;
+    Eigen::VectorXd mbp;
+    // Reduced pose system and its solution
+    Eigen::MatrixXd mS;
+    Eigen::VectorXd mr, mdx;
+
+    // Points are split in as many chunks as threads
+    std::vector<int> mvChunkBegin;
+    std::vector<ChunkSums> mvChunks;
+};
+
+} //namespace ORB_SLAM
+
+#endif // LOCALBUNDLEADJUSTER_H
@@ -0,0 +1,86 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef LOCALMAPPROJECTOR_H
+#define LOCALMAPPROJECTOR_H
+
+#include <vector>
+
+#include "MapPoint.h"
+#include "Frame.h"
+#include "ThreadPool.h"
+#include "DescriptorStore.h"
+
+namespace ORB_SLAM2
+{
+
+// Projection of the local map in the current frame. Position, normal, distance limits and
+// descriptor of the points are copied into SoA arrays (one lock per point), then the points are
+// projected and culled against the frustum 8 at a time. The buffers are reused across frames.
+// With a thread pool the points are processed in independent blocks.
+class LocalMapProjector
+{
+public:
+
+    // Same test as Frame::isInFrustum for each point not already seen in F and not bad.
+    // Fills the tracking variables of the points and returns those in view in vpInView,
+    // sorted by the grid cell of their projection.
+    void Project(Frame &F, const std::vector<MapPoint*> &vpMapPoints, const float viewingCosLimit,
+                 std::vector<MapPoint*> &vpInView, ThreadPool* pThreadPool=NULL);
+
+    // Descriptor snapshot and grid cell of the points returned by the last Project, in the same order
+    const std::vector<const unsigned char*>& GetInViewDescriptors() const {
+        return mvpInViewDescriptors;
+    }
+    const std::vector<int>& GetInViewCells() const {
+        return mvInViewCells;
+    }
+
+protected:
+
+    // Points per block, a multiple of the SIMD width
+    static const int BLOCK_SIZE = 256;
+
+    void Snapshot(const Frame &F, const std::vector<MapPoint*> &vpMapPoints, const int i0, const int i1);
+    void Cull(const float* pTcw, const float* pOw, const float viewingCosLimit, const int i0, const int i1);
+    void Predict(const Frame &F, const std::vector<MapPoint*> &vpMapPoints, const int i0, const int i1);
+
+    // Snapshot of the points, valid where mvbCandidate is set
+    std::vector<unsigned char> mvbCandidate;
+    std::vector<float> mvX, mvY, mvZ;
+    std::vector<float> mvNx, mvNy, mvNz;
+    std::vector<float> mvMinDist, mvMaxDist;
+    // One aligned 32-byte row per point
+    cv::Mat mDescriptors;
+
+    // Projection of the points, valid where mvbInView is set
+    std::vector<float> mvU, mvV, mvInvZ, mvDist, mvViewCos;
+    std::vector<unsigned char> mvbInView;
+
+    // Grid cell of the projection, -1 if not in view
+    std::vector<int> mvCell;
+
+    std::vector<const unsigned char*> mvpInViewDescriptors;
+    std::vector<int> mvInViewCells;
+};
+
+} //namespace ORB_SLAM
+
+#endif // LOCALMAPPROJECTOR_H
@@ -26,6 +26,8 @@
 #include "LoopClosing.h"
 #include "Tracking.h"
 #include "KeyFrameDatabase.h"
+#include "LocalBundleAdjuster.h"
+#include "ThreadPool.h"
 
 #include <mutex>
 
@@ -40,7 +42,7 @@ class Map;
 class LocalMapping
 {
 public:
-    LocalMapping(Map* pMap, const float bMonocular);
+    LocalMapping(Map* pMap, const float bMonocular, const std::string &strSettingPath);
 
     void SetLoopCloser(LoopClosing* pLoopCloser);
 
@@ -114,6 +116,10 @@ protected:
 
     bool mbAbortBA;
 
+    // Local BA engine, reused across keyframes, and its workers (NULL if sequential)
+    LocalBundleAdjuster mLocalBundleAdjuster;
+    ThreadPool* mpBAPool;
+
     bool mbStopped;
     bool mbStopRequested;
     bool mbNotStop;
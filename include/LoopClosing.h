@@ -28,6 +28,7 @@
 #include "Tracking.h"
 
 #include "KeyFrameDatabase.h"
+#include "ThreadPool.h"
 
 #include <thread>
 #include <mutex>
@@ -51,7 +52,7 @@ public:
 
 public:
 
-    LoopClosing(Map* pMap, KeyFrameDatabase* pDB, ORBVocabulary* pVoc,const bool bFixScale);
+    LoopClosing(Map* pMap, KeyFrameDatabase* pDB, ORBVocabulary* pVoc,const bool bFixScale, const string &strSettingPath);
 
     void SetTracker(Tracking* pTracker);
 
@@ -142,6 +143,9 @@ protected:
     // Fix scale in the stereo/RGB-D case
     bool mbFixScale;
 
+    // Workers of the essential graph optimization and the global BA (NULL if sequential)
+    ThreadPool* mpOptimizerPool;
+
 
     int mnFullBAIdx;
 };
@@ -26,6 +26,7 @@
 #include <set>
 
 #include <mutex>
+#include <atomic>
 
 #include "BoostArchiver.h"
 
@@ -49,6 +50,10 @@ public:
     void InformNewBigChange();
     int GetLastBigChangeIdx();
 
+    // Index increased whenever keyframes, their covisibility, spanning tree or points change
+    void InformGraphChange();
+    unsigned long GetLastGraphChangeIdx();
+
     std::vector<KeyFrame*> GetAllKeyFrames();
     std::vector<MapPoint*> GetAllMapPoints();
     std::vector<MapPoint*> GetReferenceMapPoints();
@@ -85,6 +90,8 @@ protected:
     // Index related to a big change in the map (loop closure, global BA)
     int mnBigChangeIdx;
 
+    std::atomic<unsigned long> mnGraphChangeIdx;
+
     std::mutex mMutexMap;
 };
 
@@ -24,9 +24,11 @@
 #include"KeyFrame.h"
 #include"Frame.h"
 #include"Map.h"
+#include"DescriptorStore.h"
 
 #include<opencv2/core/core.hpp>
 #include<mutex>
+#include<atomic>
 #include "BoostArchiver.h"
 
 namespace ORB_SLAM2
@@ -43,6 +45,9 @@ public:
     MapPoint(const cv::Mat &Pos, KeyFrame* pRefKF, Map* pMap);
     MapPoint(const cv::Mat &Pos,  Map* pMap, Frame* pFrame, const int &idxF);
 
+    // Reuses a point created from a frame (visual odometry points), it keeps its id
+    void ResetFromFrame(const cv::Mat &Pos, Frame* pFrame, const int &idxF);
+
     void SetWorldPos(const cv::Mat &Pos);
     cv::Mat GetWorldPos();
 
@@ -51,6 +56,8 @@ public:
 
     std::map<KeyFrame*,size_t> GetObservations();
     int Observations();
+    // Appends the keyframes observing the point to vpKFs
+    void GetObservingKeyFrames(std::vector<KeyFrame*> &vpKFs);
 
     void AddObservation(KeyFrame* pKF,size_t idx);
     void EraseObservation(KeyFrame* pKF);
@@ -73,15 +80,30 @@ public:
 
     void ComputeDistinctiveDescriptors();
 
+    // Copy of the descriptor (serialization and debugging)
     cv::Mat GetDescriptor();
 
+    // Lock-free copy of the descriptor into a 32-byte buffer (matching)
+    inline void GetDescriptor(unsigned char* pDesc) const {
+        mDescriptor.Load(pDesc);
+    }
+
     void UpdateNormalAndDepth();
 
     float GetMinDistanceInvariance();
     float GetMaxDistanceInvariance();
+
+    // Position, normal and distance limits (without the invariance factors) read under a single lock,
+    // and the descriptor (32 bytes)
+    void GetProjectionData(float* pPos, float* pNormal, float &minDistance, float &maxDistance,
+                           unsigned char* pDescriptor);
     int PredictScale(const float &currentDist, KeyFrame*pKF);
     int PredictScale(const float &currentDist, Frame* pF);
 
+    // The descriptor is 32-byte aligned, which plain new does not guarantee before C++17
+    static void* operator new(std::size_t size);
+    static void operator delete(void* p);
+
 public:
     // for serialization
     MapPoint();
@@ -110,6 +132,8 @@ public:
 
     // Variables used by local mapping
     long unsigned int mnBALocalForKF;
+    // Index in the LocalBundleAdjuster of the last local BA including it
+    int mnBAVertexIdx;
     long unsigned int mnFuseCandidateForKF;
 
     // Variables used by loop closing
@@ -134,14 +158,14 @@ protected:
      cv::Mat mNormalVector;
 
      // Best descriptor to fast matching
-     cv::Mat mDescriptor;
+     AtomicDescriptor mDescriptor;
 
      // Reference KeyFrame
      KeyFrame* mpRefKF;
 
-     // Tracking counters
-     int mnVisible;
-     int mnFound;
+     // Tracking counters, updated without locking
+     std::atomic<int> mnVisible;
+     std::atomic<int> mnFound;
 
      // Bad flag (we do not currently erase MapPoint from memory)
      bool mbBad;
@@ -153,6 +177,8 @@ protected:
 
      Map* mpMap;
 
+     void InitFromFrame(const cv::Mat &Pos, Frame* pFrame, const int &idxF);
+
      std::mutex mMutexPos;
      std::mutex mMutexFeatures;
 };
@@ -23,26 +23,41 @@
 
 #include <vector>
 #include <list>
+#include <functional>
+#include <mutex>
 #include <opencv/cv.h>
 
+#include "FeatureExtractor.h"
+
 
 namespace ORB_SLAM2
 {
 
+// Node of the keypoint distribution quadtree. Nodes are stored in a flat array
+// and own the range [begin,end) of an array of keypoint indices.
 class ExtractorNode
 {
 public:
-    ExtractorNode():bNoMore(false){}
+    ExtractorNode():begin(0),end(0),order(0),bNoMore(false),bDivided(false){}
+
+    // Splits the node in four. Its keypoint indices are partitioned (keeping their order)
+    // into consecutive ranges for n1, n2, n3 and n4.
+    void DivideNode(ExtractorNode &n1, ExtractorNode &n2, ExtractorNode &n3, ExtractorNode &n4,
+                    const cv::KeyPoint* pKeys, int* pKeyIdx, int* pScratch) const;
 
-    void DivideNode(ExtractorNode &n1, ExtractorNode &n2, ExtractorNode &n3, ExtractorNode &n4);
+    int Size() const {
+        return end-begin;
+    }
 
-    std::vector<cv::KeyPoint> vKeys;
-    cv::Point2i UL, UR, BL, BR;
-    std::list<ExtractorNode>::iterator lit;
+    cv::Point2i UL, BR;
+    int begin, end;
+    // Position in the node list, front first
+    int order;
     bool bNoMore;
+    bool bDivided;
 };
 
-class ORBextractor
+class ORBextractor : public FeatureExtractor
 {
 public:
     
@@ -51,63 +66,73 @@ public:
     ORBextractor(int nfeatures, float scaleFactor, int nlevels,
                  int iniThFAST, int minThFAST);
 
-    ~ORBextractor(){}
+    virtual ~ORBextractor(){}
 
     // Compute the ORB features and descriptors on an image.
     // ORB are dispersed on the image using an octree.
     // Mask is ignored in the current implementation.
-    void operator()( cv::InputArray image, cv::InputArray mask,
+    virtual void operator()( cv::InputArray image, cv::InputArray mask,
       std::vector<cv::KeyPoint>& keypoints,
       cv::OutputArray descriptors);
 
-    int inline GetLevels(){
-        return nlevels;}
-
-    float inline GetScaleFactor(){
-        return scaleFactor;}
-
-    std::vector<float> inline GetScaleFactors(){
-        return mvScaleFactor;
+    virtual std::string GetBackend() const {
+        return ORB_BACKEND;
     }
 
-    std::vector<float> inline GetInverseScaleFactors(){
-        return mvInvScaleFactor;
-    }
+    virtual void SetFeatureBudget(int nfeatures, int iniThFAST, int minThFAST);
 
-    std::vector<float> inline GetScaleSigmaSquares(){
-        return mvLevelSigma2;
-    }
+protected:
 
-    std::vector<float> inline GetInverseScaleSigmaSquares(){
-        return mvInvLevelSigma2;
-    }
+    void ComputeFeaturesPerLevel();
+    void ApplyFeatureBudget();
 
-    std::vector<cv::Mat> mvImagePyramid;
+    virtual void BeginExtraction(const cv::Mat &image);
+    virtual void DetectLevel(int level);
+    virtual void AllocateDescriptors(cv::OutputArray descriptors);
+    virtual void DescribeLevel(int level);
+    virtual void EndExtraction(std::vector<cv::KeyPoint> &keypoints);
 
-protected:
+    // Keypoints of each level and descriptor rows of the image being extracted
+    std::vector<std::vector<cv::KeyPoint> > mvAllKeypoints;
+    cv::Mat mDescriptorsOut;
+    std::vector<int> mvDescriptorOffsets;
+
+    // Bordered pyramid levels (EDGE_THRESHOLD pixels on each side) and blurred levels,
+    // reused across frames
+    std::vector<cv::Mat> mvPyramidBuffers;
+    std::vector<cv::Mat> mvBlurredPyramid;
+    // FAST score map of each level
+    std::vector<cv::Mat> mvFastScores;
 
     void ComputePyramid(cv::Mat image);
     void ComputeKeyPointsOctTree(std::vector<std::vector<cv::KeyPoint> >& allKeypoints);    
+    void ComputeKeyPointsOctTree(const int level, std::vector<cv::KeyPoint>& keypoints);
+
+    // Selects at most nFeatures keypoints of a level, spread over [minX,maxX)x[minY,maxY)
+    virtual std::vector<cv::KeyPoint> DistributeKeyPoints(const std::vector<cv::KeyPoint>& vToDistributeKeys, const int &minX,
+                                                          const int &maxX, const int &minY, const int &maxY, const int &nFeatures, const int &level);
     std::vector<cv::KeyPoint> DistributeOctTree(const std::vector<cv::KeyPoint>& vToDistributeKeys, const int &minX,
                                            const int &maxX, const int &minY, const int &maxY, const int &nFeatures, const int &level);
 
     void ComputeKeyPointsOld(std::vector<std::vector<cv::KeyPoint> >& allKeypoints);
     std::vector<cv::Point> pattern;
 
-    int nfeatures;
-    double scaleFactor;
-    int nlevels;
     int iniThFAST;
     int minThFAST;
 
+    // Descriptors are computed on blurred levels (default) or on the levels themselves
+    bool mbBlurLevels;
+
     std::vector<int> mnFeaturesPerLevel;
 
-    std::vector<int> umax;
+    // Budget requested by SetFeatureBudget, applied at the start of the next extraction
+    std::mutex mMutexBudget;
+    bool mbBudgetRequested;
+    int mnRequestedFeatures;
+    int mnRequestedIniThFAST;
+    int mnRequestedMinThFAST;
 
-    std::vector<float> mvScaleFactor;
-    std::vector<float> mvInvScaleFactor;    
-    std::vector<float> mvLevelSigma2;
-    std::vector<float> mvInvLevelSigma2;
+    std::vector<int> umax;
 };
 
 } //namespace ORB_SLAM
@@ -29,11 +29,14 @@
 #include"MapPoint.h"
 #include"KeyFrame.h"
 #include"Frame.h"
+#include"DescriptorStore.h"
 
 
 namespace ORB_SLAM2
 {
 
+class ThreadPool;
+
 class ORBmatcher
 {    
 public:
@@ -45,7 +48,12 @@ public:
 
     // Search matches between Frame keypoints and projected MapPoints. Returns number of matches
     // Used to track the local map (Tracking)
-    int SearchByProjection(Frame &F, const std::vector<MapPoint*> &vpMapPoints, const float th=3);
+    // The points come from LocalMapProjector, sorted by grid cell (vCells) with a snapshot of their
+    // descriptors (vpDescriptors). The keypoints around a cell are gathered once for all its points.
+    // With a thread pool the cells are searched in parallel, the result is the same as the sequential search
+    int SearchByProjection(Frame &F, const std::vector<MapPoint*> &vpMapPoints,
+                           const std::vector<const unsigned char*> &vpDescriptors, const std::vector<int> &vCells,
+                           const float th=3, ThreadPool* pThreadPool=NULL);
 
     // Project MapPoints tracked in last frame into the current frame and search matches.
     // Used to track from previous frame (Tracking)
@@ -95,10 +103,42 @@ protected:
 
     float RadiusByViewingCos(const float &viewCos);
 
+    // Best and second best keypoints for a projected MapPoint (SearchByProjection on the local map)
+    struct ProjectionMatch
+    {
+        ProjectionMatch(): bestDist(256), bestLevel(-1), bestIdx(-1), bestDist2(256), bestLevel2(-1), bestIdx2(-1){}
+
+        int bestDist, bestLevel, bestIdx;
+        int bestDist2, bestLevel2, bestIdx2;
+    };
+
+    // Searches the keypoints of F not matched to a MapPoint with observations, for the points
+    // [i0,i1) of one grid cell. Thread-safe as long as F.mvpMapPoints is not modified.
+    void FindProjectionMatches(const Frame &F, const std::vector<MapPoint*> &vpMapPoints,
+                               const std::vector<const unsigned char*> &vpDescriptors, const int i0, const int i1,
+                               const float th, ProjectionMatch* pMatches);
+
+    // Same search for a single point, vDistances is scratch
+    void FindProjectionMatch(const Frame &F, MapPoint* pMP, const unsigned char* pDescriptor, const float th,
+                             std::vector<int> &vDistances, ProjectionMatch &match);
+
+    // Best and second keypoints among vIndices, inside the search radius r
+    void ScoreProjectionCandidates(const Frame &F, MapPoint* pMP, const unsigned char* pDescriptor, const float r,
+                                   const std::vector<size_t> &vIndices, std::vector<int> &vDistances,
+                                   ProjectionMatch &match);
+
     void ComputeThreeMaxima(std::vector<int>* histo, const int L, int &ind1, int &ind2, int &ind3);
 
+    // Distances from a descriptor to the given rows of a descriptor matrix (one batched kernel call).
+    // The returned buffer is valid until the next call.
+    const int* ComputeDistances(const unsigned char* pDesc, const cv::Mat &Descriptors, const std::vector<size_t> &vIndices);
+    const int* ComputeDistances(const unsigned char* pDesc, const cv::Mat &Descriptors, const std::vector<unsigned int> &vIndices);
+
     float mfNNratio;
     bool mbCheckOrientation;
+
+    // Scratch buffer for batched descriptor distances
+    std::vector<int> mvDistances;
 };
 
 }// namespace ORB_SLAM
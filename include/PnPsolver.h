@@ -51,13 +51,17 @@
 #ifndef PNPSOLVER_H
 #define PNPSOLVER_H
 
+#include <random>
 #include <opencv2/core/core.hpp>
+#include <Eigen/Dense>
 #include "MapPoint.h"
 #include "Frame.h"
 
 namespace ORB_SLAM2
 {
 
+// P4P RANSAC with EPnP. Each solver owns its random generator and buffers,
+// so that different solvers can iterate concurrently.
 class PnPsolver {
  public:
   PnPsolver(const Frame &F, const vector<MapPoint*> &vpMapPointMatches);
@@ -91,30 +95,37 @@ class PnPsolver {
   void print_pose(const double R[3][3], const double t[3]);
   double reprojection_error(const double R[3][3], const double t[3]);
 
+  // Fixed-size matrices of the EPnP solution, they live on the stack
+  typedef Eigen::Matrix<double,12,12> Matrix12d;
+  // Null space of M: column i is the right singular vector of the i-th smallest singular value
+  typedef Eigen::Matrix<double,12,4> Matrix12x4d;
+  typedef Eigen::Matrix<double,6,10> Matrix6x10d;
+  typedef Eigen::Matrix<double,6,1> Vector6d;
+
   void choose_control_points(void);
   void compute_barycentric_coordinates(void);
-  void fill_M(CvMat * M, const int row, const double * alphas, const double u, const double v);
-  void compute_ccs(const double * betas, const double * ut);
+  // Adds the two rows of M of a correspondence to MtM
+  void fill_M(Matrix12d & MtM, const double * alphas, const double u, const double v);
+  void compute_ccs(const double * betas, const Matrix12x4d & V);
   void compute_pcs(void);
 
   void solve_for_sign(void);
 
-  void find_betas_approx_1(const CvMat * L_6x10, const CvMat * Rho, double * betas);
-  void find_betas_approx_2(const CvMat * L_6x10, const CvMat * Rho, double * betas);
-  void find_betas_approx_3(const CvMat * L_6x10, const CvMat * Rho, double * betas);
-  void qr_solve(CvMat * A, CvMat * b, CvMat * X);
+  void find_betas_approx_1(const Matrix6x10d & L_6x10, const Vector6d & Rho, double * betas);
+  void find_betas_approx_2(const Matrix6x10d & L_6x10, const Vector6d & Rho, double * betas);
+  void find_betas_approx_3(const Matrix6x10d & L_6x10, const Vector6d & Rho, double * betas);
 
   double dot(const double * v1, const double * v2);
   double dist2(const double * p1, const double * p2);
 
-  void compute_rho(double * rho);
-  void compute_L_6x10(const double * ut, double * l_6x10);
+  void compute_rho(Vector6d & rho);
+  void compute_L_6x10(const Matrix12x4d & V, Matrix6x10d & L_6x10);
 
-  void gauss_newton(const CvMat * L_6x10, const CvMat * Rho, double current_betas[4]);
-  void compute_A_and_b_gauss_newton(const double * l_6x10, const double * rho,
-				    double cb[4], CvMat * A, CvMat * b);
+  void gauss_newton(const Matrix6x10d & L_6x10, const Vector6d & Rho, double current_betas[4]);
+  void compute_A_and_b_gauss_newton(const Matrix6x10d & L_6x10, const Vector6d & Rho,
+                                    const double cb[4], Eigen::Matrix<double,6,4> & A, Vector6d & b);
 
-  double compute_R_and_t(const double * ut, const double * betas,
+  double compute_R_and_t(const Matrix12x4d & V, const double * betas,
 			 double R[3][3], double t[3]);
 
   void estimate_R_and_t(double R[3][3], double t[3]);
@@ -127,7 +138,8 @@ class PnPsolver {
 
   double uc, vc, fu, fv;
 
-  double * pws, * us, * alphas, * pcs;
+  // Correspondences, sized once for the largest set
+  std::vector<double> pws, us, alphas, pcs;
   int maximum_number_of_correspondences;
   int number_of_correspondences;
 
@@ -169,6 +181,10 @@ class PnPsolver {
 
   // Indices for random selection [0 .. N-1]
   vector<size_t> mvAllIndices;
+  vector<size_t> mvAvailableIndices;
+
+  // Minimal set sampling, seeded from the global generator
+  std::mt19937 mRng;
 
   // RANSAC probability
   double mRansacProb;
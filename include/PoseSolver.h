@@ -0,0 +1,111 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef POSESOLVER_H
+#define POSESOLVER_H
+
+#include <vector>
+#include <Eigen/Core>
+
+#include "Thirdparty/g2o/g2o/types/se3quat.h"
+
+namespace ORB_SLAM2
+{
+
+// Levenberg-Marquardt optimization of a camera pose from monocular and stereo observations of fixed
+// points, with a Huber kernel. It takes the same steps as g2o with one VertexSE3Expmap and
+// EdgeSE3ProjectXYZOnlyPose/EdgeStereoSE3ProjectXYZOnlyPose edges, without building a graph:
+// the active observations are packed in SoA arrays and the 6x6 normal equations are accumulated
+// 4 observations at a time.
+class PoseSolver
+{
+public:
+
+    typedef Eigen::Matrix<double,6,6> Matrix6d;
+    typedef Eigen::Matrix<double,6,1> Vector6d;
+
+    PoseSolver(const float fx, const float fy, const float cx, const float cy, const float bf);
+
+    void Reserve(const size_t n);
+
+    // Monocular observation if ur<0. Observations are added active.
+    void AddObservation(const float* pXw, const float u, const float v, const float ur,
+                        const float invSigma2, const float delta);
+
+    int NumObservations() const {
+        return mvbActive.size();
+    }
+
+    // Inactive observations are left out of the optimization, but their chi2 is still computed
+    void SetActive(const int i, const bool bActive) {
+        mvbActive[i] = bActive;
+    }
+
+    // Enables or disables the Huber kernel of all observations
+    void SetRobust(const bool bRobust) {
+        mbRobust = bRobust;
+    }
+
+    // Runs at most nIterations from Tcw, which is updated. As in g2o, the chi2 of the active observations
+    // are those of the last evaluated pose (its step may have been rejected), the inactive ones are
+    // evaluated at the final pose.
+    void Optimize(g2o::SE3Quat &Tcw, const int nIterations);
+
+    double GetChi2(const int i) const {
+        return mvChi2[i];
+    }
+
+protected:
+
+    // Observations in SoA layout
+    struct Observations
+    {
+        void resize(const size_t n);
+
+        std::vector<double> vX, vY, vZ;
+        // vUr<0 for monocular observations
+        std::vector<double> vU, vV, vUr;
+        std::vector<double> vInvSigma2, vDelta;
+    };
+
+    // Computes the chi2 of the active observations at Tcw and returns their robust sum.
+    // If bLinearize, also accumulates the normal equations H*dx = b.
+    template<bool bLinearize>
+    double Evaluate(const g2o::SE3Quat &Tcw, Matrix6d &H, Vector6d &b);
+
+    // Chi2 of observation i of mAll
+    double ComputeChi2(const Eigen::Matrix3d &R, const Eigen::Vector3d &t, const int i) const;
+
+    double mfx, mfy, mcx, mcy, mbf;
+    bool mbRobust;
+
+    Observations mAll;
+    std::vector<unsigned char> mvbActive;
+    std::vector<double> mvChi2;
+
+    // Active observations packed at the start of Optimize, with their index in mAll
+    Observations mActive;
+    std::vector<int> mvActiveIdx;
+    std::vector<double> mvActiveChi2;
+};
+
+} //namespace ORB_SLAM
+
+#endif // POSESOLVER_H
@@ -67,18 +67,24 @@ public:
 
     // Proccess the given stereo frame. Images must be synchronized and rectified.
     // Input images: RGB (CV_8UC3) or grayscale (CV_8U). RGB is converted to grayscale.
-    // Returns the camera pose (empty if tracking fails).
+    // Returns the camera pose (empty if tracking fails). With Tracking.pipelineDepth>0 the frame is
+    // queued and the pose returned is the one of the last tracked frame, pipelineDepth frames before
+    // this one (empty while the pipeline fills, older if frames were dropped).
     cv::Mat TrackStereo(const cv::Mat &imLeft, const cv::Mat &imRight, const double &timestamp);
 
     // Process the given rgbd frame. Depthmap must be registered to the RGB frame.
     // Input image: RGB (CV_8UC3) or grayscale (CV_8U). RGB is converted to grayscale.
     // Input depthmap: Float (CV_32F).
-    // Returns the camera pose (empty if tracking fails).
+    // Returns the camera pose (empty if tracking fails). With Tracking.pipelineDepth>0 the frame is
+    // queued and the pose returned is the one of the last tracked frame, pipelineDepth frames before
+    // this one (empty while the pipeline fills, older if frames were dropped).
     cv::Mat TrackRGBD(const cv::Mat &im, const cv::Mat &depthmap, const double &timestamp);
 
     // Proccess the given monocular frame
     // Input images: RGB (CV_8UC3) or grayscale (CV_8U). RGB is converted to grayscale.
-    // Returns the camera pose (empty if tracking fails).
+    // Returns the camera pose (empty if tracking fails). With Tracking.pipelineDepth>0 the frame is
+    // queued and the pose returned is the one of the last tracked frame, pipelineDepth frames before
+    // this one (empty while the pipeline fills, older if frames were dropped).
     cv::Mat TrackMonocular(const cv::Mat &im, const double &timestamp);
     vector<cv::Mat> LoadedMapKeyFrames();
     // This stops local mapping thread (map building) and performs only camera tracking.
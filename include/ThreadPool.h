@@ -0,0 +1,78 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include<vector>
+#include<thread>
+#include<mutex>
+#include<condition_variable>
+#include<functional>
+#include<atomic>
+
+namespace ORB_SLAM2
+{
+
+// Persistent pool of worker threads for fork-join loops.
+// The thread calling ParallelFor takes part in the work, so a pool of
+// nThreads uses nThreads-1 workers.
+class ThreadPool
+{
+public:
+
+    ThreadPool(int nThreads);
+    ~ThreadPool();
+
+    int GetNumThreads() const {
+        return mvWorkers.size()+1;
+    }
+
+    // Runs f(i) for every i in [0,n) and returns when all calls are done.
+    // If the pool is busy (another thread is running a loop, or it is called
+    // from inside a loop) the iterations run sequentially on the calling thread.
+    void ParallelFor(int n, const std::function<void(int)> &f);
+
+protected:
+
+    void Run();
+    void RunJob();
+
+    std::vector<std::thread> mvWorkers;
+
+    // Serializes loops coming from different threads
+    std::mutex mMutexJob;
+
+    std::mutex mMutex;
+    std::condition_variable mCondWork;
+    std::condition_variable mCondDone;
+    unsigned long mnGeneration;
+    int mnBusy;
+    bool mbStop;
+
+    const std::function<void(int)>* mpJob;
+    int mnJobSize;
+    std::atomic<int> mnNext;
+};
+
+} //namespace ORB_SLAM
+
+#endif // THREADPOOL_H
@@ -33,12 +33,17 @@
 #include"Frame.h"
 #include "ORBVocabulary.h"
 #include"KeyFrameDatabase.h"
-#include"ORBextractor.h"
+#include"FeatureExtractor.h"
+#include"ThreadPool.h"
+#include"FeatureBudgetController.h"
+#include"FramePipeline.h"
+#include"LocalMapProjector.h"
 #include "Initializer.h"
 #include "MapDrawer.h"
 #include "System.h"
 
 #include <mutex>
+#include <chrono>
 
 namespace ORB_SLAM2
 {
@@ -75,6 +80,9 @@ public:
     // Use this function if you have deactivated local mapping and you only want to localize the camera.
     void InformOnlyTracking(const bool &flag);
 
+    // Tracks the frames still in the preprocessing pipeline
+    void FlushPipeline();
+
 
 public:
 
@@ -132,12 +140,24 @@ protected:
     bool TrackReferenceKeyFrame();
     void UpdateLastFrame();
     bool TrackWithMotionModel();
+    // Pose of the current frame given by the motion model
+    cv::Mat PredictPose();
+    // Median reprojection error of the current inliers with pose Tcw
+    float ComputePredictionError(const cv::Mat &Tcw);
 
     bool Relocalization();
+    // Checks the candidates (in parallel on the tracking pool) and sets the pose of the current frame
+    // from the first one, in candidate order, supported by enough inliers
+    bool RelocalizeWithCandidates(const std::vector<KeyFrame*> &vpCandidateKFs);
+    // Optimizes the pose of a relocalization hypothesis on F and searches more matches in pKF.
+    // Returns the number of inliers. Only F is modified, so candidates can be checked concurrently.
+    int CheckRelocalizationPose(Frame &F, KeyFrame* pKF, const cv::Mat &Tcw, const std::vector<bool> &vbInliers,
+                                const std::vector<MapPoint*> &vpMapPointMatches);
 
     void UpdateLocalMap();
     void UpdateLocalPoints();
-    void UpdateLocalKeyFrames();
+    // Returns true if the local keyframes were rebuilt
+    bool UpdateLocalKeyFrames();
 
     bool TrackLocalMap();
     void SearchLocalPoints();
@@ -156,8 +176,34 @@ protected:
     LoopClosing* mpLoopClosing;
 
     //ORB
-    ORBextractor* mpORBextractorLeft, *mpORBextractorRight;
-    ORBextractor* mpIniORBextractor;
+    FeatureExtractor* mpORBextractorLeft, *mpORBextractorRight;
+    FeatureExtractor* mpIniORBextractor;
+
+    // Workers for the parallel extraction of pyramid levels (NULL if sequential)
+    ThreadPool* mpExtractorPool;
+
+    // Adapts the number of extracted features to the tracking quality (NULL if fixed)
+    FeatureBudgetController* mpBudgetController;
+    void UpdateFeatureBudget(const double frameTime);
+
+    // Builds frames on a worker ahead of tracking (NULL if synchronous)
+    FramePipeline* mpPipeline;
+    int mnPipelineDepth;
+    // Frames waiting longer than this (seconds) are dropped if newer ones are queued (0 never)
+    float mfMaxFrameLatency;
+    double mdLastSubmittedTimestamp;
+    int mnDroppedFrames;
+
+    // Builds the undistortion table for the image size, if needed, before a frame job reads it
+    void PrepareUndistortion(const cv::Size &imSize);
+
+    // Builds the frame with job and tracks it, now or through the pipeline
+    cv::Mat GrabFrame(const FramePipeline::Job &job, const double &timestamp);
+    // Tracks the oldest frame of the pipeline. Returns false if there is none.
+    bool TrackNextFrame(const bool bAllowDrop);
+
+    // Workers projecting and matching the local map (NULL if sequential)
+    ThreadPool* mpTrackingPool;
 
     //BoW
     ORBVocabulary* mpORBVocabulary;
@@ -170,6 +216,19 @@ protected:
     KeyFrame* mpReferenceKF;
     std::vector<KeyFrame*> mvpLocalKeyFrames;
     std::vector<MapPoint*> mvpLocalMapPoints;
+
+    // The local map is rebuilt when its reference keyframe changes, the graph changes
+    // (Map::GetLastGraphChangeIdx) or a keyframe outside it observes the matched points
+    KeyFrame* mpLocalMapReferenceKF;
+    unsigned long mnLocalMapGraphChangeIdx;
+    long unsigned int mnLocalMapFrameId;
+    // Keyframes voted by the matched points, scratch for their observations
+    std::vector<KeyFrame*> mvpVotingKeyFrames;
+    std::vector<KeyFrame*> mvpObservingKeyFrames;
+
+    // Local map points in the frustum of the current frame, sorted by grid cell
+    LocalMapProjector mLocalMapProjector;
+    std::vector<MapPoint*> mvpLocalPointsInView;
     
     // System
     System* mpSystem;
@@ -198,6 +257,9 @@ protected:
 
     // For RGB-D inputs only. For some datasets (e.g. TUM) the depthmap values are scaled.
     float mDepthMapFactor;
+    // Sample 16-bit depthmaps at the keypoints instead of converting them, optionally with a median filter
+    bool mbRawDepth;
+    int mnDepthMedianRadius;
 
     //Current matches in frame
     int mnMatchesInliers;
@@ -208,13 +270,29 @@ protected:
     unsigned int mnLastKeyFrameId;
     unsigned int mnLastRelocFrameId;
 
+    // Relocalization time budget per frame (ms, 0: no budget). Candidates not checked yet
+    // (from mnNextRelocCandidate on) are kept for the next lost frame.
+    float mfRelocalizationBudget;
+    std::vector<KeyFrame*> mvpRelocCandidates;
+    size_t mnNextRelocCandidate;
+    long unsigned int mnLastRelocAttemptFrameId;
+
     //Motion Model
     cv::Mat mVelocity;
+    // Second order model (Tracking.motionModel 2): previous velocity, frames of both velocities
+    // and median reprojection error of the last prediction (pixels), which sizes the search window
+    int mnMotionModel;
+    cv::Mat mLastVelocity;
+    long unsigned int mnVelocityFrameId;
+    long unsigned int mnLastVelocityFrameId;
+    float mfPredictionError;
 
     //Color order (true RGB, false BGR, ignored if grayscale)
     bool mbRGB;
 
-    list<MapPoint*> mlpTemporalPoints;
+    // Visual odometry points, reused across frames. The first mnTemporalPoints are in use.
+    std::vector<MapPoint*> mvpTemporalPoints;
+    size_t mnTemporalPoints;
 };
 
 } //namespace ORB_SLAM
@@ -0,0 +1,68 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef UNDISTORTIONMAP_H
+#define UNDISTORTIONMAP_H
+
+#include <vector>
+#include <opencv2/core/core.hpp>
+#include <opencv2/features2d/features2d.hpp>
+
+namespace ORB_SLAM2
+{
+
+// Undistorted position of the image points, tabulated every GRID_STEP pixels with
+// cv::undistortPoints and interpolated bilinearly. Replaces the iterative undistortion
+// of every keypoint by a table lookup.
+class UndistortionMap
+{
+public:
+
+    static const int GRID_STEP = 2;
+
+    UndistortionMap();
+
+    // Tabulates the points of [0,imSize.width]x[0,imSize.height]
+    void Build(const cv::Mat &K, const cv::Mat &distCoef, const cv::Size &imSize);
+    void Clear();
+
+    bool IsBuilt(const cv::Size &imSize) const {
+        return !mvMapX.empty() && imSize==mImSize;
+    }
+
+    // Undistorted position of a point
+    cv::Point2f Undistort(const float x, const float y) const;
+
+    // vKeysUn is a copy of vKeys with the undistorted positions
+    void Undistort(const std::vector<cv::KeyPoint> &vKeys, std::vector<cv::KeyPoint> &vKeysUn) const;
+
+protected:
+
+    cv::Size mImSize;
+
+    // Grid nodes, row-major
+    int mnCols, mnRows;
+    std::vector<float> mvMapX;
+    std::vector<float> mvMapY;
+};
+
+} //namespace ORB_SLAM
+
+#endif // UNDISTORTIONMAP_H
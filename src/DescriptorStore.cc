@@ -0,0 +1,64 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "DescriptorStore.h"
+
+namespace ORB_SLAM2
+{
+
+cv::Mat DescriptorStore::Allocate(int N)
+{
+    if(N<=0)
+        return cv::Mat();
+
+    // Over-allocate a single row and take an aligned sub-range. A single row range
+    // is continuous, so it can be reshaped to N rows sharing the same buffer.
+    cv::Mat buffer(1,N*DESCRIPTOR_BYTES+ALIGNMENT,CV_8U);
+    const size_t misalignment = reinterpret_cast<size_t>(buffer.data) % ALIGNMENT;
+    const int offset = misalignment ? ALIGNMENT-static_cast<int>(misalignment) : 0;
+
+    return buffer.colRange(offset,offset+N*DESCRIPTOR_BYTES).reshape(1,N);
+}
+
+cv::Mat DescriptorStore::Clone(const cv::Mat &Descriptors)
+{
+    if(Descriptors.empty())
+        return cv::Mat();
+
+    cv::Mat D = Allocate(Descriptors.rows);
+    Descriptors.copyTo(D);
+    return D;
+}
+
+cv::Mat DescriptorStore::Share(const cv::Mat &Descriptors)
+{
+    if(IsAligned(Descriptors))
+        return Descriptors;
+
+    return Clone(Descriptors);
+}
+
+bool DescriptorStore::IsAligned(const cv::Mat &Descriptors)
+{
+    return Descriptors.empty() ||
+           (Descriptors.isContinuous() && reinterpret_cast<size_t>(Descriptors.data) % ALIGNMENT == 0);
+}
+
+} //namespace ORB_SLAM
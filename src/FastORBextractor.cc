@@ -0,0 +1,80 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "FastORBextractor.h"
+
+#include <cmath>
+
+using namespace cv;
+using namespace std;
+
+namespace ORB_SLAM2
+{
+
+FastORBextractor::FastORBextractor(int _nfeatures, float _scaleFactor, int _nlevels,
+                                   int _iniThFAST, int _minThFAST):
+    ORBextractor(_nfeatures,_scaleFactor,std::min(_nlevels,(int)MAX_LEVELS),_iniThFAST,_minThFAST)
+{
+    mbBlurLevels = false;
+}
+
+vector<KeyPoint> FastORBextractor::DistributeKeyPoints(const vector<KeyPoint>& vToDistributeKeys, const int &minX,
+                                                       const int &maxX, const int &minY, const int &maxY, const int &N, const int &level)
+{
+    // No share of the features on this level (the grid below would have a single cell)
+    if(N<=0)
+        return vector<KeyPoint>();
+
+    if((int)vToDistributeKeys.size()<=N)
+        return vToDistributeKeys;
+
+    // Square cells, about N of them over the level
+    const float width = maxX-minX;
+    const float height = maxY-minY;
+    const float cellSize = sqrt(width*height/N);
+    const int nCols = max(1,cvRound(width/cellSize));
+    const int nRows = max(1,cvRound(height/cellSize));
+    const float invCellW = nCols/width;
+    const float invCellH = nRows/height;
+
+    // Index of the strongest keypoint of each cell (-1: empty)
+    vector<int> vBest(nCols*nRows,-1);
+    for(size_t i=0; i<vToDistributeKeys.size(); i++)
+    {
+        const KeyPoint &kp = vToDistributeKeys[i];
+        const int c = min(nCols-1,(int)(kp.pt.x*invCellW));
+        const int r = min(nRows-1,(int)(kp.pt.y*invCellH));
+        int &best = vBest[r*nCols+c];
+        if(best<0 || kp.response>vToDistributeKeys[best].response)
+            best = i;
+    }
+
+    vector<KeyPoint> vResultKeys;
+    vResultKeys.reserve(N);
+    for(size_t i=0; i<vBest.size(); i++)
+    {
+        if(vBest[i]>=0)
+            vResultKeys.push_back(vToDistributeKeys[vBest[i]]);
+    }
+
+    return vResultKeys;
+}
+
+} //namespace ORB_SLAM
@@ -0,0 +1,90 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "FeatureBudgetController.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+namespace ORB_SLAM2
+{
+
+// Gains of the controller, per frame
+const float BUDGET_DECREASE = 0.97f;
+const float BUDGET_INCREASE = 1.05f;
+const float SMOOTHING = 0.2f;
+// Tracking is comfortable above this multiple of the target inliers
+const float COMFORT_RATIO = 2.0f;
+// Budget granularity, avoids rebuilding the per-level counts for tiny changes
+const int BUDGET_STEP = 10;
+
+FeatureBudgetController::FeatureBudgetController(int nMinFeatures, int nMaxFeatures, int iniThFAST, int minThFAST,
+                                                 int nTargetInliers, float targetFrameTime):
+    mnMinFeatures(min(nMinFeatures,nMaxFeatures)), mnMaxFeatures(nMaxFeatures), mnBaseIniThFAST(iniThFAST),
+    mnMinThFAST(minThFAST), mnTargetInliers(nTargetInliers), mfTargetFrameTime(targetFrameTime),
+    mfInliers(nTargetInliers), mfFrameTime(0), mfFeatures(nMaxFeatures), mnFeatures(nMaxFeatures),
+    mnIniThFAST(iniThFAST)
+{
+}
+
+bool FeatureBudgetController::Update(int nInliers, float frameTime)
+{
+    mfFrameTime = mfFrameTime>0 ? (1-SMOOTHING)*mfFrameTime+SMOOTHING*frameTime : frameTime;
+
+    if(nInliers<mnTargetInliers)
+    {
+        // Weak or lost tracking: react immediately, up to the full budget if lost
+        mfInliers = nInliers;
+        const float deficit = 1.0f-static_cast<float>(nInliers)/mnTargetInliers;
+        mfFeatures *= 1.0f+deficit;
+        if(nInliers==0)
+            mfFeatures = mnMaxFeatures;
+    }
+    else
+    {
+        mfInliers = (1-SMOOTHING)*mfInliers+SMOOTHING*nInliers;
+
+        const bool bOverTime = mfTargetFrameTime>0 && mfFrameTime>mfTargetFrameTime;
+        if(bOverTime || mfInliers>COMFORT_RATIO*mnTargetInliers)
+            mfFeatures *= BUDGET_DECREASE;
+        else if(mfInliers<0.5f*(1.0f+COMFORT_RATIO)*mnTargetInliers)
+            mfFeatures *= BUDGET_INCREASE;
+    }
+
+    mfFeatures = max(static_cast<float>(mnMinFeatures),min(static_cast<float>(mnMaxFeatures),mfFeatures));
+
+    // Initial FAST threshold from its configured value (full budget) up to 1.5 times it (minimum budget)
+    const float range = max(mnMaxFeatures-mnMinFeatures,1);
+    const float r = (mfFeatures-mnMinFeatures)/range;
+    const int iniThFAST = max(mnMinThFAST,static_cast<int>(round(mnBaseIniThFAST*(1.5f-0.5f*r))));
+
+    const int nFeatures = max(mnMinFeatures,min(mnMaxFeatures,static_cast<int>(round(mfFeatures/BUDGET_STEP))*BUDGET_STEP));
+
+    if(nFeatures==mnFeatures && iniThFAST==mnIniThFAST)
+        return false;
+
+    mnFeatures = nFeatures;
+    mnIniThFAST = iniThFAST;
+    return true;
+}
+
+} //namespace ORB_SLAM
@@ -0,0 +1,146 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "FeatureExtractor.h"
+#include "ORBextractor.h"
+#include "FastORBextractor.h"
+#include "ThreadPool.h"
+
+using namespace std;
+
+namespace ORB_SLAM2
+{
+
+const string FeatureExtractor::ORB_BACKEND = "ORB";
+const string FeatureExtractor::FAST_BACKEND = "FAST";
+
+FeatureExtractor::FeatureExtractor(int _nfeatures, float _scaleFactor, int _nlevels):
+    nfeatures(_nfeatures), scaleFactor(_scaleFactor), nlevels(_nlevels), mpThreadPool(NULL)
+{
+    mvScaleFactor.resize(nlevels);
+    mvLevelSigma2.resize(nlevels);
+    mvScaleFactor[0]=1.0f;
+    mvLevelSigma2[0]=1.0f;
+    for(int i=1; i<nlevels; i++)
+    {
+        mvScaleFactor[i]=mvScaleFactor[i-1]*scaleFactor;
+        mvLevelSigma2[i]=mvScaleFactor[i]*mvScaleFactor[i];
+    }
+
+    mvInvScaleFactor.resize(nlevels);
+    mvInvLevelSigma2.resize(nlevels);
+    for(int i=0; i<nlevels; i++)
+    {
+        mvInvScaleFactor[i]=1.0f/mvScaleFactor[i];
+        mvInvLevelSigma2[i]=1.0f/mvLevelSigma2[i];
+    }
+
+    mvImagePyramid.resize(nlevels);
+}
+
+FeatureExtractor* FeatureExtractor::Create(const string &backend, int nfeatures, float scaleFactor,
+                                           int nlevels, int iniThFAST, int minThFAST)
+{
+    if(backend==ORB_BACKEND)
+        return new ORBextractor(nfeatures,scaleFactor,nlevels,iniThFAST,minThFAST);
+    else if(backend==FAST_BACKEND)
+        return new FastORBextractor(nfeatures,scaleFactor,nlevels,iniThFAST,minThFAST);
+
+    return NULL;
+}
+
+void FeatureExtractor::ExtractStereo(FeatureExtractor &left, const cv::Mat &imLeft,
+                                     vector<cv::KeyPoint> &keysLeft, cv::Mat &descLeft,
+                                     FeatureExtractor &right, const cv::Mat &imRight,
+                                     vector<cv::KeyPoint> &keysRight, cv::Mat &descRight,
+                                     ThreadPool* pThreadPool)
+{
+    if(imLeft.empty() || imRight.empty())
+    {
+        left(imLeft,cv::Mat(),keysLeft,descLeft);
+        right(imRight,cv::Mat(),keysRight,descRight);
+        return;
+    }
+
+    FeatureExtractor* vpExtractors[2] = {&left, &right};
+
+    // Levels of both images, interleaved so that the largest ones start first
+    vector<pair<FeatureExtractor*,int> > vLevels;
+    vLevels.reserve(left.nlevels+right.nlevels);
+    for(int level=0; level<max(left.nlevels,right.nlevels); level++)
+    {
+        for(int i=0; i<2; i++)
+            if(level<vpExtractors[i]->nlevels)
+                vLevels.push_back(make_pair(vpExtractors[i],level));
+    }
+
+    const function<void(int)> begin = [&](int i)
+    {
+        vpExtractors[i]->BeginExtraction(i==0 ? imLeft : imRight);
+    };
+    const function<void(int)> detect = [&](int i)
+    {
+        vLevels[i].first->DetectLevel(vLevels[i].second);
+    };
+    const function<void(int)> describe = [&](int i)
+    {
+        vLevels[i].first->DescribeLevel(vLevels[i].second);
+    };
+
+    if(pThreadPool)
+    {
+        pThreadPool->ParallelFor(2,begin);
+        pThreadPool->ParallelFor(vLevels.size(),detect);
+    }
+    else
+    {
+        begin(0);
+        begin(1);
+        for(size_t i=0; i<vLevels.size(); i++)
+            detect(i);
+    }
+
+    left.AllocateDescriptors(descLeft);
+    right.AllocateDescriptors(descRight);
+
+    if(pThreadPool)
+        pThreadPool->ParallelFor(vLevels.size(),describe);
+    else
+    {
+        for(size_t i=0; i<vLevels.size(); i++)
+            describe(i);
+    }
+
+    left.EndExtraction(keysLeft);
+    right.EndExtraction(keysRight);
+}
+
+void FeatureExtractor::ForEachLevel(const function<void(int)> &f)
+{
+    if(mpThreadPool)
+        mpThreadPool->ParallelFor(nlevels,f);
+    else
+    {
+        for (int level = 0; level < nlevels; ++level)
+            f(level);
+    }
+}
+
+} //namespace ORB_SLAM
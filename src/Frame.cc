@@ -21,17 +21,92 @@
 #include "Frame.h"
 #include "Converter.h"
 #include "ORBmatcher.h"
-#include <thread>
+#include "HammingDistance.h"
+#include "DescriptorStore.h"
+#include "ThreadPool.h"
+
+#ifdef __SSE2__
+#include <immintrin.h>
+#endif
 
 namespace ORB_SLAM2
 {
 
 long unsigned int Frame::nNextId=0;
 bool Frame::mbInitialComputations=true;
+ThreadPool* Frame::mpThreadPool=NULL;
+UndistortionMap Frame::mUndistortionMap;
 float Frame::cx, Frame::cy, Frame::fx, Frame::fy, Frame::invfx, Frame::invfy;
 float Frame::mnMinX, Frame::mnMinY, Frame::mnMaxX, Frame::mnMaxY;
 float Frame::mfGridElementWidthInv, Frame::mfGridElementHeightInv;
 
+// Half size of the stereo correlation patch and of the sliding window
+static const int STEREO_PATCH_W = 5;
+static const int STEREO_WINDOW_L = 5;
+
+// SAD between the left patch centered at pL and the right patches centered at pR-L..pR+L,
+// each patch minus its center value. Same values as cv::norm(IL,IR,NORM_L1) on the float patches.
+static void computeSlidingSAD(const uchar* pL, size_t stepL, const uchar* pR, size_t stepR, int* pDists)
+{
+    const int w = STEREO_PATCH_W;
+    const int L = STEREO_WINDOW_L;
+    const int cL = pL[0];
+
+#ifdef __SSE2__
+    // Window rows widened to 16 bits, lane k of a load at column c is the pixel c of the patch k-L
+    alignas(16) short strip[2*w+1][32];
+    for(int r=0; r<2*w+1; r++)
+    {
+        const uchar* row = pR+(r-w)*(ptrdiff_t)stepR-L-w;
+        for(int j=0; j<32; j++)
+            strip[r][j] = j<2*(L+w)+1 ? row[j] : 0;
+    }
+
+    // Center value of each right patch
+    const __m128i cR0 = _mm_loadu_si128((const __m128i*)(strip[w]+w));
+    const __m128i cR1 = _mm_loadu_si128((const __m128i*)(strip[w]+w+8));
+    const __m128i zero = _mm_setzero_si128();
+
+    // Differences are within [-510,510] and sums below 2^16
+    __m128i acc0 = zero, acc1 = zero;
+    for(int r=0; r<2*w+1; r++)
+    {
+        const uchar* rowL = pL+(r-w)*(ptrdiff_t)stepL-w;
+        for(int c=0; c<2*w+1; c++)
+        {
+            const __m128i l = _mm_set1_epi16(rowL[c]-cL);
+            __m128i d0 = _mm_sub_epi16(_mm_add_epi16(l,cR0),_mm_loadu_si128((const __m128i*)(strip[r]+c)));
+            __m128i d1 = _mm_sub_epi16(_mm_add_epi16(l,cR1),_mm_loadu_si128((const __m128i*)(strip[r]+c+8)));
+            d0 = _mm_max_epi16(d0,_mm_sub_epi16(zero,d0));
+            d1 = _mm_max_epi16(d1,_mm_sub_epi16(zero,d1));
+            acc0 = _mm_add_epi16(acc0,d0);
+            acc1 = _mm_add_epi16(acc1,d1);
+        }
+    }
+
+    alignas(16) unsigned short sums[16];
+    _mm_store_si128((__m128i*)sums,acc0);
+    _mm_store_si128((__m128i*)(sums+8),acc1);
+    for(int k=0; k<2*L+1; k++)
+        pDists[k] = sums[k];
+#else
+    for(int incR=-L; incR<=L; incR++)
+    {
+        const uchar* pRi = pR+incR;
+        const int cR = pRi[0];
+        int sad = 0;
+        for(int r=-w; r<=w; r++)
+        {
+            const uchar* rowL = pL+r*(ptrdiff_t)stepL;
+            const uchar* rowR = pRi+r*(ptrdiff_t)stepR;
+            for(int c=-w; c<=w; c++)
+                sad += abs((rowL[c]-cL)-(rowR[c]-cR));
+        }
+        pDists[L+incR] = sad;
+    }
+#endif
+}
+
 Frame::Frame()
 {}
 
@@ -42,28 +117,25 @@ Frame::Frame(const Frame &frame)
      mbf(frame.mbf), mb(frame.mb), mThDepth(frame.mThDepth), N(frame.N), mvKeys(frame.mvKeys),
      mvKeysRight(frame.mvKeysRight), mvKeysUn(frame.mvKeysUn),  mvuRight(frame.mvuRight),
      mvDepth(frame.mvDepth), mBowVec(frame.mBowVec), mFeatVec(frame.mFeatVec),
-     mDescriptors(frame.mDescriptors.clone()), mDescriptorsRight(frame.mDescriptorsRight.clone()),
-     mvpMapPoints(frame.mvpMapPoints), mvbOutlier(frame.mvbOutlier), mnId(frame.mnId),
+     mDescriptors(DescriptorStore::Share(frame.mDescriptors)), mDescriptorsRight(DescriptorStore::Share(frame.mDescriptorsRight)),
+     mvpMapPoints(frame.mvpMapPoints), mvbOutlier(frame.mvbOutlier),
+     mvGridStart(frame.mvGridStart), mvGridIndices(frame.mvGridIndices), mnId(frame.mnId),
      mpReferenceKF(frame.mpReferenceKF), mnScaleLevels(frame.mnScaleLevels),
      mfScaleFactor(frame.mfScaleFactor), mfLogScaleFactor(frame.mfLogScaleFactor),
      mvScaleFactors(frame.mvScaleFactors), mvInvScaleFactors(frame.mvInvScaleFactors),
      mvLevelSigma2(frame.mvLevelSigma2), mvInvLevelSigma2(frame.mvInvLevelSigma2)
 {
-    for(int i=0;i<FRAME_GRID_COLS;i++)
-        for(int j=0; j<FRAME_GRID_ROWS; j++)
-            mGrid[i][j]=frame.mGrid[i][j];
-
     if(!frame.mTcw.empty())
         SetPose(frame.mTcw);
 }
 
 
-Frame::Frame(const cv::Mat &imLeft, const cv::Mat &imRight, const double &timeStamp, ORBextractor* extractorLeft, ORBextractor* extractorRight, ORBVocabulary* voc, cv::Mat &K, cv::Mat &distCoef, const float &bf, const float &thDepth)
+Frame::Frame(const cv::Mat &imLeft, const cv::Mat &imRight, const double &timeStamp, FeatureExtractor* extractorLeft, FeatureExtractor* extractorRight, ORBVocabulary* voc, cv::Mat &K, cv::Mat &distCoef, const float &bf, const float &thDepth)
     :mpORBvocabulary(voc),mpORBextractorLeft(extractorLeft),mpORBextractorRight(extractorRight), mTimeStamp(timeStamp), mK(K.clone()),mDistCoef(distCoef.clone()), mbf(bf), mThDepth(thDepth),
      mpReferenceKF(static_cast<KeyFrame*>(NULL))
 {
-    // Frame ID
-    mnId=nNextId++;
+    // Frame ID, taken when the frame is tracked (AssignId)
+    mnId=0;
 
     // Scale Level Info
     mnScaleLevels = mpORBextractorLeft->GetLevels();
@@ -74,21 +146,23 @@ Frame::Frame(const cv::Mat &imLeft, const cv::Mat &imRight, const double &timeSt
     mvLevelSigma2 = mpORBextractorLeft->GetScaleSigmaSquares();
     mvInvLevelSigma2 = mpORBextractorLeft->GetInverseScaleSigmaSquares();
 
-    // ORB extraction
-    thread threadLeft(&Frame::ExtractORB,this,0,imLeft);
-    thread threadRight(&Frame::ExtractORB,this,1,imRight);
-    threadLeft.join();
-    threadRight.join();
+    // ORB extraction, the pyramid levels of both images in parallel
+    FeatureExtractor::ExtractStereo(*mpORBextractorLeft,imLeft,mvKeys,mDescriptors,
+                                    *mpORBextractorRight,imRight,mvKeysRight,mDescriptorsRight,mpThreadPool);
 
     N = mvKeys.size();
 
     if(mvKeys.empty())
         return;
 
-    UndistortKeyPoints();
+    UndistortKeyPoints(imLeft.size());
 
     ComputeStereoMatches();
 
+    // Right image features are only needed by the stereo matching
+    vector<cv::KeyPoint>().swap(mvKeysRight);
+    mDescriptorsRight.release();
+
     mvpMapPoints = vector<MapPoint*>(N,static_cast<MapPoint*>(NULL));    
     mvbOutlier = vector<bool>(N,false);
 
@@ -116,12 +190,13 @@ Frame::Frame(const cv::Mat &imLeft, const cv::Mat &imRight, const double &timeSt
     AssignFeaturesToGrid();
 }
 
-Frame::Frame(const cv::Mat &imGray, const cv::Mat &imDepth, const double &timeStamp, ORBextractor* extractor,ORBVocabulary* voc, cv::Mat &K, cv::Mat &distCoef, const float &bf, const float &thDepth)
-    :mpORBvocabulary(voc),mpORBextractorLeft(extractor),mpORBextractorRight(static_cast<ORBextractor*>(NULL)),
+Frame::Frame(const cv::Mat &imGray, const cv::Mat &imDepth, const double &timeStamp, FeatureExtractor* extractor,ORBVocabulary* voc, cv::Mat &K, cv::Mat &distCoef, const float &bf, const float &thDepth,
+             const float &depthMapFactor, const int depthMedianRadius)
+    :mpORBvocabulary(voc),mpORBextractorLeft(extractor),mpORBextractorRight(static_cast<FeatureExtractor*>(NULL)),
      mTimeStamp(timeStamp), mK(K.clone()),mDistCoef(distCoef.clone()), mbf(bf), mThDepth(thDepth)
 {
-    // Frame ID
-    mnId=nNextId++;
+    // Frame ID, taken when the frame is tracked (AssignId)
+    mnId=0;
 
     // Scale Level Info
     mnScaleLevels = mpORBextractorLeft->GetLevels();
@@ -140,9 +215,9 @@ Frame::Frame(const cv::Mat &imGray, const cv::Mat &imDepth, const double &timeSt
     if(mvKeys.empty())
         return;
 
-    UndistortKeyPoints();
+    UndistortKeyPoints(imGray.size());
 
-    ComputeStereoFromRGBD(imDepth);
+    ComputeStereoFromRGBD(imDepth,depthMapFactor,depthMedianRadius);
 
     mvpMapPoints = vector<MapPoint*>(N,static_cast<MapPoint*>(NULL));
     mvbOutlier = vector<bool>(N,false);
@@ -171,12 +246,12 @@ Frame::Frame(const cv::Mat &imGray, const cv::Mat &imDepth, const double &timeSt
 }
 
 
-Frame::Frame(const cv::Mat &imGray, const double &timeStamp, ORBextractor* extractor,ORBVocabulary* voc, cv::Mat &K, cv::Mat &distCoef, const float &bf, const float &thDepth)
-    :mpORBvocabulary(voc),mpORBextractorLeft(extractor),mpORBextractorRight(static_cast<ORBextractor*>(NULL)),
+Frame::Frame(const cv::Mat &imGray, const double &timeStamp, FeatureExtractor* extractor,ORBVocabulary* voc, cv::Mat &K, cv::Mat &distCoef, const float &bf, const float &thDepth)
+    :mpORBvocabulary(voc),mpORBextractorLeft(extractor),mpORBextractorRight(static_cast<FeatureExtractor*>(NULL)),
      mTimeStamp(timeStamp), mK(K.clone()),mDistCoef(distCoef.clone()), mbf(bf), mThDepth(thDepth)
 {
-    // Frame ID
-    mnId=nNextId++;
+    // Frame ID, taken when the frame is tracked (AssignId)
+    mnId=0;
 
     // Scale Level Info
     mnScaleLevels = mpORBextractorLeft->GetLevels();
@@ -195,7 +270,7 @@ Frame::Frame(const cv::Mat &imGray, const double &timeStamp, ORBextractor* extra
     if(mvKeys.empty())
         return;
 
-    UndistortKeyPoints();
+    UndistortKeyPoints(imGray.size());
 
     // Set no stereo information
     mvuRight = vector<float>(N,-1);
@@ -229,19 +304,33 @@ Frame::Frame(const cv::Mat &imGray, const double &timeStamp, ORBextractor* extra
 
 void Frame::AssignFeaturesToGrid()
 {
-    int nReserve = 0.5f*N/(FRAME_GRID_COLS*FRAME_GRID_ROWS);
-    for(unsigned int i=0; i<FRAME_GRID_COLS;i++)
-        for (unsigned int j=0; j<FRAME_GRID_ROWS;j++)
-            mGrid[i][j].reserve(nReserve);
+    const int nCells = FRAME_GRID_COLS*FRAME_GRID_ROWS;
 
+    // Counting sort of the keypoints by cell, each cell keeps the keypoint order
+    vector<int> vCell(N);
+    mvGridStart.assign(nCells+1,0);
     for(int i=0;i<N;i++)
     {
         const cv::KeyPoint &kp = mvKeysUn[i];
 
         int nGridPosX, nGridPosY;
         if(PosInGrid(kp,nGridPosX,nGridPosY))
-            mGrid[nGridPosX][nGridPosY].push_back(i);
+        {
+            vCell[i] = nGridPosX*FRAME_GRID_ROWS+nGridPosY;
+            mvGridStart[vCell[i]+1]++;
+        }
+        else
+            vCell[i] = -1;
     }
+
+    for(int k=0; k<nCells; k++)
+        mvGridStart[k+1] += mvGridStart[k];
+
+    mvGridIndices.resize(mvGridStart[nCells]);
+    vector<unsigned int> vNext(mvGridStart.begin(),mvGridStart.end()-1);
+    for(int i=0;i<N;i++)
+        if(vCell[i]>=0)
+            mvGridIndices[vNext[vCell[i]]++] = i;
 }
 
 void Frame::ExtractORB(int flag, const cv::Mat &im)
@@ -252,6 +341,11 @@ void Frame::ExtractORB(int flag, const cv::Mat &im)
         (*mpORBextractorRight)(im,cv::Mat(),mvKeysRight,mDescriptorsRight);
 }
 
+void Frame::AssignId()
+{
+    mnId=nNextId++;
+}
+
 void Frame::SetPose(cv::Mat Tcw)
 {
     mTcw = Tcw.clone();
@@ -329,6 +423,9 @@ vector<size_t> Frame::GetFeaturesInArea(const float &x, const float  &y, const f
     vector<size_t> vIndices;
     vIndices.reserve(N);
 
+    if(mvGridStart.empty())
+        return vIndices;
+
     const int nMinCellX = max(0,(int)floor((x-mnMinX-r)*mfGridElementWidthInv));
     if(nMinCellX>=FRAME_GRID_COLS)
         return vIndices;
@@ -347,32 +444,30 @@ vector<size_t> Frame::GetFeaturesInArea(const float &x, const float  &y, const f
 
     const bool bCheckLevels = (minLevel>0) || (maxLevel>=0);
 
+    // The cells of a grid column are contiguous, so are their keypoints
     for(int ix = nMinCellX; ix<=nMaxCellX; ix++)
     {
-        for(int iy = nMinCellY; iy<=nMaxCellY; iy++)
-        {
-            const vector<size_t> vCell = mGrid[ix][iy];
-            if(vCell.empty())
-                continue;
+        const unsigned int jbegin = mvGridStart[ix*FRAME_GRID_ROWS+nMinCellY];
+        const unsigned int jend = mvGridStart[ix*FRAME_GRID_ROWS+nMaxCellY+1];
 
-            for(size_t j=0, jend=vCell.size(); j<jend; j++)
+        for(unsigned int j=jbegin; j<jend; j++)
+        {
+            const unsigned int idx = mvGridIndices[j];
+            const cv::KeyPoint &kpUn = mvKeysUn[idx];
+            if(bCheckLevels)
             {
-                const cv::KeyPoint &kpUn = mvKeysUn[vCell[j]];
-                if(bCheckLevels)
-                {
-                    if(kpUn.octave<minLevel)
+                if(kpUn.octave<minLevel)
+                    continue;
+                if(maxLevel>=0)
+                    if(kpUn.octave>maxLevel)
                         continue;
-                    if(maxLevel>=0)
-                        if(kpUn.octave>maxLevel)
-                            continue;
-                }
+            }
 
-                const float distx = kpUn.pt.x-x;
-                const float disty = kpUn.pt.y-y;
+            const float distx = kpUn.pt.x-x;
+            const float disty = kpUn.pt.y-y;
 
-                if(fabs(distx)<r && fabs(disty)<r)
-                    vIndices.push_back(vCell[j]);
-            }
+            if(fabs(distx)<r && fabs(disty)<r)
+                vIndices.push_back(idx);
         }
     }
 
@@ -401,7 +496,17 @@ void Frame::ComputeBoW()
     }
 }
 
-void Frame::UndistortKeyPoints()
+// Undistorts the points with cv::undistortPoints, when the undistortion table does not cover the image
+static void UndistortPointsDirect(vector<cv::Point2f> &vPoints, const cv::Mat &K, const cv::Mat &distCoef)
+{
+    if(vPoints.empty())
+        return;
+
+    cv::Mat mat(vPoints.size(),1,CV_32FC2,&vPoints[0]);
+    cv::undistortPoints(mat,mat,K,distCoef,cv::Mat(),K);
+}
+
+void Frame::UndistortKeyPoints(const cv::Size &imSize)
 {
     if(mDistCoef.at<float>(0)==0.0)
     {
@@ -409,49 +514,48 @@ void Frame::UndistortKeyPoints()
         return;
     }
 
-    // Fill matrix with points
-    cv::Mat mat(N,2,CV_32F);
-    for(int i=0; i<N; i++)
+    // Tracking builds the table before the frame, the constructor only reads it
+    if(mUndistortionMap.IsBuilt(imSize))
     {
-        mat.at<float>(i,0)=mvKeys[i].pt.x;
-        mat.at<float>(i,1)=mvKeys[i].pt.y;
+        mUndistortionMap.Undistort(mvKeys,mvKeysUn);
+        return;
     }
 
-    // Undistort points
-    mat=mat.reshape(2);
-    cv::undistortPoints(mat,mat,mK,mDistCoef,cv::Mat(),mK);
-    mat=mat.reshape(1);
+    vector<cv::Point2f> vPoints(N);
+    for(int i=0; i<N; i++)
+        vPoints[i] = mvKeys[i].pt;
+
+    UndistortPointsDirect(vPoints,mK,mDistCoef);
 
-    // Fill undistorted keypoint vector
-    mvKeysUn.resize(N);
+    mvKeysUn = mvKeys;
     for(int i=0; i<N; i++)
-    {
-        cv::KeyPoint kp = mvKeys[i];
-        kp.pt.x=mat.at<float>(i,0);
-        kp.pt.y=mat.at<float>(i,1);
-        mvKeysUn[i]=kp;
-    }
+        mvKeysUn[i].pt = vPoints[i];
 }
 
 void Frame::ComputeImageBounds(const cv::Mat &imLeft)
 {
     if(mDistCoef.at<float>(0)!=0.0)
     {
-        cv::Mat mat(4,2,CV_32F);
-        mat.at<float>(0,0)=0.0; mat.at<float>(0,1)=0.0;
-        mat.at<float>(1,0)=imLeft.cols; mat.at<float>(1,1)=0.0;
-        mat.at<float>(2,0)=0.0; mat.at<float>(2,1)=imLeft.rows;
-        mat.at<float>(3,0)=imLeft.cols; mat.at<float>(3,1)=imLeft.rows;
+        // Corners: (0,0), (cols,0), (0,rows), (cols,rows)
+        vector<cv::Point2f> vCorners(4);
+        vCorners[0] = cv::Point2f(0.0f,0.0f);
+        vCorners[1] = cv::Point2f(imLeft.cols,0.0f);
+        vCorners[2] = cv::Point2f(0.0f,imLeft.rows);
+        vCorners[3] = cv::Point2f(imLeft.cols,imLeft.rows);
 
         // Undistort corners
-        mat=mat.reshape(2);
-        cv::undistortPoints(mat,mat,mK,mDistCoef,cv::Mat(),mK);
-        mat=mat.reshape(1);
+        if(mUndistortionMap.IsBuilt(imLeft.size()))
+        {
+            for(int i=0; i<4; i++)
+                vCorners[i] = mUndistortionMap.Undistort(vCorners[i].x,vCorners[i].y);
+        }
+        else
+            UndistortPointsDirect(vCorners,mK,mDistCoef);
 
-        mnMinX = min(mat.at<float>(0,0),mat.at<float>(2,0));
-        mnMaxX = max(mat.at<float>(1,0),mat.at<float>(3,0));
-        mnMinY = min(mat.at<float>(0,1),mat.at<float>(1,1));
-        mnMaxY = max(mat.at<float>(2,1),mat.at<float>(3,1));
+        mnMinX = min(vCorners[0].x,vCorners[2].x);
+        mnMaxX = max(vCorners[1].x,vCorners[3].x);
+        mnMinY = min(vCorners[0].y,vCorners[1].y);
+        mnMaxY = max(vCorners[2].y,vCorners[3].y);
 
     }
     else
@@ -472,24 +576,37 @@ void Frame::ComputeStereoMatches()
 
     const int nRows = mpORBextractorLeft->mvImagePyramid[0].rows;
 
-    //Assign keypoints to row table
-    vector<vector<size_t> > vRowIndices(nRows,vector<size_t>());
-
-    for(int i=0; i<nRows; i++)
-        vRowIndices[i].reserve(200);
+    //Assign keypoints to row table. Right keypoints of row y are vRowIndices[vRowStart[y]..vRowStart[y+1]),
+    //the buffers are reused across frames
+    static thread_local vector<unsigned int> stvRowStart;
+    static thread_local vector<unsigned int> stvRowIndices;
+    vector<unsigned int> &vRowStart = stvRowStart;
+    vector<unsigned int> &vRowIndices = stvRowIndices;
 
     const int Nr = mvKeysRight.size();
 
+    vector<int> vMinRow(Nr), vMaxRow(Nr);
+    vRowStart.assign(nRows+1,0);
     for(int iR=0; iR<Nr; iR++)
     {
         const cv::KeyPoint &kp = mvKeysRight[iR];
         const float &kpY = kp.pt.y;
         const float r = 2.0f*mvScaleFactors[mvKeysRight[iR].octave];
-        const int maxr = ceil(kpY+r);
-        const int minr = floor(kpY-r);
+        vMaxRow[iR] = min((int)ceil(kpY+r),nRows-1);
+        vMinRow[iR] = max((int)floor(kpY-r),0);
 
-        for(int yi=minr;yi<=maxr;yi++)
-            vRowIndices[yi].push_back(iR);
+        for(int yi=vMinRow[iR];yi<=vMaxRow[iR];yi++)
+            vRowStart[yi+1]++;
+    }
+    for(int yi=0; yi<nRows; yi++)
+        vRowStart[yi+1] += vRowStart[yi];
+
+    vRowIndices.resize(vRowStart[nRows]);
+    {
+        vector<unsigned int> vNext(vRowStart.begin(),vRowStart.end()-1);
+        for(int iR=0; iR<Nr; iR++)
+            for(int yi=vMinRow[iR];yi<=vMaxRow[iR];yi++)
+                vRowIndices[vNext[yi]++] = iR;
     }
 
     // Set limits for search
@@ -497,131 +614,167 @@ void Frame::ComputeStereoMatches()
     const float minD = 0;
     const float maxD = mbf/minZ;
 
-    // For each left keypoint search a match in the right image
-    vector<pair<int, int> > vDistIdx;
-    vDistIdx.reserve(N);
-
+    // Left keypoints are split in row bands, each band is matched by one task
+    const int nBands = mpThreadPool ? min(4*mpThreadPool->GetNumThreads(),nRows) : 1;
+    vector<int> vBandStart(nBands+1,0);
+    vector<int> vBandKeys(N);
     for(int iL=0; iL<N; iL++)
+        vBandStart[(int)mvKeys[iL].pt.y*nBands/nRows+1]++;
+    for(int b=0; b<nBands; b++)
+        vBandStart[b+1] += vBandStart[b];
     {
-        const cv::KeyPoint &kpL = mvKeys[iL];
-        const int &levelL = kpL.octave;
-        const float &vL = kpL.pt.y;
-        const float &uL = kpL.pt.x;
+        vector<int> vNext(vBandStart.begin(),vBandStart.end()-1);
+        for(int iL=0; iL<N; iL++)
+            vBandKeys[vNext[(int)mvKeys[iL].pt.y*nBands/nRows]++] = iL;
+    }
 
-        const vector<size_t> &vCandidates = vRowIndices[vL];
+    // For each left keypoint search a match in the right image
+    vector<vector<pair<int, int> > > vBandDistIdx(nBands);
 
-        if(vCandidates.empty())
-            continue;
+    const function<void(int)> matchBand = [&](int b)
+    {
+        vector<pair<int, int> > &vDistIdx = vBandDistIdx[b];
+        vDistIdx.reserve(vBandStart[b+1]-vBandStart[b]);
 
-        const float minU = uL-maxD;
-        const float maxU = uL-minD;
+        vector<int> vCandidateDists;
 
-        if(maxU<0)
-            continue;
+        for(int k=vBandStart[b]; k<vBandStart[b+1]; k++)
+        {
+            const int iL = vBandKeys[k];
+            const cv::KeyPoint &kpL = mvKeys[iL];
+            const int &levelL = kpL.octave;
+            const float &vL = kpL.pt.y;
+            const float &uL = kpL.pt.x;
 
-        int bestDist = ORBmatcher::TH_HIGH;
-        size_t bestIdxR = 0;
+            const unsigned int* pCandidates = vRowIndices.data()+vRowStart[(int)vL];
+            const int nCandidates = vRowStart[(int)vL+1]-vRowStart[(int)vL];
 
-        const cv::Mat &dL = mDescriptors.row(iL);
+            if(nCandidates==0)
+                continue;
 
-        // Compare descriptor to right keypoints
-        for(size_t iC=0; iC<vCandidates.size(); iC++)
-        {
-            const size_t iR = vCandidates[iC];
-            const cv::KeyPoint &kpR = mvKeysRight[iR];
+            const float minU = uL-maxD;
+            const float maxU = uL-minD;
 
-            if(kpR.octave<levelL-1 || kpR.octave>levelL+1)
+            if(maxU<0)
                 continue;
 
-            const float &uR = kpR.pt.x;
+            int bestDist = ORBmatcher::TH_HIGH;
+            size_t bestIdxR = 0;
+
+            vCandidateDists.resize(nCandidates);
+            HammingDistance::ComputeOneToMany(mDescriptors.ptr<uchar>(iL),mDescriptorsRight.ptr<uchar>(),mDescriptorsRight.step[0],
+                                              pCandidates,nCandidates,&vCandidateDists[0]);
 
-            if(uR>=minU && uR<=maxU)
+            // Compare descriptor to right keypoints
+            for(int iC=0; iC<nCandidates; iC++)
             {
-                const cv::Mat &dR = mDescriptorsRight.row(iR);
-                const int dist = ORBmatcher::DescriptorDistance(dL,dR);
+                const size_t iR = pCandidates[iC];
+                const cv::KeyPoint &kpR = mvKeysRight[iR];
 
-                if(dist<bestDist)
+                if(kpR.octave<levelL-1 || kpR.octave>levelL+1)
+                    continue;
+
+                const float &uR = kpR.pt.x;
+
+                if(uR>=minU && uR<=maxU)
                 {
-                    bestDist = dist;
-                    bestIdxR = iR;
+                    const int dist = vCandidateDists[iC];
+
+                    if(dist<bestDist)
+                    {
+                        bestDist = dist;
+                        bestIdxR = iR;
+                    }
                 }
             }
-        }
 
-        // Subpixel match by correlation
-        if(bestDist<thOrbDist)
-        {
-            // coordinates in image pyramid at keypoint scale
-            const float uR0 = mvKeysRight[bestIdxR].pt.x;
-            const float scaleFactor = mvInvScaleFactors[kpL.octave];
-            const float scaleduL = round(kpL.pt.x*scaleFactor);
-            const float scaledvL = round(kpL.pt.y*scaleFactor);
-            const float scaleduR0 = round(uR0*scaleFactor);
-
-            // sliding window search
-            const int w = 5;
-            cv::Mat IL = mpORBextractorLeft->mvImagePyramid[kpL.octave].rowRange(scaledvL-w,scaledvL+w+1).colRange(scaleduL-w,scaleduL+w+1);
-            IL.convertTo(IL,CV_32F);
-            IL = IL - IL.at<float>(w,w) *cv::Mat::ones(IL.rows,IL.cols,CV_32F);
-
-            int bestDist = INT_MAX;
-            int bestincR = 0;
-            const int L = 5;
-            vector<float> vDists;
-            vDists.resize(2*L+1);
-
-            const float iniu = scaleduR0+L-w;
-            const float endu = scaleduR0+L+w+1;
-            if(iniu<0 || endu >= mpORBextractorRight->mvImagePyramid[kpL.octave].cols)
-                continue;
-
-            for(int incR=-L; incR<=+L; incR++)
+            // Subpixel match by correlation
+            if(bestDist<thOrbDist)
             {
-                cv::Mat IR = mpORBextractorRight->mvImagePyramid[kpL.octave].rowRange(scaledvL-w,scaledvL+w+1).colRange(scaleduR0+incR-w,scaleduR0+incR+w+1);
-                IR.convertTo(IR,CV_32F);
-                IR = IR - IR.at<float>(w,w) *cv::Mat::ones(IR.rows,IR.cols,CV_32F);
-
-                float dist = cv::norm(IL,IR,cv::NORM_L1);
-                if(dist<bestDist)
+                // coordinates in image pyramid at keypoint scale
+                const float uR0 = mvKeysRight[bestIdxR].pt.x;
+                const float scaleFactor = mvInvScaleFactors[kpL.octave];
+                const float scaleduL = round(kpL.pt.x*scaleFactor);
+                const float scaledvL = round(kpL.pt.y*scaleFactor);
+                const float scaleduR0 = round(uR0*scaleFactor);
+
+                // sliding window search
+                const int w = STEREO_PATCH_W;
+                const int L = STEREO_WINDOW_L;
+
+                const float iniu = scaleduR0-L-w;
+                const float endu = scaleduR0+L+w+1;
+                if(iniu<0 || endu >= mpORBextractorRight->mvImagePyramid[kpL.octave].cols)
+                    continue;
+
+                const cv::Mat &imL = mpORBextractorLeft->mvImagePyramid[kpL.octave];
+                const cv::Mat &imR = mpORBextractorRight->mvImagePyramid[kpL.octave];
+                int vSAD[2*L+1];
+                computeSlidingSAD(imL.ptr<uchar>((int)scaledvL)+(int)scaleduL,imL.step[0],
+                                  imR.ptr<uchar>((int)scaledvL)+(int)scaleduR0,imR.step[0],vSAD);
+
+                int bestDist = INT_MAX;
+                int bestincR = 0;
+                vector<float> vDists;
+                vDists.resize(2*L+1);
+
+                for(int incR=-L; incR<=+L; incR++)
                 {
-                    bestDist =  dist;
-                    bestincR = incR;
+                    float dist = vSAD[L+incR];
+                    if(dist<bestDist)
+                    {
+                        bestDist =  dist;
+                        bestincR = incR;
+                    }
+
+                    vDists[L+incR] = dist;
                 }
 
-                vDists[L+incR] = dist;
-            }
+                if(bestincR==-L || bestincR==L)
+                    continue;
 
-            if(bestincR==-L || bestincR==L)
-                continue;
+                // Sub-pixel match (Parabola fitting)
+                const float dist1 = vDists[L+bestincR-1];
+                const float dist2 = vDists[L+bestincR];
+                const float dist3 = vDists[L+bestincR+1];
 
-            // Sub-pixel match (Parabola fitting)
-            const float dist1 = vDists[L+bestincR-1];
-            const float dist2 = vDists[L+bestincR];
-            const float dist3 = vDists[L+bestincR+1];
+                const float deltaR = (dist1-dist3)/(2.0f*(dist1+dist3-2.0f*dist2));
 
-            const float deltaR = (dist1-dist3)/(2.0f*(dist1+dist3-2.0f*dist2));
+                if(deltaR<-1 || deltaR>1)
+                    continue;
 
-            if(deltaR<-1 || deltaR>1)
-                continue;
-
-            // Re-scaled coordinate
-            float bestuR = mvScaleFactors[kpL.octave]*((float)scaleduR0+(float)bestincR+deltaR);
+                // Re-scaled coordinate
+                float bestuR = mvScaleFactors[kpL.octave]*((float)scaleduR0+(float)bestincR+deltaR);
 
-            float disparity = (uL-bestuR);
+                float disparity = (uL-bestuR);
 
-            if(disparity>=minD && disparity<maxD)
-            {
-                if(disparity<=0)
+                if(disparity>=minD && disparity<maxD)
                 {
-                    disparity=0.01;
-                    bestuR = uL-0.01;
+                    if(disparity<=0)
+                    {
+                        disparity=0.01;
+                        bestuR = uL-0.01;
+                    }
+                    mvDepth[iL]=mbf/disparity;
+                    mvuRight[iL] = bestuR;
+                    vDistIdx.push_back(pair<int,int>(bestDist,iL));
                 }
-                mvDepth[iL]=mbf/disparity;
-                mvuRight[iL] = bestuR;
-                vDistIdx.push_back(pair<int,int>(bestDist,iL));
             }
         }
-    }
+    };
+
+    if(mpThreadPool)
+        mpThreadPool->ParallelFor(nBands,matchBand);
+    else
+        matchBand(0);
+
+    vector<pair<int, int> > vDistIdx;
+    vDistIdx.reserve(N);
+    for(int b=0; b<nBands; b++)
+        vDistIdx.insert(vDistIdx.end(),vBandDistIdx[b].begin(),vBandDistIdx[b].end());
+
+    if(vDistIdx.empty())
+        return;
 
     sort(vDistIdx.begin(),vDistIdx.end());
     const float median = vDistIdx[vDistIdx.size()/2].first;
@@ -640,11 +793,43 @@ void Frame::ComputeStereoMatches()
 }
 
 
-void Frame::ComputeStereoFromRGBD(const cv::Mat &imDepth)
+// Depth map value at (u,v), or median of the valid (positive) values in the
+// (2r+1)x(2r+1) neighborhood (0 if there is none)
+template<typename T>
+static float sampleDepth(const cv::Mat &imDepth, const int u, const int v, const int r, vector<float> &vBuffer)
+{
+    if(r<=0)
+        return imDepth.at<T>(v,u);
+
+    vBuffer.clear();
+    for(int y=max(v-r,0); y<=min(v+r,imDepth.rows-1); y++)
+    {
+        const T* row = imDepth.ptr<T>(y);
+        for(int x=max(u-r,0); x<=min(u+r,imDepth.cols-1); x++)
+            if(row[x]>0)
+                vBuffer.push_back(row[x]);
+    }
+
+    if(vBuffer.empty())
+        return 0;
+
+    vector<float>::iterator mid = vBuffer.begin()+vBuffer.size()/2;
+    nth_element(vBuffer.begin(),mid,vBuffer.end());
+    return *mid;
+}
+
+void Frame::ComputeStereoFromRGBD(const cv::Mat &imDepth, const float depthMapFactor, const int medianRadius)
 {
     mvuRight = vector<float>(N,-1);
     mvDepth = vector<float>(N,-1);
 
+    // Raw depth maps are only scaled at the keypoints
+    const bool bRaw = imDepth.type()==CV_16U;
+    const float scale = bRaw ? depthMapFactor : 1.0f;
+
+    vector<float> vBuffer;
+    vBuffer.reserve((2*medianRadius+1)*(2*medianRadius+1));
+
     for(int i=0; i<N; i++)
     {
         const cv::KeyPoint &kp = mvKeys[i];
@@ -653,7 +838,8 @@ void Frame::ComputeStereoFromRGBD(const cv::Mat &imDepth)
         const float &v = kp.pt.y;
         const float &u = kp.pt.x;
 
-        const float d = imDepth.at<float>(v,u);
+        const float d = scale*(bRaw ? sampleDepth<unsigned short>(imDepth,u,v,medianRadius,vBuffer)
+                                    : sampleDepth<float>(imDepth,u,v,medianRadius,vBuffer));
 
         if(d>0)
         {
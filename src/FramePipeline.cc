@@ -0,0 +1,128 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "FramePipeline.h"
+
+using namespace std;
+
+namespace ORB_SLAM2
+{
+
+FramePipeline::FramePipeline(int nCapacity):
+    mnCapacity(max(nCapacity,1)), mnStarted(0), mbRunning(false), mbStop(false)
+{
+    mWorker = thread(&FramePipeline::Run,this);
+}
+
+FramePipeline::~FramePipeline()
+{
+    {
+        unique_lock<mutex> lock(mMutex);
+        mbStop = true;
+    }
+    mCond.notify_all();
+    mWorker.join();
+}
+
+void FramePipeline::Submit(const Job &job)
+{
+    shared_ptr<Entry> pEntry = make_shared<Entry>();
+    pEntry->job = job;
+    pEntry->pOutput = make_shared<Output>();
+    pEntry->pOutput->tSubmitted = chrono::steady_clock::now();
+    pEntry->bDone = false;
+
+    {
+        unique_lock<mutex> lock(mMutex);
+        while((int)mdEntries.size()>=mnCapacity)
+            mCond.wait(lock);
+        mdEntries.push_back(pEntry);
+    }
+    mCond.notify_all();
+}
+
+int FramePipeline::Size()
+{
+    unique_lock<mutex> lock(mMutex);
+    return mdEntries.size();
+}
+
+shared_ptr<FramePipeline::Output> FramePipeline::Retrieve()
+{
+    shared_ptr<Entry> pEntry;
+    {
+        unique_lock<mutex> lock(mMutex);
+        if(mdEntries.empty())
+            return shared_ptr<Output>();
+
+        pEntry = mdEntries.front();
+        while(!pEntry->bDone)
+            mCond.wait(lock);
+
+        mdEntries.pop_front();
+        mnStarted--;
+    }
+    mCond.notify_all();
+
+    return pEntry->pOutput;
+}
+
+void FramePipeline::Clear()
+{
+    {
+        unique_lock<mutex> lock(mMutex);
+        while(mbRunning)
+            mCond.wait(lock);
+        mdEntries.clear();
+        mnStarted = 0;
+    }
+    mCond.notify_all();
+}
+
+void FramePipeline::Run()
+{
+    while(true)
+    {
+        shared_ptr<Entry> pEntry;
+        {
+            unique_lock<mutex> lock(mMutex);
+            while(!mbStop && mnStarted>=mdEntries.size())
+                mCond.wait(lock);
+            if(mbStop)
+                return;
+            pEntry = mdEntries[mnStarted++];
+            mbRunning = true;
+        }
+
+        const chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+        Output &output = *pEntry->pOutput;
+        pEntry->job(output.frame,output.imGray);
+        output.dPreprocessTime = chrono::duration_cast<chrono::duration<double> >(chrono::steady_clock::now()-t0).count();
+
+        {
+            unique_lock<mutex> lock(mMutex);
+            pEntry->bDone = true;
+            mbRunning = false;
+        }
+        mCond.notify_all();
+    }
+}
+
+} //namespace ORB_SLAM
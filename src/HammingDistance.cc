@@ -0,0 +1,307 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "HammingDistance.h"
+
+#include<cstring>
+#include<stdint.h>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define HAMMING_X86_DISPATCH
+#include<immintrin.h>
+#if (defined(__clang__) && __clang_major__ >= 7) || (!defined(__clang__) && __GNUC__ >= 8)
+#define HAMMING_AVX512
+#endif
+#endif
+
+namespace ORB_SLAM2
+{
+
+namespace
+{
+
+// Bit set count operation from
+// http://graphics.stanford.edu/~seander/bithacks.html#CountBitsSetParallel
+int PairScalar(const unsigned char* a, const unsigned char* b)
+{
+    const int *pa = reinterpret_cast<const int*>(a);
+    const int *pb = reinterpret_cast<const int*>(b);
+
+    int dist=0;
+
+    for(int i=0; i<8; i++, pa++, pb++)
+    {
+        unsigned  int v = *pa ^ *pb;
+        v = v - ((v >> 1) & 0x55555555);
+        v = (v & 0x33333333) + ((v >> 2) & 0x33333333);
+        dist += (((v + (v >> 4)) & 0xF0F0F0F) * 0x1010101) >> 24;
+    }
+
+    return dist;
+}
+
+void ContiguousScalar(const unsigned char* q, const unsigned char* pRows, size_t step, int N, int* pDists)
+{
+    for(int i=0; i<N; i++)
+        pDists[i] = PairScalar(q,pRows+i*step);
+}
+
+void IndexedScalar(const unsigned char* q, const unsigned char* pRows, size_t step, const size_t* pIdx, int N, int* pDists)
+{
+    for(int i=0; i<N; i++)
+        pDists[i] = PairScalar(q,pRows+pIdx[i]*step);
+}
+
+void Indexed32Scalar(const unsigned char* q, const unsigned char* pRows, size_t step, const unsigned int* pIdx, int N, int* pDists)
+{
+    for(int i=0; i<N; i++)
+        pDists[i] = PairScalar(q,pRows+pIdx[i]*step);
+}
+
+#ifdef HAMMING_X86_DISPATCH
+
+// POPCNT: four 64-bit words per descriptor
+
+__attribute__((target("popcnt")))
+inline int PairPopcntInline(const unsigned char* a, const unsigned char* b)
+{
+    uint64_t wa[4], wb[4];
+    memcpy(wa,a,32);
+    memcpy(wb,b,32);
+    return static_cast<int>(_mm_popcnt_u64(wa[0]^wb[0]) + _mm_popcnt_u64(wa[1]^wb[1]) +
+                            _mm_popcnt_u64(wa[2]^wb[2]) + _mm_popcnt_u64(wa[3]^wb[3]));
+}
+
+__attribute__((target("popcnt")))
+int PairPopcnt(const unsigned char* a, const unsigned char* b)
+{
+    return PairPopcntInline(a,b);
+}
+
+__attribute__((target("popcnt")))
+void ContiguousPopcnt(const unsigned char* q, const unsigned char* pRows, size_t step, int N, int* pDists)
+{
+    for(int i=0; i<N; i++)
+        pDists[i] = PairPopcntInline(q,pRows+i*step);
+}
+
+__attribute__((target("popcnt")))
+void IndexedPopcnt(const unsigned char* q, const unsigned char* pRows, size_t step, const size_t* pIdx, int N, int* pDists)
+{
+    for(int i=0; i<N; i++)
+        pDists[i] = PairPopcntInline(q,pRows+pIdx[i]*step);
+}
+
+__attribute__((target("popcnt")))
+void Indexed32Popcnt(const unsigned char* q, const unsigned char* pRows, size_t step, const unsigned int* pIdx, int N, int* pDists)
+{
+    for(int i=0; i<N; i++)
+        pDists[i] = PairPopcntInline(q,pRows+pIdx[i]*step);
+}
+
+// AVX2: nibble lookup table with vpshufb, byte counts summed with vpsadbw
+
+__attribute__((target("avx2")))
+inline int XorCountAvx2(const __m256i q, const unsigned char* b)
+{
+    const __m256i lut = _mm256_setr_epi8(0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4,
+                                         0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4);
+    const __m256i low = _mm256_set1_epi8(0x0f);
+
+    const __m256i v = _mm256_xor_si256(q,_mm256_loadu_si256(reinterpret_cast<const __m256i*>(b)));
+    const __m256i cntLo = _mm256_shuffle_epi8(lut,_mm256_and_si256(v,low));
+    const __m256i cntHi = _mm256_shuffle_epi8(lut,_mm256_and_si256(_mm256_srli_epi16(v,4),low));
+    const __m256i sad = _mm256_sad_epu8(_mm256_add_epi8(cntLo,cntHi),_mm256_setzero_si256());
+    const __m128i s = _mm_add_epi64(_mm256_castsi256_si128(sad),_mm256_extracti128_si256(sad,1));
+    return _mm_cvtsi128_si32(_mm_add_epi64(s,_mm_unpackhi_epi64(s,s)));
+}
+
+__attribute__((target("avx2")))
+int PairAvx2(const unsigned char* a, const unsigned char* b)
+{
+    return XorCountAvx2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a)),b);
+}
+
+__attribute__((target("avx2")))
+void ContiguousAvx2(const unsigned char* q, const unsigned char* pRows, size_t step, int N, int* pDists)
+{
+    const __m256i vq = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(q));
+    for(int i=0; i<N; i++)
+        pDists[i] = XorCountAvx2(vq,pRows+i*step);
+}
+
+__attribute__((target("avx2")))
+void IndexedAvx2(const unsigned char* q, const unsigned char* pRows, size_t step, const size_t* pIdx, int N, int* pDists)
+{
+    const __m256i vq = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(q));
+    for(int i=0; i<N; i++)
+        pDists[i] = XorCountAvx2(vq,pRows+pIdx[i]*step);
+}
+
+__attribute__((target("avx2")))
+void Indexed32Avx2(const unsigned char* q, const unsigned char* pRows, size_t step, const unsigned int* pIdx, int N, int* pDists)
+{
+    const __m256i vq = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(q));
+    for(int i=0; i<N; i++)
+        pDists[i] = XorCountAvx2(vq,pRows+pIdx[i]*step);
+}
+
+#ifdef HAMMING_AVX512
+
+// AVX-512 VPOPCNTDQ: two descriptors per 512-bit register
+
+#define HAMMING_AVX512_TARGET __attribute__((target("avx512f,avx512vl,avx512vpopcntdq")))
+
+HAMMING_AVX512_TARGET
+inline int HorizontalSum256(const __m256i v)
+{
+    const __m128i s = _mm_add_epi64(_mm256_castsi256_si128(v),_mm256_extracti128_si256(v,1));
+    return _mm_cvtsi128_si32(_mm_add_epi64(s,_mm_unpackhi_epi64(s,s)));
+}
+
+HAMMING_AVX512_TARGET
+int PairAvx512(const unsigned char* a, const unsigned char* b)
+{
+    const __m256i v = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a)),
+                                       _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b)));
+    return HorizontalSum256(_mm256_popcnt_epi64(v));
+}
+
+// The masked forms avoid the undefined upper lanes of the plain cast/insert intrinsics
+HAMMING_AVX512_TARGET
+inline __m512i LoadTwo(const unsigned char* b0, const unsigned char* b1)
+{
+    const __m512i lo = _mm512_maskz_inserti64x4(0xFF,_mm512_setzero_si512(),_mm256_loadu_si256(reinterpret_cast<const __m256i*>(b0)),0);
+    return _mm512_maskz_inserti64x4(0xFF,lo,_mm256_loadu_si256(reinterpret_cast<const __m256i*>(b1)),1);
+}
+
+HAMMING_AVX512_TARGET
+inline void XorCountTwoAvx512(const __m512i q2, const unsigned char* b0, const unsigned char* b1, int* pDists)
+{
+    const __m512i cnt = _mm512_popcnt_epi64(_mm512_xor_si512(q2,LoadTwo(b0,b1)));
+    pDists[0] = HorizontalSum256(_mm512_maskz_extracti64x4_epi64(0xF,cnt,0));
+    pDists[1] = HorizontalSum256(_mm512_maskz_extracti64x4_epi64(0xF,cnt,1));
+}
+
+HAMMING_AVX512_TARGET
+void ContiguousAvx512(const unsigned char* q, const unsigned char* pRows, size_t step, int N, int* pDists)
+{
+    const __m512i q2 = LoadTwo(q,q);
+    int i=0;
+    for(; i+1<N; i+=2)
+        XorCountTwoAvx512(q2,pRows+i*step,pRows+(i+1)*step,pDists+i);
+    if(i<N)
+        pDists[i] = PairAvx512(q,pRows+i*step);
+}
+
+HAMMING_AVX512_TARGET
+void IndexedAvx512(const unsigned char* q, const unsigned char* pRows, size_t step, const size_t* pIdx, int N, int* pDists)
+{
+    const __m512i q2 = LoadTwo(q,q);
+    int i=0;
+    for(; i+1<N; i+=2)
+        XorCountTwoAvx512(q2,pRows+pIdx[i]*step,pRows+pIdx[i+1]*step,pDists+i);
+    if(i<N)
+        pDists[i] = PairAvx512(q,pRows+pIdx[i]*step);
+}
+
+HAMMING_AVX512_TARGET
+void Indexed32Avx512(const unsigned char* q, const unsigned char* pRows, size_t step, const unsigned int* pIdx, int N, int* pDists)
+{
+    const __m512i q2 = LoadTwo(q,q);
+    int i=0;
+    for(; i+1<N; i+=2)
+        XorCountTwoAvx512(q2,pRows+pIdx[i]*step,pRows+pIdx[i+1]*step,pDists+i);
+    if(i<N)
+        pDists[i] = PairAvx512(q,pRows+pIdx[i]*step);
+}
+
+#endif // HAMMING_AVX512
+
+#endif // HAMMING_X86_DISPATCH
+
+} // namespace
+
+// Constant-initialized to the scalar kernel, so the class is usable even
+// before the dynamic initializer below has selected the best kernel.
+HammingDistance::PairFunc HammingDistance::mpfPair = PairScalar;
+HammingDistance::ContiguousFunc HammingDistance::mpfContiguous = ContiguousScalar;
+HammingDistance::IndexedFunc HammingDistance::mpfIndexed = IndexedScalar;
+HammingDistance::Indexed32Func HammingDistance::mpfIndexed32 = Indexed32Scalar;
+const char* HammingDistance::mpBackendName = "scalar";
+
+class HammingDistanceSelector : public HammingDistance
+{
+public:
+    HammingDistanceSelector()
+    {
+#ifdef HAMMING_X86_DISPATCH
+        __builtin_cpu_init();
+#ifdef HAMMING_AVX512
+        if(__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vl") &&
+           __builtin_cpu_supports("avx512vpopcntdq"))
+        {
+            mpfPair = PairAvx512;
+            mpfContiguous = ContiguousAvx512;
+            mpfIndexed = IndexedAvx512;
+            mpfIndexed32 = Indexed32Avx512;
+            mpBackendName = "avx512-vpopcntdq";
+            return;
+        }
+#endif
+        if(__builtin_cpu_supports("avx2"))
+        {
+            mpfPair = PairAvx2;
+            mpfContiguous = ContiguousAvx2;
+            mpfIndexed = IndexedAvx2;
+            mpfIndexed32 = Indexed32Avx2;
+            mpBackendName = "avx2";
+            return;
+        }
+        if(__builtin_cpu_supports("popcnt"))
+        {
+            mpfPair = PairPopcnt;
+            mpfContiguous = ContiguousPopcnt;
+            mpfIndexed = IndexedPopcnt;
+            mpfIndexed32 = Indexed32Popcnt;
+            mpBackendName = "popcnt";
+            return;
+        }
+#endif
+    }
+};
+
+static HammingDistanceSelector sHammingDistanceSelector;
+
+const char* HammingDistance::GetBackendName()
+{
+    return mpBackendName;
+}
+
+void HammingDistance::UseScalar()
+{
+    mpfPair = PairScalar;
+    mpfContiguous = ContiguousScalar;
+    mpfIndexed = IndexedScalar;
+    mpfIndexed32 = Indexed32Scalar;
+    mpBackendName = "scalar";
+}
+
+} //namespace ORB_SLAM
@@ -21,6 +21,7 @@
 #include "KeyFrame.h"
 #include "Converter.h"
 #include "ORBmatcher.h"
+#include "DescriptorStore.h"
 #include<mutex>
 
 namespace ORB_SLAM2
@@ -31,11 +32,11 @@ long unsigned int KeyFrame::nNextId=0;
 KeyFrame::KeyFrame(Frame &F, Map *pMap, KeyFrameDatabase *pKFDB):
     mnFrameId(F.mnId),  mTimeStamp(F.mTimeStamp), mnGridCols(FRAME_GRID_COLS), mnGridRows(FRAME_GRID_ROWS),
     mfGridElementWidthInv(F.mfGridElementWidthInv), mfGridElementHeightInv(F.mfGridElementHeightInv),
-    mnTrackReferenceForFrame(0), mnFuseTargetForKF(0), mnBALocalForKF(0), mnBAFixedForKF(0),
+    mnTrackReferenceForFrame(0), mnFuseTargetForKF(0), mnTrackVoteForFrame(0), mnTrackVotes(0), mnBALocalForKF(0), mnBAFixedForKF(0), mnBAVertexIdx(-1),
     mnLoopQuery(0), mnLoopWords(0), mnRelocQuery(0), mnRelocWords(0), mnBAGlobalForKF(0),
     fx(F.fx), fy(F.fy), cx(F.cx), cy(F.cy), invfx(F.invfx), invfy(F.invfy),
     mbf(F.mbf), mb(F.mb), mThDepth(F.mThDepth), N(F.N), mvKeys(F.mvKeys), mvKeysUn(F.mvKeysUn),
-    mvuRight(F.mvuRight), mvDepth(F.mvDepth), mDescriptors(F.mDescriptors.clone()),
+    mvuRight(F.mvuRight), mvDepth(F.mvDepth), mDescriptors(DescriptorStore::Share(F.mDescriptors)),
     mBowVec(F.mBowVec), mFeatVec(F.mFeatVec), mnScaleLevels(F.mnScaleLevels), mfScaleFactor(F.mfScaleFactor),
     mfLogScaleFactor(F.mfLogScaleFactor), mvScaleFactors(F.mvScaleFactors), mvLevelSigma2(F.mvLevelSigma2),
     mvInvLevelSigma2(F.mvInvLevelSigma2), mnMinX(F.mnMinX), mnMinY(F.mnMinY), mnMaxX(F.mnMaxX),
@@ -45,13 +46,8 @@ KeyFrame::KeyFrame(Frame &F, Map *pMap, KeyFrameDatabase *pKFDB):
 {
     mnId=nNextId++;
 
-    mGrid.resize(mnGridCols);
-    for(int i=0; i<mnGridCols;i++)
-    {
-        mGrid[i].resize(mnGridRows);
-        for(int j=0; j<mnGridRows; j++)
-            mGrid[i][j] = F.mGrid[i][j];
-    }
+    mvGridStart = F.mvGridStart;
+    mvGridIndices = F.mvGridIndices;
 
     SetPose(F.mTcw);    
 }
@@ -133,6 +129,7 @@ void KeyFrame::AddConnection(KeyFrame *pKF, const int &weight)
     }
 
     UpdateBestCovisibles();
+    mpMap->InformGraphChange();
 }
 
 void KeyFrame::UpdateBestCovisibles()
@@ -209,27 +206,37 @@ int KeyFrame::GetWeight(KeyFrame *pKF)
 
 void KeyFrame::AddMapPoint(MapPoint *pMP, const size_t &idx)
 {
-    unique_lock<mutex> lock(mMutexFeatures);
-    mvpMapPoints[idx]=pMP;
+    {
+        unique_lock<mutex> lock(mMutexFeatures);
+        mvpMapPoints[idx]=pMP;
+    }
+    mpMap->InformGraphChange();
 }
 
 void KeyFrame::EraseMapPointMatch(const size_t &idx)
 {
-    unique_lock<mutex> lock(mMutexFeatures);
-    mvpMapPoints[idx]=static_cast<MapPoint*>(NULL);
+    {
+        unique_lock<mutex> lock(mMutexFeatures);
+        mvpMapPoints[idx]=static_cast<MapPoint*>(NULL);
+    }
+    mpMap->InformGraphChange();
 }
 
 void KeyFrame::EraseMapPointMatch(MapPoint* pMP)
 {
     int idx = pMP->GetIndexInKeyFrame(this);
     if(idx>=0)
+    {
         mvpMapPoints[idx]=static_cast<MapPoint*>(NULL);
+        mpMap->InformGraphChange();
+    }
 }
 
 
 void KeyFrame::ReplaceMapPointMatch(const size_t &idx, MapPoint* pMP)
 {
     mvpMapPoints[idx]=pMP;
+    mpMap->InformGraphChange();
 }
 
 set<MapPoint*> KeyFrame::GetMapPoints()
@@ -376,18 +383,26 @@ void KeyFrame::UpdateConnections()
         }
 
     }
+
+    mpMap->InformGraphChange();
 }
 
 void KeyFrame::AddChild(KeyFrame *pKF)
 {
-    unique_lock<mutex> lockCon(mMutexConnections);
-    mspChildrens.insert(pKF);
+    {
+        unique_lock<mutex> lockCon(mMutexConnections);
+        mspChildrens.insert(pKF);
+    }
+    mpMap->InformGraphChange();
 }
 
 void KeyFrame::EraseChild(KeyFrame *pKF)
 {
-    unique_lock<mutex> lockCon(mMutexConnections);
-    mspChildrens.erase(pKF);
+    {
+        unique_lock<mutex> lockCon(mMutexConnections);
+        mspChildrens.erase(pKF);
+    }
+    mpMap->InformGraphChange();
 }
 
 void KeyFrame::ChangeParent(KeyFrame *pKF)
@@ -563,7 +578,10 @@ void KeyFrame::EraseConnection(KeyFrame* pKF)
     }
 
     if(bUpdate)
+    {
         UpdateBestCovisibles();
+        mpMap->InformGraphChange();
+    }
 }
 
 vector<size_t> KeyFrame::GetFeaturesInArea(const float &x, const float &y, const float &r) const
@@ -571,6 +589,9 @@ vector<size_t> KeyFrame::GetFeaturesInArea(const float &x, const float &y, const
     vector<size_t> vIndices;
     vIndices.reserve(N);
 
+    if(mvGridStart.empty())
+        return vIndices;
+
     const int nMinCellX = max(0,(int)floor((x-mnMinX-r)*mfGridElementWidthInv));
     if(nMinCellX>=mnGridCols)
         return vIndices;
@@ -589,18 +610,18 @@ vector<size_t> KeyFrame::GetFeaturesInArea(const float &x, const float &y, const
 
     for(int ix = nMinCellX; ix<=nMaxCellX; ix++)
     {
-        for(int iy = nMinCellY; iy<=nMaxCellY; iy++)
+        const unsigned int jbegin = mvGridStart[ix*mnGridRows+nMinCellY];
+        const unsigned int jend = mvGridStart[ix*mnGridRows+nMaxCellY+1];
+
+        for(unsigned int j=jbegin; j<jend; j++)
         {
-            const vector<size_t> vCell = mGrid[ix][iy];
-            for(size_t j=0, jend=vCell.size(); j<jend; j++)
-            {
-                const cv::KeyPoint &kpUn = mvKeysUn[vCell[j]];
-                const float distx = kpUn.pt.x-x;
-                const float disty = kpUn.pt.y-y;
+            const unsigned int idx = mvGridIndices[j];
+            const cv::KeyPoint &kpUn = mvKeysUn[idx];
+            const float distx = kpUn.pt.x-x;
+            const float disty = kpUn.pt.y-y;
 
-                if(fabs(distx)<r && fabs(disty)<r)
-                    vIndices.push_back(vCell[j]);
-            }
+            if(fabs(distx)<r && fabs(disty)<r)
+                vIndices.push_back(idx);
         }
     }
 
@@ -666,7 +687,7 @@ float KeyFrame::ComputeSceneMedianDepth(const int q)
 KeyFrame::KeyFrame():
     mnFrameId(0),  mTimeStamp(0.0), mnGridCols(FRAME_GRID_COLS), mnGridRows(FRAME_GRID_ROWS),
     mfGridElementWidthInv(0.0), mfGridElementHeightInv(0.0),
-    mnTrackReferenceForFrame(0), mnFuseTargetForKF(0), mnBALocalForKF(0), mnBAFixedForKF(0),
+    mnTrackReferenceForFrame(0), mnFuseTargetForKF(0), mnTrackVoteForFrame(0), mnTrackVotes(0), mnBALocalForKF(0), mnBAFixedForKF(0), mnBAVertexIdx(-1),
     mnLoopQuery(0), mnLoopWords(0), mnRelocQuery(0), mnRelocWords(0), mnBAGlobalForKF(0),
     fx(0.0), fy(0.0), cx(0.0), cy(0.0), invfx(0.0), invfy(0.0),
     mbf(0.0), mb(0.0), mThDepth(0.0), N(0), mnScaleLevels(0), mfScaleFactor(0),
@@ -707,6 +728,8 @@ void KeyFrame::serialize(Archive &ar, const unsigned int version)
     ar & const_cast<std::vector<float> &>(mvuRight);
     ar & const_cast<std::vector<float> &>(mvDepth);
     ar & const_cast<cv::Mat &>(mDescriptors);
+    if(Archive::is_loading::value)
+        const_cast<cv::Mat &>(mDescriptors) = DescriptorStore::Clone(mDescriptors);
     // Bow
     ar & mBowVec & mFeatVec;
     // Pose relative to parent
@@ -733,7 +756,32 @@ void KeyFrame::serialize(Archive &ar, const unsigned int version)
     {
         // Grid related
         unique_lock<mutex> lock_connection(mMutexConnections);
-        ar & mGrid & mConnectedKeyFrameWeights & mvpOrderedConnectedKeyFrames & mvOrderedWeights;
+        // Saved per cell, as in maps written before the flat grid
+        std::vector< std::vector <std::vector<size_t> > > vGrid;
+        if(!Archive::is_loading::value && !mvGridStart.empty())
+        {
+            vGrid.assign(mnGridCols,std::vector<std::vector<size_t> >(mnGridRows));
+            for(int i=0; i<mnGridCols; i++)
+                for(int j=0; j<mnGridRows; j++)
+                {
+                    const int k = i*mnGridRows+j;
+                    vGrid[i][j].assign(mvGridIndices.begin()+mvGridStart[k],mvGridIndices.begin()+mvGridStart[k+1]);
+                }
+        }
+        ar & vGrid & mConnectedKeyFrameWeights & mvpOrderedConnectedKeyFrames & mvOrderedWeights;
+        if(Archive::is_loading::value)
+        {
+            mvGridStart.assign(1,0);
+            mvGridIndices.clear();
+            for(size_t i=0; i<vGrid.size(); i++)
+                for(size_t j=0; j<vGrid[i].size(); j++)
+                {
+                    mvGridIndices.insert(mvGridIndices.end(),vGrid[i][j].begin(),vGrid[i][j].end());
+                    mvGridStart.push_back(mvGridIndices.size());
+                }
+            if(vGrid.empty())
+                mvGridStart.clear();
+        }
         // Spanning Tree and Loop Edges
         ar & mbFirstConnection & mpParent & mspChildrens & mspLoopEdges;
         // Bad flags
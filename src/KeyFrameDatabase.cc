@@ -196,7 +196,7 @@ vector<KeyFrame*> KeyFrameDatabase::DetectLoopCandidates(KeyFrame* pKF, float mi
     return vpLoopCandidates;
 }
 
-vector<KeyFrame*> KeyFrameDatabase::DetectRelocalizationCandidates(Frame *F)
+vector<KeyFrame*> KeyFrameDatabase::DetectRelocalizationCandidates(Frame *F, bool bSortByScore)
 {
     list<KeyFrame*> lKFsSharingWords;
 
@@ -288,6 +288,11 @@ vector<KeyFrame*> KeyFrameDatabase::DetectRelocalizationCandidates(Frame *F)
 
     // Return all those keyframes with a score higher than 0.75*bestScore
     float minScoreToRetain = 0.75f*bestAccScore;
+
+    // A keyframe is ranked by the best group it is retained for
+    if(bSortByScore)
+        lAccScoreAndMatch.sort([](const pair<float,KeyFrame*> &a, const pair<float,KeyFrame*> &b){ return a.first>b.first; });
+
     set<KeyFrame*> spAlreadyAddedKF;
     vector<KeyFrame*> vpRelocCandidates;
     vpRelocCandidates.reserve(lAccScoreAndMatch.size());
@@ -0,0 +1,528 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "LocalBundleAdjuster.h"
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <Eigen/Cholesky>
+#include <Eigen/LU>
+
+using namespace std;
+
+namespace ORB_SLAM2
+{
+
+LocalBundleAdjuster::LocalBundleAdjuster():
+    mpThreadPool(NULL), mbWarmStart(false), mLastLambda(0), mnPoseCols(0)
+{
+}
+
+void LocalBundleAdjuster::SetThreadPool(ThreadPool* pThreadPool)
+{
+    mpThreadPool = pThreadPool;
+}
+
+void LocalBundleAdjuster::SetWarmStart(const bool bWarmStart)
+{
+    mbWarmStart = bWarmStart;
+}
+
+void LocalBundleAdjuster::Clear()
+{
+    mvPoses.clear();
+    mvbFixed.clear();
+    mvfx.clear(); mvfy.clear(); mvcx.clear(); mvcy.clear(); mvbf.clear();
+    mvPoints.clear();
+    mvPointEdges.assign(1,0);
+    mvEdges.clear();
+}
+
+int LocalBundleAdjuster::AddKeyFrame(const g2o::SE3Quat &Tcw, const bool bFixed, const float fx, const float fy,
+                                     const float cx, const float cy, const float bf)
+{
+    mvPoses.push_back(Tcw);
+    mvbFixed.push_back(bFixed);
+    mvfx.push_back(fx); mvfy.push_back(fy); mvcx.push_back(cx); mvcy.push_back(cy); mvbf.push_back(bf);
+    return mvPoses.size()-1;
+}
+
+int LocalBundleAdjuster::AddPoint(const Eigen::Vector3d &Xw)
+{
+    if(mvPointEdges.empty())
+        mvPointEdges.push_back(0);
+    mvPoints.push_back(Xw);
+    mvPointEdges.push_back(mvEdges.size());
+    return mvPoints.size()-1;
+}
+
+int LocalBundleAdjuster::AddEdge(const int nKeyFrame, const float u, const float v, const float ur,
+                                 const float invSigma2, const float delta)
+{
+    Edge e;
+    e.nKeyFrame = nKeyFrame;
+    e.nPoint = mvPoints.size()-1;
+    e.u = u; e.v = v; e.ur = ur;
+    e.invSigma2 = invSigma2;
+    e.delta = delta;
+    e.bActive = true;
+    e.bRobust = true;
+    e.chi2 = 0;
+    mvEdges.push_back(e);
+    mvPointEdges.back() = mvEdges.size();
+    return mvEdges.size()-1;
+}
+
+bool LocalBundleAdjuster::IsDepthPositive(const int nEdge) const
+{
+    const Edge &e = mvEdges[nEdge];
+    return mvPoses[e.nKeyFrame].map(mvPoints[e.nPoint])[2]>0.0;
+}
+
+void LocalBundleAdjuster::ForEachChunk(const function<void(int)> &f)
+{
+    const int nChunks = mvChunkBegin.size()-1;
+    if(mpThreadPool)
+        mpThreadPool->ParallelFor(nChunks,f);
+    else
+        for(int i=0; i<nChunks; i++)
+            f(i);
+}
+
+void LocalBundleAdjuster::SetupActive()
+{
+    const int nPoses = mvPoses.size();
+    const int nPoints = mvPoints.size();
+    const int nEdges = mvEdges.size();
+
+    // Vertices with an active edge are optimized, as in SparseOptimizer::initializeOptimization
+    vector<unsigned char> vbPoseActive(nPoses,0);
+    mvbPointActive.assign(nPoints,0);
+    for(int i=0; i<nEdges; i++)
+    {
+        if(mvEdges[i].bActive)
+        {
+            vbPoseActive[mvEdges[i].nKeyFrame] = 1;
+            mvbPointActive[mvEdges[i].nPoint] = 1;
+        }
+    }
+
+    mvPoseCol.assign(nPoses,-1);
+    mnPoseCols = 0;
+    for(int i=0; i<nPoses; i++)
+        if(vbPoseActive[i] && !mvbFixed[i])
+            mvPoseCol[i] = mnPoseCols++;
+
+    mvHll.resize(nPoints);
+    mvHllInv.resize(nPoints);
+    mvbl.resize(nPoints);
+    mvHpl.resize(nEdges);
+    mvHppEdge.resize(nEdges);
+    mvbpEdge.resize(nEdges);
+    mvHpp.resize(mnPoseCols);
+    mbp.resize(6*mnPoseCols);
+    mvR.resize(nPoses);
+    mvt.resize(nPoses);
+
+    // Chunks of consecutive points with about the same number of edges
+    const int nChunks = mpThreadPool ? mpThreadPool->GetNumThreads() : 1;
+    mvChunkBegin.assign(1,0);
+    for(int c=1; c<nChunks; c++)
+    {
+        const int nEdgeTarget = (long)nEdges*c/nChunks;
+        const int nPoint = upper_bound(mvPointEdges.begin(),mvPointEdges.end()-1,nEdgeTarget)-mvPointEdges.begin();
+        mvChunkBegin.push_back(max(mvChunkBegin.back(),min(nPoint,nPoints)));
+    }
+    mvChunkBegin.push_back(nPoints);
+
+    mvChunks.resize(nChunks);
+    for(int c=0; c<nChunks; c++)
+    {
+        mvChunks[c].S.resize(6*mnPoseCols,6*mnPoseCols);
+        mvChunks[c].r.resize(6*mnPoseCols);
+    }
+}
+
+void LocalBundleAdjuster::Optimize(const int nIterations, bool* pbStopFlag)
+{
+    SetupActive();
+
+    int nActive = 0;
+    for(size_t i=0; i<mvEdges.size(); i++)
+        if(mvEdges[i].bActive)
+            nActive++;
+    if(nActive==0)
+        return;
+
+    // Levenberg-Marquardt as g2o::OptimizationAlgorithmLevenberg (tau 1e-5, 10 trials per iteration)
+    double lambda = 0;
+    int ni = 2;
+    int nBad = 0;
+
+    for(int it=0; it<nIterations; it++)
+    {
+        if(pbStopFlag && *pbStopFlag)
+            break;
+
+        double currentChi = Evaluate(false,true);
+        const double iniChi = currentChi;
+
+        if(it==0)
+        {
+            if(mbWarmStart && mLastLambda>0)
+                lambda = mLastLambda;
+            else
+            {
+                double maxDiagonal = 0;
+                for(int i=0; i<mnPoseCols; i++)
+                    maxDiagonal = max(maxDiagonal,mvHpp[i].diagonal().cwiseAbs().maxCoeff());
+                for(size_t i=0; i<mvPoints.size(); i++)
+                    if(mvbPointActive[i])
+                        maxDiagonal = max(maxDiagonal,mvHll[i].diagonal().cwiseAbs().maxCoeff());
+                lambda = 1e-5*maxDiagonal;
+            }
+            ni = 2;
+            nBad = 0;
+        }
+
+        double rho = 0;
+        int q = 0;
+        do
+        {
+            double scale = 0;
+            const bool bSolved = SolveAndUpdate(lambda,scale);
+
+            double tempChi = Evaluate(true,false);
+            if(!bSolved)
+                tempChi = numeric_limits<double>::max();
+
+            rho = (currentChi-tempChi)/(scale+1e-3);
+
+            if(rho>0 && std::isfinite(tempChi))
+            {
+                const double alpha = min(1.0-pow(2*rho-1,3),2.0/3.0);
+                lambda *= max(1.0/3.0,alpha);
+                ni = 2;
+                currentChi = tempChi;
+                mvPoses.swap(mvTrialPoses);
+                mvPoints.swap(mvTrialPoints);
+            }
+            else
+            {
+                lambda *= ni;
+                ni *= 2;
+            }
+            q++;
+        }
+        while(rho<0 && q<10 && !(pbStopFlag && *pbStopFlag));
+
+        if(q==10 || rho==0)
+            break;
+
+        if((iniChi-currentChi)*1e3<iniChi)
+            nBad++;
+        else
+            nBad=0;
+
+        if(nBad>=3)
+            break;
+    }
+
+    mLastLambda = lambda;
+}
+
+double LocalBundleAdjuster::Evaluate(const bool bTrial, const bool bLinearize)
+{
+    const vector<g2o::SE3Quat,Eigen::aligned_allocator<g2o::SE3Quat> > &vPoses = bTrial ? mvTrialPoses : mvPoses;
+    for(size_t i=0; i<vPoses.size(); i++)
+    {
+        mvR[i] = vPoses[i].rotation().toRotationMatrix();
+        mvt[i] = vPoses[i].translation();
+    }
+
+    ForEachChunk([&](int c)
+    {
+        EvaluateChunk(c,bTrial,bLinearize);
+    });
+
+    double chi = 0;
+    for(size_t c=0; c<mvChunks.size(); c++)
+        chi += mvChunks[c].chi;
+
+    if(bLinearize)
+    {
+        // Pose blocks of the edges, summed by pose
+        for(int i=0; i<mnPoseCols; i++)
+            mvHpp[i].setZero();
+        mbp.setZero();
+
+        for(size_t i=0; i<mvEdges.size(); i++)
+        {
+            const Edge &e = mvEdges[i];
+            const int col = mvPoseCol[e.nKeyFrame];
+            if(!e.bActive || col<0)
+                continue;
+            mvHpp[col] += mvHppEdge[i];
+            mbp.segment<6>(6*col) += mvbpEdge[i];
+        }
+    }
+
+    return chi;
+}
+
+void LocalBundleAdjuster::EvaluateChunk(const int nChunk, const bool bTrial, const bool bLinearize)
+{
+    const vector<Eigen::Vector3d> &vPoints = bTrial ? mvTrialPoints : mvPoints;
+    double chi = 0;
+
+    for(int p=mvChunkBegin[nChunk]; p<mvChunkBegin[nChunk+1]; p++)
+    {
+        if(!mvbPointActive[p])
+            continue;
+
+        const Eigen::Vector3d &Xw = vPoints[p];
+        Eigen::Matrix3d &Hll = mvHll[p];
+        Eigen::Vector3d &bl = mvbl[p];
+        if(bLinearize)
+        {
+            Hll.setZero();
+            bl.setZero();
+        }
+
+        for(int i=mvPointEdges[p]; i<mvPointEdges[p+1]; i++)
+        {
+            Edge &e = mvEdges[i];
+            if(!e.bActive)
+                continue;
+
+            const int k = e.nKeyFrame;
+            const Eigen::Matrix3d &R = mvR[k];
+            const Eigen::Vector3d Xc = R*Xw + mvt[k];
+            const double x = Xc[0], y = Xc[1], z = Xc[2];
+            const double fx = mvfx[k], fy = mvfy[k], cx = mvcx[k], cy = mvcy[k], bf = mvbf[k];
+            const bool bStereo = e.ur>=0;
+
+            double eu, ev, er=0;
+            if(bStereo)
+            {
+                // The stereo edge projects with a float inverse depth
+                const float invz = 1.0f/z;
+                const double us = x*invz*fx + cx;
+                eu = e.u - us;
+                ev = e.v - (y*invz*fy + cy);
+                er = e.ur - (us - bf*invz);
+            }
+            else
+            {
+                eu = e.u - (x/z*fx + cx);
+                ev = e.v - (y/z*fy + cy);
+            }
+
+            const double chi2 = e.invSigma2*(eu*eu + ev*ev + er*er);
+            e.chi2 = chi2;
+
+            double rho1 = 1;
+            if(e.bRobust)
+            {
+                const double dsqr = e.delta*e.delta;
+                if(chi2<=dsqr)
+                    chi += chi2;
+                else
+                {
+                    const double sqrte = sqrt(chi2);
+                    chi += 2*sqrte*e.delta - dsqr;
+                    rho1 = e.delta/sqrte;
+                }
+            }
+            else
+                chi += chi2;
+
+            if(!bLinearize)
+                continue;
+
+            // Jacobians of the error with respect to the point and to the pose
+            const double z_2 = z*z;
+            Eigen::Matrix<double,3,3> Jl;
+            Eigen::Matrix<double,3,6> Jp;
+            Jl.row(0) = -fx*R.row(0)/z + fx*x*R.row(2)/z_2;
+            Jl.row(1) = -fy*R.row(1)/z + fy*y*R.row(2)/z_2;
+            Jp.row(0) << x*y/z_2*fx, -(1+(x*x/z_2))*fx, y/z*fx, -1./z*fx, 0, x/z_2*fx;
+            Jp.row(1) << (1+y*y/z_2)*fy, -x*y/z_2*fy, -x/z*fy, 0, -1./z*fy, y/z_2*fy;
+            if(bStereo)
+            {
+                Jl.row(2) = Jl.row(0) - bf*R.row(2)/z_2;
+                Jp.row(2) << Jp(0,0)-bf*y/z_2, Jp(0,1)+bf*x/z_2, Jp(0,2), Jp(0,3), 0, Jp(0,5)-bf/z_2;
+            }
+            else
+            {
+                Jl.row(2).setZero();
+                Jp.row(2).setZero();
+            }
+
+            const double w = rho1*e.invSigma2;
+            const Eigen::Vector3d err(eu,ev,er);
+
+            Hll.noalias() += w*Jl.transpose()*Jl;
+            bl.noalias() -= w*Jl.transpose()*err;
+
+            if(mvPoseCol[k]>=0)
+            {
+                mvHpl[i].noalias() = w*Jp.transpose()*Jl;
+                mvHppEdge[i].noalias() = w*Jp.transpose()*Jp;
+                mvbpEdge[i].noalias() = -w*Jp.transpose()*err;
+            }
+        }
+    }
+
+    mvChunks[nChunk].chi = chi;
+}
+
+bool LocalBundleAdjuster::SolveAndUpdate(const double lambda, double &scale)
+{
+    // Reduced system S*dx = r over the poses
+    ForEachChunk([&](int c)
+    {
+        EliminateChunk(c,lambda);
+    });
+
+    const int n = 6*mnPoseCols;
+    bool bSolved = true;
+    mdx.setZero(n);
+
+    if(n>0)
+    {
+        mS = mvChunks[0].S;
+        mr = mvChunks[0].r;
+        for(size_t c=1; c<mvChunks.size(); c++)
+        {
+            mS.triangularView<Eigen::Upper>() += mvChunks[c].S;
+            mr += mvChunks[c].r;
+        }
+        for(int i=0; i<mnPoseCols; i++)
+        {
+            mS.block<6,6>(6*i,6*i) += mvHpp[i];
+            mS.block<6,6>(6*i,6*i).diagonal().array() += lambda;
+        }
+        mr = mbp - mr;
+
+        Eigen::LDLT<Eigen::MatrixXd,Eigen::Upper> ldlt(mS);
+        if(ldlt.info()==Eigen::Success)
+        {
+            mdx = ldlt.solve(mr);
+            bSolved = mdx.allFinite();
+        }
+        else
+            bSolved = false;
+
+        if(!bSolved)
+            mdx.setZero();
+    }
+
+    // Trial estimate
+    mvTrialPoses = mvPoses;
+    mvTrialPoints = mvPoints;
+
+    scale = 0;
+    for(size_t k=0; k<mvPoses.size(); k++)
+    {
+        const int col = mvPoseCol[k];
+        if(col<0)
+            continue;
+        const Vector6d dx = mdx.segment<6>(6*col);
+        scale += dx.dot(lambda*dx + mbp.segment<6>(6*col));
+        mvTrialPoses[k] = g2o::SE3Quat::exp(dx)*mvPoses[k];
+    }
+
+    ForEachChunk([&](int c)
+    {
+        BackSubstituteChunk(c,lambda,bSolved);
+    });
+
+    for(size_t c=0; c<mvChunks.size(); c++)
+        scale += mvChunks[c].scale;
+
+    return bSolved;
+}
+
+void LocalBundleAdjuster::EliminateChunk(const int nChunk, const double lambda)
+{
+    ChunkSums &sums = mvChunks[nChunk];
+    sums.S.setZero();
+    sums.r.setZero();
+
+    for(int p=mvChunkBegin[nChunk]; p<mvChunkBegin[nChunk+1]; p++)
+    {
+        if(!mvbPointActive[p])
+            continue;
+
+        Eigen::Matrix3d D = mvHll[p];
+        D.diagonal().array() += lambda;
+        const Eigen::Matrix3d Dinv = D.inverse();
+        mvHllInv[p] = Dinv;
+        const Eigen::Vector3d db = Dinv*mvbl[p];
+
+        const int i0 = mvPointEdges[p], i1 = mvPointEdges[p+1];
+        for(int i=i0; i<i1; i++)
+        {
+            const int col1 = mvEdges[i].bActive ? mvPoseCol[mvEdges[i].nKeyFrame] : -1;
+            if(col1<0)
+                continue;
+
+            sums.r.segment<6>(6*col1).noalias() += mvHpl[i]*db;
+
+            const Matrix6x3d BDinv = mvHpl[i]*Dinv;
+            for(int j=i0; j<i1; j++)
+            {
+                const int col2 = mvEdges[j].bActive ? mvPoseCol[mvEdges[j].nKeyFrame] : -1;
+                if(col2<col1)
+                    continue;
+                sums.S.block<6,6>(6*col1,6*col2).noalias() -= BDinv*mvHpl[j].transpose();
+            }
+        }
+    }
+}
+
+void LocalBundleAdjuster::BackSubstituteChunk(const int nChunk, const double lambda, const bool bSolved)
+{
+    double scale = 0;
+
+    for(int p=mvChunkBegin[nChunk]; p<mvChunkBegin[nChunk+1]; p++)
+    {
+        if(!mvbPointActive[p])
+            continue;
+
+        Eigen::Vector3d c = mvbl[p];
+        for(int i=mvPointEdges[p]; i<mvPointEdges[p+1]; i++)
+        {
+            const int col = mvEdges[i].bActive ? mvPoseCol[mvEdges[i].nKeyFrame] : -1;
+            if(col>=0)
+                c.noalias() -= mvHpl[i].transpose()*mdx.segment<6>(6*col);
+        }
+
+        const Eigen::Vector3d dl = bSolved ? Eigen::Vector3d(mvHllInv[p]*c) : Eigen::Vector3d::Zero();
+        scale += dl.dot(lambda*dl + mvbl[p]);
+        mvTrialPoints[p] = mvPoints[p] + dl;
+    }
+
+    mvChunks[nChunk].scale = scale;
+}
+
+} //namespace ORB_SLAM
@@ -0,0 +1,237 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "LocalMapProjector.h"
+
+#include <algorithm>
+#include <cmath>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+namespace ORB_SLAM2
+{
+
+void LocalMapProjector::Project(Frame &F, const vector<MapPoint*> &vpMapPoints, const float viewingCosLimit,
+                                vector<MapPoint*> &vpInView, ThreadPool* pThreadPool)
+{
+    vpInView.clear();
+    mvpInViewDescriptors.clear();
+    mvInViewCells.clear();
+
+    const int n = vpMapPoints.size();
+    if(n==0)
+        return;
+
+    mvbCandidate.resize(n);
+    mvX.resize(n); mvY.resize(n); mvZ.resize(n);
+    mvNx.resize(n); mvNy.resize(n); mvNz.resize(n);
+    mvMinDist.resize(n); mvMaxDist.resize(n);
+    mvU.resize(n); mvV.resize(n); mvInvZ.resize(n); mvDist.resize(n); mvViewCos.resize(n);
+    mvbInView.resize(n);
+    mvCell.resize(n);
+    if(mDescriptors.rows<n)
+        mDescriptors = DescriptorStore::Allocate(n);
+
+    float Tcw[12];
+    for(int r=0; r<3; r++)
+        for(int c=0; c<4; c++)
+            Tcw[4*r+c] = F.mTcw.at<float>(r,c);
+    const cv::Mat O = F.GetCameraCenter();
+    const float Ow[3] = {O.at<float>(0), O.at<float>(1), O.at<float>(2)};
+
+    // Blocks only touch their own slots and points
+    const int nBlocks = (n+BLOCK_SIZE-1)/BLOCK_SIZE;
+    auto processBlock = [&](int b)
+    {
+        const int i0 = b*BLOCK_SIZE;
+        const int i1 = min(i0+BLOCK_SIZE,n);
+        Snapshot(F,vpMapPoints,i0,i1);
+        Cull(Tcw,Ow,viewingCosLimit,i0,i1);
+        Predict(F,vpMapPoints,i0,i1);
+    };
+
+    if(pThreadPool)
+        pThreadPool->ParallelFor(nBlocks,processBlock);
+    else
+        for(int b=0; b<nBlocks; b++)
+            processBlock(b);
+
+    // Points in view sorted by cell
+    vector<pair<int,int> > vCellIdx;
+    vCellIdx.reserve(n);
+    for(int i=0; i<n; i++)
+        if(mvCell[i]>=0)
+            vCellIdx.push_back(make_pair(mvCell[i],i));
+
+    sort(vCellIdx.begin(),vCellIdx.end());
+
+    vpInView.resize(vCellIdx.size());
+    mvpInViewDescriptors.resize(vCellIdx.size());
+    mvInViewCells.resize(vCellIdx.size());
+    for(size_t k=0; k<vCellIdx.size(); k++)
+    {
+        vpInView[k] = vpMapPoints[vCellIdx[k].second];
+        mvpInViewDescriptors[k] = mDescriptors.ptr<unsigned char>(vCellIdx[k].second);
+        mvInViewCells[k] = vCellIdx[k].first;
+    }
+}
+
+void LocalMapProjector::Snapshot(const Frame &F, const vector<MapPoint*> &vpMapPoints, const int i0, const int i1)
+{
+    for(int i=i0; i<i1; i++)
+    {
+        MapPoint* pMP = vpMapPoints[i];
+        mvbCandidate[i] = pMP->mnLastFrameSeen != F.mnId && !pMP->isBad();
+        if(!mvbCandidate[i])
+            continue;
+
+        float pos[3], normal[3];
+        pMP->GetProjectionData(pos,normal,mvMinDist[i],mvMaxDist[i],mDescriptors.ptr<unsigned char>(i));
+        mvX[i] = pos[0]; mvY[i] = pos[1]; mvZ[i] = pos[2];
+        mvNx[i] = normal[0]; mvNy[i] = normal[1]; mvNz[i] = normal[2];
+    }
+}
+
+void LocalMapProjector::Predict(const Frame &F, const vector<MapPoint*> &vpMapPoints, const int i0, const int i1)
+{
+    for(int i=i0; i<i1; i++)
+    {
+        mvCell[i] = -1;
+        if(!mvbCandidate[i])
+            continue;
+
+        MapPoint* pMP = vpMapPoints[i];
+        if(!mvbInView[i])
+        {
+            pMP->mbTrackInView = false;
+            continue;
+        }
+
+        // Predict scale in the image
+        const float ratio = mvMaxDist[i]/mvDist[i];
+        int nPredictedLevel = ceil(log(ratio)/F.mfLogScaleFactor);
+        if(nPredictedLevel<0)
+            nPredictedLevel = 0;
+        else if(nPredictedLevel>=F.mnScaleLevels)
+            nPredictedLevel = F.mnScaleLevels-1;
+
+        // Data used by the tracking
+        pMP->mbTrackInView = true;
+        pMP->mTrackProjX = mvU[i];
+        pMP->mTrackProjXR = mvU[i] - F.mbf*mvInvZ[i];
+        pMP->mTrackProjY = mvV[i];
+        pMP->mnTrackScaleLevel= nPredictedLevel;
+        pMP->mTrackViewCos = mvViewCos[i];
+
+        const int cellX = min(max((int)((mvU[i]-Frame::mnMinX)*Frame::mfGridElementWidthInv),0),FRAME_GRID_COLS-1);
+        const int cellY = min(max((int)((mvV[i]-Frame::mnMinY)*Frame::mfGridElementHeightInv),0),FRAME_GRID_ROWS-1);
+        mvCell[i] = cellX*FRAME_GRID_ROWS+cellY;
+    }
+}
+
+void LocalMapProjector::Cull(const float* pTcw, const float* pOw, const float viewingCosLimit, const int i0, const int i1)
+{
+    const float fx = Frame::fx, fy = Frame::fy, cx = Frame::cx, cy = Frame::cy;
+    const float minX = Frame::mnMinX, maxX = Frame::mnMaxX, minY = Frame::mnMinY, maxY = Frame::mnMaxY;
+
+    int i=i0;
+
+#ifdef __AVX2__
+    // Written with vector operators, so that the compiler fuses them as in the scalar loop
+    const __m256 r00 = _mm256_set1_ps(pTcw[0]), r01 = _mm256_set1_ps(pTcw[1]), r02 = _mm256_set1_ps(pTcw[2]), t0 = _mm256_set1_ps(pTcw[3]);
+    const __m256 r10 = _mm256_set1_ps(pTcw[4]), r11 = _mm256_set1_ps(pTcw[5]), r12 = _mm256_set1_ps(pTcw[6]), t1 = _mm256_set1_ps(pTcw[7]);
+    const __m256 r20 = _mm256_set1_ps(pTcw[8]), r21 = _mm256_set1_ps(pTcw[9]), r22 = _mm256_set1_ps(pTcw[10]), t2 = _mm256_set1_ps(pTcw[11]);
+    const __m256 ox = _mm256_set1_ps(pOw[0]), oy = _mm256_set1_ps(pOw[1]), oz = _mm256_set1_ps(pOw[2]);
+    const __m256 vfx = _mm256_set1_ps(fx), vfy = _mm256_set1_ps(fy), vcx = _mm256_set1_ps(cx), vcy = _mm256_set1_ps(cy);
+    const __m256 vMinX = _mm256_set1_ps(minX), vMaxX = _mm256_set1_ps(maxX);
+    const __m256 vMinY = _mm256_set1_ps(minY), vMaxY = _mm256_set1_ps(maxY);
+    const __m256 vMinFactor = _mm256_set1_ps(0.8f), vMaxFactor = _mm256_set1_ps(1.2f);
+    const __m256 vCosLimit = _mm256_set1_ps(viewingCosLimit);
+    const __m256 one = _mm256_set1_ps(1.0f), zero = _mm256_setzero_ps();
+
+    for(; i+8<=i1; i+=8)
+    {
+        const __m256 x = _mm256_loadu_ps(&mvX[i]), y = _mm256_loadu_ps(&mvY[i]), z = _mm256_loadu_ps(&mvZ[i]);
+
+        const __m256 pcx = r00*x + r01*y + r02*z + t0;
+        const __m256 pcy = r10*x + r11*y + r12*z + t1;
+        const __m256 pcz = r20*x + r21*y + r22*z + t2;
+
+        const __m256 invz = one/pcz;
+        const __m256 u = vfx*pcx*invz + vcx;
+        const __m256 v = vfy*pcy*invz + vcy;
+
+        const __m256 pox = x-ox, poy = y-oy, poz = z-oz;
+        const __m256 dist = _mm256_sqrt_ps(pox*pox + poy*poy + poz*poz);
+        const __m256 viewCos = (pox*_mm256_loadu_ps(&mvNx[i]) + poy*_mm256_loadu_ps(&mvNy[i]) + poz*_mm256_loadu_ps(&mvNz[i]))/dist;
+
+        __m256 out = _mm256_cmp_ps(pcz,zero,_CMP_LT_OQ);
+        out = _mm256_or_ps(out,_mm256_cmp_ps(u,vMinX,_CMP_LT_OQ));
+        out = _mm256_or_ps(out,_mm256_cmp_ps(u,vMaxX,_CMP_GT_OQ));
+        out = _mm256_or_ps(out,_mm256_cmp_ps(v,vMinY,_CMP_LT_OQ));
+        out = _mm256_or_ps(out,_mm256_cmp_ps(v,vMaxY,_CMP_GT_OQ));
+        out = _mm256_or_ps(out,_mm256_cmp_ps(dist,vMinFactor*_mm256_loadu_ps(&mvMinDist[i]),_CMP_LT_OQ));
+        out = _mm256_or_ps(out,_mm256_cmp_ps(dist,vMaxFactor*_mm256_loadu_ps(&mvMaxDist[i]),_CMP_GT_OQ));
+        out = _mm256_or_ps(out,_mm256_cmp_ps(viewCos,vCosLimit,_CMP_LT_OQ));
+
+        _mm256_storeu_ps(&mvU[i],u);
+        _mm256_storeu_ps(&mvV[i],v);
+        _mm256_storeu_ps(&mvInvZ[i],invz);
+        _mm256_storeu_ps(&mvDist[i],dist);
+        _mm256_storeu_ps(&mvViewCos[i],viewCos);
+
+        const int outMask = _mm256_movemask_ps(out);
+        for(int k=0; k<8; k++)
+            mvbInView[i+k] = !((outMask>>k)&1);
+    }
+#endif
+
+    for(; i<i1; i++)
+    {
+        const float x = mvX[i], y = mvY[i], z = mvZ[i];
+
+        const float pcx = pTcw[0]*x + pTcw[1]*y + pTcw[2]*z + pTcw[3];
+        const float pcy = pTcw[4]*x + pTcw[5]*y + pTcw[6]*z + pTcw[7];
+        const float pcz = pTcw[8]*x + pTcw[9]*y + pTcw[10]*z + pTcw[11];
+
+        const float invz = 1.0f/pcz;
+        const float u = fx*pcx*invz + cx;
+        const float v = fy*pcy*invz + cy;
+
+        const float pox = x-pOw[0], poy = y-pOw[1], poz = z-pOw[2];
+        const float dist = sqrt(pox*pox + poy*poy + poz*poz);
+        const float viewCos = (pox*mvNx[i] + poy*mvNy[i] + poz*mvNz[i])/dist;
+
+        mvU[i] = u;
+        mvV[i] = v;
+        mvInvZ[i] = invz;
+        mvDist[i] = dist;
+        mvViewCos[i] = viewCos;
+
+        mvbInView[i] = !(pcz<0.0f || u<minX || u>maxX || v<minY || v>maxY ||
+                         dist<0.8f*mvMinDist[i] || dist>1.2f*mvMaxDist[i] || viewCos<viewingCosLimit);
+    }
+}
+
+} //namespace ORB_SLAM
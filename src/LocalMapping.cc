@@ -24,14 +24,29 @@
 #include "Optimizer.h"
 
 #include<mutex>
+#include<iostream>
 
 namespace ORB_SLAM2
 {
 
-LocalMapping::LocalMapping(Map *pMap, const float bMonocular):
+LocalMapping::LocalMapping(Map *pMap, const float bMonocular, const string &strSettingPath):
     mbMonocular(bMonocular), mbResetRequested(false), mbFinishRequested(false), mbFinished(true), mpMap(pMap),
-    mbAbortBA(false), mbStopped(false), mbStopRequested(false), mbNotStop(false), mbAcceptKeyFrames(true)
+    mbAbortBA(false), mpBAPool(NULL), mbStopped(false), mbStopRequested(false), mbNotStop(false), mbAcceptKeyFrames(true)
 {
+    cv::FileStorage fSettings(strSettingPath, cv::FileStorage::READ);
+
+    // Optional: build and solve the local BA in parallel (0 or 1: sequential)
+    int nBAThreads = fSettings["LocalMapping.nThreads"];
+    if(nBAThreads>1)
+    {
+        mpBAPool = new ThreadPool(nBAThreads);
+        mLocalBundleAdjuster.SetThreadPool(mpBAPool);
+        cout << endl << "Local BA Threads: " << nBAThreads << endl;
+    }
+
+    // Optional: start the local BA from the damping of the previous one
+    int nWarmStart = fSettings["LocalMapping.warmStart"];
+    mLocalBundleAdjuster.SetWarmStart(nWarmStart!=0);
 }
 
 void LocalMapping::SetLoopCloser(LoopClosing* pLoopCloser)
@@ -78,7 +93,7 @@ void LocalMapping::Run()
             {
                 // Local BA
                 if(mpMap->KeyFramesInMap()>2)
-                    Optimizer::LocalBundleAdjustment(mpCurrentKeyFrame,&mbAbortBA, mpMap);
+                    Optimizer::LocalBundleAdjustment(mpCurrentKeyFrame,&mbAbortBA, mpMap, &mLocalBundleAdjuster);
 
                 // Check redundant local Keyframes
                 KeyFrameCulling();
@@ -35,12 +35,23 @@
 namespace ORB_SLAM2
 {
 
-LoopClosing::LoopClosing(Map *pMap, KeyFrameDatabase *pDB, ORBVocabulary *pVoc, const bool bFixScale):
+LoopClosing::LoopClosing(Map *pMap, KeyFrameDatabase *pDB, ORBVocabulary *pVoc, const bool bFixScale,
+                         const string &strSettingPath):
     mbResetRequested(false), mbFinishRequested(false), mbFinished(true), mpMap(pMap),
     mpKeyFrameDB(pDB), mpORBVocabulary(pVoc), mpMatchedKF(NULL), mLastLoopKFid(0), mbRunningGBA(false), mbFinishedGBA(true),
-    mbStopGBA(false), mpThreadGBA(NULL), mbFixScale(bFixScale), mnFullBAIdx(0)
+    mbStopGBA(false), mpThreadGBA(NULL), mbFixScale(bFixScale), mpOptimizerPool(NULL), mnFullBAIdx(0)
 {
     mnCovisibilityConsistencyTh = 3;
+
+    cv::FileStorage fSettings(strSettingPath, cv::FileStorage::READ);
+
+    // Optional: linearize the essential graph and the global BA in parallel (0 or 1: sequential)
+    int nOptimizerThreads = fSettings["LoopClosing.nThreads"];
+    if(nOptimizerThreads>1)
+    {
+        mpOptimizerPool = new ThreadPool(nOptimizerThreads);
+        cout << endl << "Loop Closing Optimization Threads: " << nOptimizerThreads << endl;
+    }
 }
 
 void LoopClosing::SetTracker(Tracking *pTracker)
@@ -564,7 +575,7 @@ void LoopClosing::CorrectLoop()
     }
 
     // Optimize graph
-    Optimizer::OptimizeEssentialGraph(mpMap, mpMatchedKF, mpCurrentKF, NonCorrectedSim3, CorrectedSim3, LoopConnections, mbFixScale);
+    Optimizer::OptimizeEssentialGraph(mpMap, mpMatchedKF, mpCurrentKF, NonCorrectedSim3, CorrectedSim3, LoopConnections, mbFixScale, mpOptimizerPool);
 
     mpMap->InformNewBigChange();
 
@@ -647,7 +658,7 @@ void LoopClosing::RunGlobalBundleAdjustment(unsigned long nLoopKF)
     cout << "Starting Global Bundle Adjustment" << endl;
 
     int idx =  mnFullBAIdx;
-    Optimizer::GlobalBundleAdjustemnt(mpMap,10,&mbStopGBA,nLoopKF,false);
+    Optimizer::GlobalBundleAdjustemnt(mpMap,10,&mbStopGBA,nLoopKF,false,mpOptimizerPool);
 
     // Update all MapPoints and KeyFrames
     // Local Mapping was active during BA, that means that there might be new keyframes
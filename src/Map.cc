@@ -25,7 +25,7 @@
 namespace ORB_SLAM2
 {
 
-Map::Map():mnMaxKFid(0),mnBigChangeIdx(0)
+Map::Map():mnMaxKFid(0),mnBigChangeIdx(0),mnGraphChangeIdx(0)
 {
 }
 
@@ -35,6 +35,7 @@ void Map::AddKeyFrame(KeyFrame *pKF)
     mspKeyFrames.insert(pKF);
     if(pKF->mnId>mnMaxKFid)
         mnMaxKFid=pKF->mnId;
+    mnGraphChangeIdx++;
 }
 
 void Map::AddMapPoint(MapPoint *pMP)
@@ -56,6 +57,7 @@ void Map::EraseKeyFrame(KeyFrame *pKF)
 {
     unique_lock<mutex> lock(mMutexMap);
     mspKeyFrames.erase(pKF);
+    mnGraphChangeIdx++;
 
     // TODO: This only erase the pointer.
     // Delete the MapPoint
@@ -79,6 +81,16 @@ int Map::GetLastBigChangeIdx()
     return mnBigChangeIdx;
 }
 
+void Map::InformGraphChange()
+{
+    mnGraphChangeIdx++;
+}
+
+unsigned long Map::GetLastGraphChangeIdx()
+{
+    return mnGraphChangeIdx;
+}
+
 vector<KeyFrame*> Map::GetAllKeyFrames()
 {
     unique_lock<mutex> lock(mMutexMap);
@@ -128,6 +140,7 @@ void Map::clear()
     mnMaxKFid = 0;
     mvpReferenceMapPoints.clear();
     mvpKeyFrameOrigins.clear();
+    mnGraphChangeIdx++;
 }
 
 template<class Archive>
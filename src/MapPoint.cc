@@ -20,8 +20,11 @@
 
 #include "MapPoint.h"
 #include "ORBmatcher.h"
+#include "HammingDistance.h"
 
 #include<mutex>
+#include<new>
+#include<stdlib.h>
 
 namespace ORB_SLAM2
 {
@@ -31,7 +34,7 @@ mutex MapPoint::mGlobalMutex;
 
 MapPoint::MapPoint(const cv::Mat &Pos, KeyFrame *pRefKF, Map* pMap):
     mnFirstKFid(pRefKF->mnId), mnFirstFrame(pRefKF->mnFrameId), nObs(0),mbTrackInView(false), mnTrackReferenceForFrame(0),
-    mnLastFrameSeen(0), mnBALocalForKF(0), mnFuseCandidateForKF(0), mnLoopPointForKF(0), mnCorrectedByKF(0),
+    mnLastFrameSeen(0), mnBALocalForKF(0), mnBAVertexIdx(-1), mnFuseCandidateForKF(0), mnLoopPointForKF(0), mnCorrectedByKF(0),
     mnCorrectedReference(0), mnBAGlobalForKF(0), mpRefKF(pRefKF), mnVisible(1), mnFound(1), mbBad(false),
     mpReplaced(static_cast<MapPoint*>(NULL)), mfMinDistance(0), mfMaxDistance(0), mpMap(pMap)
 {
@@ -45,9 +48,30 @@ MapPoint::MapPoint(const cv::Mat &Pos, KeyFrame *pRefKF, Map* pMap):
 
 MapPoint::MapPoint(const cv::Mat &Pos, Map* pMap, Frame* pFrame, const int &idxF):
     mnFirstKFid(-1), mnFirstFrame(pFrame->mnId), nObs(0),mbTrackInView(false), mnTrackReferenceForFrame(0), mnLastFrameSeen(0),
-    mnBALocalForKF(0), mnFuseCandidateForKF(0),mnLoopPointForKF(0), mnCorrectedByKF(0),
+    mnBALocalForKF(0), mnBAVertexIdx(-1), mnFuseCandidateForKF(0),mnLoopPointForKF(0), mnCorrectedByKF(0),
     mnCorrectedReference(0), mnBAGlobalForKF(0), mpRefKF(static_cast<KeyFrame*>(NULL)), mnVisible(1),
     mnFound(1), mbBad(false), mpReplaced(NULL), mpMap(pMap)
+{
+    InitFromFrame(Pos,pFrame,idxF);
+
+    // MapPoints can be created from Tracking and Local Mapping. This mutex avoid conflicts with id.
+    unique_lock<mutex> lock(mpMap->mMutexPointCreation);
+    mnId=nNextId++;
+}
+
+void MapPoint::ResetFromFrame(const cv::Mat &Pos, Frame* pFrame, const int &idxF)
+{
+    mnFirstFrame = pFrame->mnId;
+    mbTrackInView = false;
+    mnTrackReferenceForFrame = 0;
+    mnLastFrameSeen = 0;
+    mnVisible = 1;
+    mnFound = 1;
+
+    InitFromFrame(Pos,pFrame,idxF);
+}
+
+void MapPoint::InitFromFrame(const cv::Mat &Pos, Frame* pFrame, const int &idxF)
 {
     Pos.copyTo(mWorldPos);
     cv::Mat Ow = pFrame->GetCameraCenter();
@@ -63,11 +87,7 @@ MapPoint::MapPoint(const cv::Mat &Pos, Map* pMap, Frame* pFrame, const int &idxF
     mfMaxDistance = dist*levelScaleFactor;
     mfMinDistance = mfMaxDistance/pFrame->mvScaleFactors[nLevels-1];
 
-    pFrame->mDescriptors.row(idxF).copyTo(mDescriptor);
-
-    // MapPoints can be created from Tracking and Local Mapping. This mutex avoid conflicts with id.
-    unique_lock<mutex> lock(mpMap->mMutexPointCreation);
-    mnId=nNextId++;
+    mDescriptor.Store(pFrame->mDescriptors.ptr<uchar>(idxF));
 }
 
 void MapPoint::SetWorldPos(const cv::Mat &Pos)
@@ -142,6 +162,13 @@ map<KeyFrame*, size_t> MapPoint::GetObservations()
     return mObservations;
 }
 
+void MapPoint::GetObservingKeyFrames(vector<KeyFrame*> &vpKFs)
+{
+    unique_lock<mutex> lock(mMutexFeatures);
+    for(map<KeyFrame*,size_t>::const_iterator mit=mObservations.begin(), mend=mObservations.end(); mit!=mend; mit++)
+        vpKFs.push_back(mit->first);
+}
+
 int MapPoint::Observations()
 {
     unique_lock<mutex> lock(mMutexFeatures);
@@ -223,26 +250,23 @@ bool MapPoint::isBad()
 
 void MapPoint::IncreaseVisible(int n)
 {
-    unique_lock<mutex> lock(mMutexFeatures);
-    mnVisible+=n;
+    mnVisible.fetch_add(n,memory_order_relaxed);
 }
 
 void MapPoint::IncreaseFound(int n)
 {
-    unique_lock<mutex> lock(mMutexFeatures);
-    mnFound+=n;
+    mnFound.fetch_add(n,memory_order_relaxed);
 }
 
 float MapPoint::GetFoundRatio()
 {
-    unique_lock<mutex> lock(mMutexFeatures);
-    return static_cast<float>(mnFound)/mnVisible;
+    return static_cast<float>(mnFound.load(memory_order_relaxed))/mnVisible.load(memory_order_relaxed);
 }
 
 void MapPoint::ComputeDistinctiveDescriptors()
 {
     // Retrieve all observed descriptors
-    vector<cv::Mat> vDescriptors;
+    cv::Mat Descriptors;
 
     map<KeyFrame*,size_t> observations;
 
@@ -256,29 +280,35 @@ void MapPoint::ComputeDistinctiveDescriptors()
     if(observations.empty())
         return;
 
-    vDescriptors.reserve(observations.size());
+    // Pack descriptors contiguously to compute each row in one kernel call
+    Descriptors = DescriptorStore::Allocate(observations.size());
 
+    size_t N = 0;
     for(map<KeyFrame*,size_t>::iterator mit=observations.begin(), mend=observations.end(); mit!=mend; mit++)
     {
         KeyFrame* pKF = mit->first;
 
         if(!pKF->isBad())
-            vDescriptors.push_back(pKF->mDescriptors.row(mit->second));
+            memcpy(Descriptors.ptr<uchar>(N++),pKF->mDescriptors.ptr<uchar>(mit->second),DescriptorStore::DESCRIPTOR_BYTES);
     }
 
-    if(vDescriptors.empty())
+    if(N==0)
         return;
 
     // Compute distances between them
-    const size_t N = vDescriptors.size();
 
     float Distances[N][N];
+    vector<int> vRowDists(N);
     for(size_t i=0;i<N;i++)
     {
         Distances[i][i]=0;
+        if(i+1==N)
+            break;
+        HammingDistance::ComputeOneToMany(Descriptors.ptr<uchar>(i),Descriptors.ptr<uchar>(i+1),Descriptors.step[0],
+                                          N-i-1,&vRowDists[0]);
         for(size_t j=i+1;j<N;j++)
         {
-            int distij = ORBmatcher::DescriptorDistance(vDescriptors[i],vDescriptors[j]);
+            int distij = vRowDists[j-i-1];
             Distances[i][j]=distij;
             Distances[j][i]=distij;
         }
@@ -302,14 +332,28 @@ void MapPoint::ComputeDistinctiveDescriptors()
 
     {
         unique_lock<mutex> lock(mMutexFeatures);
-        mDescriptor = vDescriptors[BestIdx].clone();
+        mDescriptor.Store(Descriptors.ptr<uchar>(BestIdx));
     }
 }
 
 cv::Mat MapPoint::GetDescriptor()
 {
-    unique_lock<mutex> lock(mMutexFeatures);
-    return mDescriptor.clone();
+    cv::Mat D(1,DescriptorStore::DESCRIPTOR_BYTES,CV_8U);
+    mDescriptor.Load(D.data);
+    return D;
+}
+
+void* MapPoint::operator new(std::size_t size)
+{
+    void* p = NULL;
+    if(posix_memalign(&p,DescriptorStore::ALIGNMENT,size)!=0)
+        throw std::bad_alloc();
+    return p;
+}
+
+void MapPoint::operator delete(void* p)
+{
+    free(p);
 }
 
 int MapPoint::GetIndexInKeyFrame(KeyFrame *pKF)
@@ -382,6 +426,23 @@ float MapPoint::GetMaxDistanceInvariance()
     return 1.2f*mfMaxDistance;
 }
 
+void MapPoint::GetProjectionData(float* pPos, float* pNormal, float &minDistance, float &maxDistance,
+                                 unsigned char* pDescriptor)
+{
+    {
+        unique_lock<mutex> lock(mMutexPos);
+        for(int i=0; i<3; i++)
+        {
+            pPos[i] = mWorldPos.at<float>(i);
+            pNormal[i] = mNormalVector.at<float>(i);
+        }
+        minDistance = mfMinDistance;
+        maxDistance = mfMaxDistance;
+    }
+
+    mDescriptor.Load(pDescriptor);
+}
+
 int MapPoint::PredictScale(const float &currentDist, KeyFrame* pKF)
 {
     float ratio;
@@ -418,7 +479,7 @@ int MapPoint::PredictScale(const float &currentDist, Frame* pF)
 
 MapPoint::MapPoint():
     nObs(0), mnTrackReferenceForFrame(0),
-    mnLastFrameSeen(0), mnBALocalForKF(0), mnFuseCandidateForKF(0), mnLoopPointForKF(0), mnCorrectedByKF(0),
+    mnLastFrameSeen(0), mnBALocalForKF(0), mnBAVertexIdx(-1), mnFuseCandidateForKF(0), mnLoopPointForKF(0), mnCorrectedByKF(0),
     mnCorrectedReference(0), mnBAGlobalForKF(0),mnVisible(1), mnFound(1), mbBad(false),
     mpReplaced(static_cast<MapPoint*>(NULL)), mfMinDistance(0), mfMaxDistance(0)
 {}
@@ -443,9 +504,21 @@ void MapPoint::serialize(Archive &ar, const unsigned int version)
     ar & mWorldPos;
     ar & mObservations;
     ar & mNormalVector;
-    ar & mDescriptor;
+    // The descriptor is stored as a cv::Mat, as in previous map files
+    cv::Mat descriptor;
+    if(Archive::is_saving::value)
+        descriptor = GetDescriptor();
+    ar & descriptor;
+    if(Archive::is_loading::value && !descriptor.empty())
+        mDescriptor.Store(descriptor.ptr<uchar>());
     ar & mpRefKF;
-    ar & mnVisible & mnFound;
+    int nVisible = mnVisible, nFound = mnFound;
+    ar & nVisible & nFound;
+    if(Archive::is_loading::value)
+    {
+        mnVisible = nVisible;
+        mnFound = nFound;
+    }
     ar & mbBad & mpReplaced;
     ar & mfMinDistance & mfMaxDistance;
     ar & mpMap;
@@ -59,8 +59,12 @@
 #include <opencv2/features2d/features2d.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 #include <vector>
+#ifdef __SSE2__
+#include <immintrin.h>
+#endif
 
 #include "ORBextractor.h"
+#include "DescriptorStore.h"
 
 
 using namespace cv;
@@ -74,6 +78,285 @@ const int HALF_PATCH_SIZE = 15;
 const int EDGE_THRESHOLD = 19;
 
 
+// FAST-9 on the 16 pixel Bresenham circle of radius 3, as in cv::FAST. A pixel is a corner for
+// threshold t if 9 contiguous circle pixels are all brighter than center+t or all darker than
+// center-t. Its score S is the largest such margin: it is a corner for every t<S and cv::FAST
+// (with non-maxima suppression) reports a response of S-1, independently of t.
+static const int FAST_CIRCLE[16][2] =
+{
+    {0,  3}, { 1,  3}, { 2,  2}, { 3,  1}, { 3, 0}, { 3, -1}, { 2, -2}, { 1, -3},
+    {0, -3}, {-1, -3}, {-2, -2}, {-3, -1}, {-3, 0}, {-3,  1}, {-2,  2}, {-1,  3}
+};
+
+static int fastScore(const uchar* ptr, const int pixel[16])
+{
+    const int v = ptr[0];
+    int db[16], dd[16];
+    for(int k=0; k<16; k++)
+    {
+        const int p = ptr[pixel[k]];
+        db[k] = std::max(p-v,0);
+        dd[k] = std::max(v-p,0);
+    }
+
+    int score = 0;
+    for(int k=0; k<16; k++)
+    {
+        int mb = 255, md = 255;
+        for(int j=0; j<9; j++)
+        {
+            mb = std::min(mb,db[(k+j)&15]);
+            md = std::min(md,dd[(k+j)&15]);
+        }
+        score = std::max(score,std::max(mb,md));
+    }
+    return score;
+}
+
+#ifdef __SSE2__
+// Largest minimum over the 16 arcs of 9 contiguous circle differences, 16 pixels at once
+static inline __m128i fastMaxArcMin(const __m128i d[16])
+{
+    __m128i m2[16], m4[16];
+    for(int k=0; k<16; k++)
+        m2[k] = _mm_min_epu8(d[k],d[(k+1)&15]);
+    for(int k=0; k<16; k++)
+        m4[k] = _mm_min_epu8(m2[k],m2[(k+2)&15]);
+
+    __m128i res = _mm_setzero_si128();
+    for(int k=0; k<16; k++)
+    {
+        const __m128i m8 = _mm_min_epu8(m4[k],m4[(k+4)&15]);
+        res = _mm_max_epu8(res,_mm_min_epu8(m8,d[(k+8)&15]));
+    }
+    return res;
+}
+
+// Scores of the 16 pixels starting at ptr, 0 for those that are not corners for threshold
+static inline void fastScoreBlock(const uchar* ptr, const int pixel[16], const __m128i vt, uchar* dst)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i v = _mm_loadu_si128((const __m128i*)ptr);
+
+    __m128i p[16];
+    for(int k=0; k<16; k++)
+        p[k] = _mm_loadu_si128((const __m128i*)(ptr+pixel[k]));
+
+    // Any 9-arc contains two consecutive compass points (0,4,8,12): reject the block early
+    const __m128i vhi = _mm_adds_epu8(v,vt), vlo = _mm_subs_epu8(v,vt);
+    __m128i b[4], d[4];
+    for(int k=0; k<4; k++)
+    {
+        b[k] = _mm_subs_epu8(p[4*k],vhi);
+        d[k] = _mm_subs_epu8(vlo,p[4*k]);
+    }
+    __m128i cand = zero;
+    for(int k=0; k<4; k++)
+    {
+        cand = _mm_max_epu8(cand,_mm_min_epu8(b[k],b[(k+1)&3]));
+        cand = _mm_max_epu8(cand,_mm_min_epu8(d[k],d[(k+1)&3]));
+    }
+    if(_mm_movemask_epi8(_mm_cmpeq_epi8(cand,zero))==0xFFFF)
+    {
+        _mm_storeu_si128((__m128i*)dst,zero);
+        return;
+    }
+
+    __m128i db[16], dd[16];
+    for(int k=0; k<16; k++)
+    {
+        db[k] = _mm_subs_epu8(p[k],v);
+        dd[k] = _mm_subs_epu8(v,p[k]);
+    }
+    const __m128i score = _mm_max_epu8(fastMaxArcMin(db),fastMaxArcMin(dd));
+    const __m128i notCorner = _mm_cmpeq_epi8(_mm_subs_epu8(score,vt),zero);
+    _mm_storeu_si128((__m128i*)dst,_mm_andnot_si128(notCorner,score));
+}
+#endif
+
+// Computes the FAST score of every pixel in [x0,x1)x[y0,y1) (0 if it is not a corner for threshold).
+// The circle of each pixel must lie inside the image.
+static void computeFastScores(const uchar* image, size_t step, uchar* scores, size_t scoresStep,
+                              int x0, int y0, int x1, int y1, int threshold)
+{
+    threshold = std::min(std::max(threshold,0),255);
+
+    int pixel[16];
+    for(int k=0; k<16; k++)
+        pixel[k] = FAST_CIRCLE[k][0] + FAST_CIRCLE[k][1]*(int)step;
+
+#ifdef __SSE2__
+    const __m128i vt = _mm_set1_epi8((char)threshold);
+#endif
+
+    for(int y=y0; y<y1; y++)
+    {
+        const uchar* row = image + y*step;
+        uchar* srow = scores + y*scoresStep;
+        int x = x0;
+#ifdef __SSE2__
+        if(x1-x0>=16)
+        {
+            for(; x+16<=x1; x+=16)
+                fastScoreBlock(row+x,pixel,vt,srow+x);
+            // Last block overlaps the previous one
+            if(x<x1)
+                fastScoreBlock(row+x1-16,pixel,vt,srow+x1-16);
+            continue;
+        }
+#endif
+        for(; x<x1; x++)
+        {
+            const int score = fastScore(row+x,pixel);
+            srow[x] = score>threshold ? (uchar)score : 0;
+        }
+    }
+}
+
+// Appends the keypoints cv::FAST(image(window), keypoints, threshold, true) would return for the
+// window [wx0,wx1)x[wy0,wy1), using scores precomputed for a threshold not above this one.
+// Keypoint coordinates are relative to (ox,oy). Returns the number of keypoints found.
+static int detectFastInWindow(const uchar* scores, size_t scoresStep, int wx0, int wy0, int wx1, int wy1,
+                              int threshold, int ox, int oy, vector<KeyPoint>& keypoints)
+{
+    threshold = std::min(std::max(threshold,0),255);
+
+    // cv::FAST only tests pixels 3 away from the window border, other pixels have score 0
+    // in the non-maxima suppression
+    const int x0 = wx0+3, x1 = wx1-3, y0 = wy0+3, y1 = wy1-3;
+
+    int nFound = 0;
+    for(int y=y0; y<y1; y++)
+    {
+        const uchar* rows[3] = {scores+(y-1)*scoresStep, scores+y*scoresStep, scores+(y+1)*scoresStep};
+        const bool bRowValid[3] = {y-1>=y0, true, y+1<y1};
+        const uchar* curr = rows[1];
+
+        for(int x=x0; x<x1; x++)
+        {
+#ifdef __SSE2__
+            // Skip 16 pixels without corners at once
+            if(x+16<=x1)
+            {
+                const __m128i s = _mm_loadu_si128((const __m128i*)(curr+x));
+                const __m128i below = _mm_cmpeq_epi8(_mm_subs_epu8(s,_mm_set1_epi8((char)threshold)),_mm_setzero_si128());
+                if(_mm_movemask_epi8(below)==0xFFFF)
+                {
+                    x += 15;
+                    continue;
+                }
+            }
+#endif
+            const int s = curr[x];
+            if(s<=threshold)
+                continue;
+
+            const int score = s-1;
+            bool bMax = true;
+            for(int r=0; r<3 && bMax; r++)
+            {
+                if(!bRowValid[r])
+                {
+                    bMax = score>0;
+                    continue;
+                }
+                for(int dx=-1; dx<=1; dx++)
+                {
+                    if(r==1 && dx==0)
+                        continue;
+                    const int nx = x+dx;
+                    int neighbour = 0;
+                    if(nx>=x0 && nx<x1 && rows[r][nx]>threshold)
+                        neighbour = rows[r][nx]-1;
+                    if(score<=neighbour)
+                    {
+                        bMax = false;
+                        break;
+                    }
+                }
+            }
+
+            if(bMax)
+            {
+                keypoints.push_back(KeyPoint((float)(x-ox),(float)(y-oy),7.f,-1,(float)score));
+                nFound++;
+            }
+        }
+    }
+
+    return nFound;
+}
+
+
+#ifdef __SSE2__
+// Weights of the intensity centroid moments, one row of 32 lanes per v. Lane k stands for
+// u = k-HALF_PATCH_SIZE and is 0 outside the circular patch (lane 31 always is).
+struct ICAngleWeights
+{
+    alignas(16) short u[HALF_PATCH_SIZE+1][32];
+    alignas(16) short v[HALF_PATCH_SIZE+1][32];
+};
+
+static void computeICAngleWeights(const vector<int>& u_max, ICAngleWeights& w)
+{
+    for (int v = 0; v <= HALF_PATCH_SIZE; ++v)
+    {
+        for (int k = 0; k < 32; ++k)
+        {
+            const int u = k - HALF_PATCH_SIZE;
+            const bool inside = k < 2*HALF_PATCH_SIZE+1 && abs(u) <= u_max[v];
+            w.u[v][k] = inside ? (short)u : 0;
+            w.v[v][k] = inside ? (short)v : 0;
+        }
+    }
+}
+
+static inline void loadPatchRow(const uchar* p, __m128i row[4])
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i lo = _mm_loadu_si128((const __m128i*)p);
+    const __m128i hi = _mm_loadu_si128((const __m128i*)(p+16));
+    row[0] = _mm_unpacklo_epi8(lo,zero);
+    row[1] = _mm_unpackhi_epi8(lo,zero);
+    row[2] = _mm_unpacklo_epi8(hi,zero);
+    row[3] = _mm_unpackhi_epi8(hi,zero);
+}
+
+static inline int sumLanes(__m128i v)
+{
+    v = _mm_add_epi32(v,_mm_shuffle_epi32(v,_MM_SHUFFLE(1,0,3,2)));
+    v = _mm_add_epi32(v,_mm_shuffle_epi32(v,_MM_SHUFFLE(2,3,0,1)));
+    return _mm_cvtsi128_si32(v);
+}
+
+// Same integer moments as IC_Angle, whole patch rows at a time. Reads one byte past
+// the patch on the right of each row.
+static void IC_Moments(const uchar* center, int step, const ICAngleWeights& w, int& m_01, int& m_10)
+{
+    __m128i acc10 = _mm_setzero_si128(), acc01 = _mm_setzero_si128();
+    __m128i plus[4], minus[4];
+
+    loadPatchRow(center-HALF_PATCH_SIZE,plus);
+    for (int k = 0; k < 4; ++k)
+        acc10 = _mm_add_epi32(acc10,_mm_madd_epi16(plus[k],_mm_load_si128((const __m128i*)&w.u[0][8*k])));
+
+    for (int v = 1; v <= HALF_PATCH_SIZE; ++v)
+    {
+        loadPatchRow(center+v*step-HALF_PATCH_SIZE,plus);
+        loadPatchRow(center-v*step-HALF_PATCH_SIZE,minus);
+        for (int k = 0; k < 4; ++k)
+        {
+            const __m128i wu = _mm_load_si128((const __m128i*)&w.u[v][8*k]);
+            const __m128i wv = _mm_load_si128((const __m128i*)&w.v[v][8*k]);
+            acc10 = _mm_add_epi32(acc10,_mm_madd_epi16(_mm_add_epi16(plus[k],minus[k]),wu));
+            acc01 = _mm_add_epi32(acc01,_mm_madd_epi16(_mm_sub_epi16(plus[k],minus[k]),wv));
+        }
+    }
+
+    m_01 = sumLanes(acc01);
+    m_10 = sumLanes(acc10);
+}
+#else
 static float IC_Angle(const Mat& image, Point2f pt,  const vector<int> & u_max)
 {
     int m_01 = 0, m_10 = 0;
@@ -102,9 +385,41 @@ static float IC_Angle(const Mat& image, Point2f pt,  const vector<int> & u_max)
 
     return fastAtan2((float)m_01, (float)m_10);
 }
+#endif
 
 
 const float factorPI = (float)(CV_PI/180.f);
+#ifdef __AVX2__
+// rBRIEF tests of 16 pattern points (8 pairs) per iteration. The rotated offsets are written
+// as the same float expressions as GET_VALUE (so FMA contraction treats both alike) and rounded
+// the same way, the descriptor is bit-identical. Pixels are gathered as 32-bit words, reading
+// up to 3 bytes past each sample.
+static void computeOrbDescriptor(const uchar* center, int step, float a, float b,
+                                 const float* px, const float* py, uchar* desc)
+{
+    const __m256 va = _mm256_set1_ps(a), vb = _mm256_set1_ps(b);
+    const __m256i vstep = _mm256_set1_epi32(step);
+    const __m256i byteMask = _mm256_set1_epi32(0xFF);
+
+    for (int i = 0; i < 32; ++i, px += 16, py += 16)
+    {
+        int val = 0;
+        for (int h = 0; h < 2; ++h)
+        {
+            const __m256 x = _mm256_load_ps(px+8*h), y = _mm256_load_ps(py+8*h);
+            const __m256i iy = _mm256_cvtps_epi32(x*vb + y*va);
+            const __m256i ix = _mm256_cvtps_epi32(x*va - y*vb);
+            const __m256i offsets = _mm256_add_epi32(_mm256_mullo_epi32(iy,vstep),ix);
+            const __m256i t = _mm256_and_si256(_mm256_i32gather_epi32((const int*)center,offsets,1),byteMask);
+
+            // t0 < t1 for each (even,odd) pair, moved to the sign bit of its 64-bit lane
+            const __m256i lt = _mm256_cmpgt_epi32(_mm256_srli_epi64(t,32),t);
+            val |= _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_slli_epi64(lt,32))) << (4*h);
+        }
+        desc[i] = (uchar)val;
+    }
+}
+#else
 static void computeOrbDescriptor(const KeyPoint& kpt,
                                  const Mat& img, const Point* pattern,
                                  uchar* desc)
@@ -145,6 +460,7 @@ static void computeOrbDescriptor(const KeyPoint& kpt,
 
     #undef GET_VALUE
 }
+#endif
 
 
 static int bit_pattern_31_[256*4] =
@@ -409,41 +725,15 @@ static int bit_pattern_31_[256*4] =
 
 ORBextractor::ORBextractor(int _nfeatures, float _scaleFactor, int _nlevels,
          int _iniThFAST, int _minThFAST):
-    nfeatures(_nfeatures), scaleFactor(_scaleFactor), nlevels(_nlevels),
-    iniThFAST(_iniThFAST), minThFAST(_minThFAST)
+    FeatureExtractor(_nfeatures,_scaleFactor,_nlevels),
+    iniThFAST(_iniThFAST), minThFAST(_minThFAST), mbBlurLevels(true), mbBudgetRequested(false),
+    mnRequestedFeatures(_nfeatures), mnRequestedIniThFAST(_iniThFAST), mnRequestedMinThFAST(_minThFAST)
 {
-    mvScaleFactor.resize(nlevels);
-    mvLevelSigma2.resize(nlevels);
-    mvScaleFactor[0]=1.0f;
-    mvLevelSigma2[0]=1.0f;
-    for(int i=1; i<nlevels; i++)
-    {
-        mvScaleFactor[i]=mvScaleFactor[i-1]*scaleFactor;
-        mvLevelSigma2[i]=mvScaleFactor[i]*mvScaleFactor[i];
-    }
-
-    mvInvScaleFactor.resize(nlevels);
-    mvInvLevelSigma2.resize(nlevels);
-    for(int i=0; i<nlevels; i++)
-    {
-        mvInvScaleFactor[i]=1.0f/mvScaleFactor[i];
-        mvInvLevelSigma2[i]=1.0f/mvLevelSigma2[i];
-    }
-
-    mvImagePyramid.resize(nlevels);
-
-    mnFeaturesPerLevel.resize(nlevels);
-    float factor = 1.0f / scaleFactor;
-    float nDesiredFeaturesPerScale = nfeatures*(1 - factor)/(1 - (float)pow((double)factor, (double)nlevels));
+    mvPyramidBuffers.resize(nlevels);
+    mvBlurredPyramid.resize(nlevels);
+    mvFastScores.resize(nlevels);
 
-    int sumFeatures = 0;
-    for( int level = 0; level < nlevels-1; level++ )
-    {
-        mnFeaturesPerLevel[level] = cvRound(nDesiredFeaturesPerScale);
-        sumFeatures += mnFeaturesPerLevel[level];
-        nDesiredFeaturesPerScale *= factor;
-    }
-    mnFeaturesPerLevel[nlevels-1] = std::max(nfeatures - sumFeatures, 0);
+    ComputeFeaturesPerLevel();
 
     const int npoints = 512;
     const Point* pattern0 = (const Point*)bit_pattern_31_;
@@ -471,69 +761,74 @@ ORBextractor::ORBextractor(int _nfeatures, float _scaleFactor, int _nlevels,
 
 static void computeOrientation(const Mat& image, vector<KeyPoint>& keypoints, const vector<int>& umax)
 {
+#ifdef __SSE2__
+    ICAngleWeights weights;
+    computeICAngleWeights(umax, weights);
+    const int step = (int)image.step1();
+#endif
+
     for (vector<KeyPoint>::iterator keypoint = keypoints.begin(),
          keypointEnd = keypoints.end(); keypoint != keypointEnd; ++keypoint)
     {
+#ifdef __SSE2__
+        int m_01, m_10;
+        IC_Moments(&image.at<uchar>(cvRound(keypoint->pt.y), cvRound(keypoint->pt.x)), step, weights, m_01, m_10);
+        keypoint->angle = fastAtan2((float)m_01, (float)m_10);
+#else
         keypoint->angle = IC_Angle(image, keypoint->pt, umax);
+#endif
     }
 }
 
-void ExtractorNode::DivideNode(ExtractorNode &n1, ExtractorNode &n2, ExtractorNode &n3, ExtractorNode &n4)
+void ExtractorNode::DivideNode(ExtractorNode &n1, ExtractorNode &n2, ExtractorNode &n3, ExtractorNode &n4,
+                               const cv::KeyPoint* pKeys, int* pKeyIdx, int* pScratch) const
 {
-    const int halfX = ceil(static_cast<float>(UR.x-UL.x)/2);
+    const int halfX = ceil(static_cast<float>(BR.x-UL.x)/2);
     const int halfY = ceil(static_cast<float>(BR.y-UL.y)/2);
 
     //Define boundaries of childs
+    const cv::Point2i C(UL.x+halfX,UL.y+halfY);
     n1.UL = UL;
-    n1.UR = cv::Point2i(UL.x+halfX,UL.y);
-    n1.BL = cv::Point2i(UL.x,UL.y+halfY);
-    n1.BR = cv::Point2i(UL.x+halfX,UL.y+halfY);
-    n1.vKeys.reserve(vKeys.size());
-
-    n2.UL = n1.UR;
-    n2.UR = UR;
-    n2.BL = n1.BR;
-    n2.BR = cv::Point2i(UR.x,UL.y+halfY);
-    n2.vKeys.reserve(vKeys.size());
-
-    n3.UL = n1.BL;
-    n3.UR = n1.BR;
-    n3.BL = BL;
-    n3.BR = cv::Point2i(n1.BR.x,BL.y);
-    n3.vKeys.reserve(vKeys.size());
-
-    n4.UL = n3.UR;
-    n4.UR = n2.BR;
-    n4.BL = n3.BR;
+    n1.BR = C;
+    n2.UL = cv::Point2i(C.x,UL.y);
+    n2.BR = cv::Point2i(BR.x,C.y);
+    n3.UL = cv::Point2i(UL.x,C.y);
+    n3.BR = cv::Point2i(C.x,BR.y);
+    n4.UL = C;
     n4.BR = BR;
-    n4.vKeys.reserve(vKeys.size());
 
-    //Associate points to childs
-    for(size_t i=0;i<vKeys.size();i++)
+    //Associate points to childs, keeping their order
+    int nCount[4] = {0,0,0,0};
+    for(int i=begin;i<end;i++)
     {
-        const cv::KeyPoint &kp = vKeys[i];
-        if(kp.pt.x<n1.UR.x)
-        {
-            if(kp.pt.y<n1.BR.y)
-                n1.vKeys.push_back(kp);
-            else
-                n3.vKeys.push_back(kp);
-        }
-        else if(kp.pt.y<n1.BR.y)
-            n2.vKeys.push_back(kp);
-        else
-            n4.vKeys.push_back(kp);
+        const cv::KeyPoint &kp = pKeys[pKeyIdx[i]];
+        nCount[(kp.pt.x<C.x ? 0 : 1) + (kp.pt.y<C.y ? 0 : 2)]++;
     }
 
-    if(n1.vKeys.size()==1)
-        n1.bNoMore = true;
-    if(n2.vKeys.size()==1)
-        n2.bNoMore = true;
-    if(n3.vKeys.size()==1)
-        n3.bNoMore = true;
-    if(n4.vKeys.size()==1)
-        n4.bNoMore = true;
+    n1.begin = begin;
+    n1.end = n2.begin = n1.begin+nCount[0];
+    n2.end = n3.begin = n2.begin+nCount[1];
+    n3.end = n4.begin = n3.begin+nCount[2];
+    n4.end = end;
 
+    int nPos[4] = {n1.begin,n2.begin,n3.begin,n4.begin};
+    for(int i=begin;i<end;i++)
+    {
+        const cv::KeyPoint &kp = pKeys[pKeyIdx[i]];
+        pScratch[nPos[(kp.pt.x<C.x ? 0 : 1) + (kp.pt.y<C.y ? 0 : 2)]++] = pKeyIdx[i];
+    }
+    copy(pScratch+begin,pScratch+end,pKeyIdx+begin);
+
+    n1.bNoMore = n1.Size()==1;
+    n2.bNoMore = n2.Size()==1;
+    n3.bNoMore = n3.Size()==1;
+    n4.bNoMore = n4.Size()==1;
+}
+
+vector<cv::KeyPoint> ORBextractor::DistributeKeyPoints(const vector<cv::KeyPoint>& vToDistributeKeys, const int &minX,
+                                       const int &maxX, const int &minY, const int &maxY, const int &N, const int &level)
+{
+    return DistributeOctTree(vToDistributeKeys, minX, maxX, minY, maxY, N, level);
 }
 
 vector<cv::KeyPoint> ORBextractor::DistributeOctTree(const vector<cv::KeyPoint>& vToDistributeKeys, const int &minX,
@@ -544,215 +839,183 @@ vector<cv::KeyPoint> ORBextractor::DistributeOctTree(const vector<cv::KeyPoint>&
 
     const float hX = static_cast<float>(maxX-minX)/nIni;
 
-    list<ExtractorNode> lNodes;
+    const int nKeys = vToDistributeKeys.size();
+    const cv::KeyPoint* pKeys = nKeys ? &vToDistributeKeys[0] : NULL;
 
-    vector<ExtractorNode*> vpIniNodes;
-    vpIniNodes.resize(nIni);
+    // Nodes refer to ranges of this array of keypoint indices
+    vector<int> vKeyIdx(nKeys), vScratch(nKeys);
+
+    //Associate points to initial nodes, keeping their order
+    vector<int> vIniBegin(nIni+1,0);
+    for(int i=0;i<nKeys;i++)
+        vIniBegin[static_cast<int>(pKeys[i].pt.x/hX)+1]++;
+    for(int i=0;i<nIni;i++)
+        vIniBegin[i+1] += vIniBegin[i];
+    vector<int> vIniPos(vIniBegin.begin(),vIniBegin.end()-1);
+    for(int i=0;i<nKeys;i++)
+        vKeyIdx[vIniPos[static_cast<int>(pKeys[i].pt.x/hX)]++] = i;
+
+    vector<ExtractorNode> vNodes;
+    vNodes.reserve(nIni+4*N);
+
+    // Nodes in list order, front first
+    vector<int> vOrder;
+    vOrder.reserve(nIni);
 
     for(int i=0; i<nIni; i++)
     {
+        if(vIniBegin[i]==vIniBegin[i+1])
+            continue;
+
         ExtractorNode ni;
         ni.UL = cv::Point2i(hX*static_cast<float>(i),0);
-        ni.UR = cv::Point2i(hX*static_cast<float>(i+1),0);
-        ni.BL = cv::Point2i(ni.UL.x,maxY-minY);
-        ni.BR = cv::Point2i(ni.UR.x,maxY-minY);
-        ni.vKeys.reserve(vToDistributeKeys.size());
+        ni.BR = cv::Point2i(hX*static_cast<float>(i+1),maxY-minY);
+        ni.begin = vIniBegin[i];
+        ni.end = vIniBegin[i+1];
+        ni.bNoMore = ni.Size()==1;
 
-        lNodes.push_back(ni);
-        vpIniNodes[i] = &lNodes.back();
+        vOrder.push_back(vNodes.size());
+        vNodes.push_back(ni);
     }
 
-    //Associate points to childs
-    for(size_t i=0;i<vToDistributeKeys.size();i++)
-    {
-        const cv::KeyPoint &kp = vToDistributeKeys[i];
-        vpIniNodes[kp.pt.x/hX]->vKeys.push_back(kp);
-    }
+    // Nodes with more than one point created in the last subdivision, as (size,node)
+    vector<pair<int,int> > vSizeAndNode;
+    vSizeAndNode.reserve(vOrder.size()*4);
 
-    list<ExtractorNode>::iterator lit = lNodes.begin();
-
-    while(lit!=lNodes.end())
-    {
-        if(lit->vKeys.size()==1)
-        {
-            lit->bNoMore=true;
-            lit++;
-        }
-        else if(lit->vKeys.empty())
-            lit = lNodes.erase(lit);
-        else
-            lit++;
-    }
+    vector<int> vChildren, vKept;
 
     bool bFinish = false;
 
-    int iteration = 0;
-
-    vector<pair<int,ExtractorNode*> > vSizeAndPointerToNode;
-    vSizeAndPointerToNode.reserve(lNodes.size()*4);
-
     while(!bFinish)
     {
-        iteration++;
-
-        int prevSize = lNodes.size();
-
-        lit = lNodes.begin();
+        const int prevSize = vOrder.size();
 
-        int nToExpand = 0;
+        vSizeAndNode.clear();
+        vChildren.clear();
+        vKept.clear();
 
-        vSizeAndPointerToNode.clear();
-
-        while(lit!=lNodes.end())
+        for(size_t i=0; i<vOrder.size(); i++)
         {
-            if(lit->bNoMore)
+            // If node only contains one point do not subdivide and continue
+            if(vNodes[vOrder[i]].bNoMore)
             {
-                // If node only contains one point do not subdivide and continue
-                lit++;
+                vKept.push_back(vOrder[i]);
                 continue;
             }
-            else
-            {
-                // If more than one point, subdivide
-                ExtractorNode n1,n2,n3,n4;
-                lit->DivideNode(n1,n2,n3,n4);
 
-                // Add childs if they contain points
-                if(n1.vKeys.size()>0)
-                {
-                    lNodes.push_front(n1);                    
-                    if(n1.vKeys.size()>1)
-                    {
-                        nToExpand++;
-                        vSizeAndPointerToNode.push_back(make_pair(n1.vKeys.size(),&lNodes.front()));
-                        lNodes.front().lit = lNodes.begin();
-                    }
-                }
-                if(n2.vKeys.size()>0)
-                {
-                    lNodes.push_front(n2);
-                    if(n2.vKeys.size()>1)
-                    {
-                        nToExpand++;
-                        vSizeAndPointerToNode.push_back(make_pair(n2.vKeys.size(),&lNodes.front()));
-                        lNodes.front().lit = lNodes.begin();
-                    }
-                }
-                if(n3.vKeys.size()>0)
-                {
-                    lNodes.push_front(n3);
-                    if(n3.vKeys.size()>1)
-                    {
-                        nToExpand++;
-                        vSizeAndPointerToNode.push_back(make_pair(n3.vKeys.size(),&lNodes.front()));
-                        lNodes.front().lit = lNodes.begin();
-                    }
-                }
-                if(n4.vKeys.size()>0)
-                {
-                    lNodes.push_front(n4);
-                    if(n4.vKeys.size()>1)
-                    {
-                        nToExpand++;
-                        vSizeAndPointerToNode.push_back(make_pair(n4.vKeys.size(),&lNodes.front()));
-                        lNodes.front().lit = lNodes.begin();
-                    }
-                }
+            // If more than one point, subdivide
+            ExtractorNode n[4];
+            vNodes[vOrder[i]].DivideNode(n[0],n[1],n[2],n[3],pKeys,&vKeyIdx[0],&vScratch[0]);
 
-                lit=lNodes.erase(lit);
-                continue;
+            // Add childs if they contain points
+            for(int c=0; c<4; c++)
+            {
+                if(n[c].Size()==0)
+                    continue;
+                if(n[c].Size()>1)
+                    vSizeAndNode.push_back(make_pair(n[c].Size(),(int)vNodes.size()));
+                vChildren.push_back(vNodes.size());
+                vNodes.push_back(n[c]);
             }
-        }       
+        }
+
+        // Children are pushed to the front of the list, in reverse order
+        vOrder.assign(vChildren.rbegin(),vChildren.rend());
+        vOrder.insert(vOrder.end(),vKept.begin(),vKept.end());
+
+        const int nToExpand = vSizeAndNode.size();
 
         // Finish if there are more nodes than required features
         // or all nodes contain just one point
-        if((int)lNodes.size()>=N || (int)lNodes.size()==prevSize)
+        if((int)vOrder.size()>=N || (int)vOrder.size()==prevSize)
         {
             bFinish = true;
         }
-        else if(((int)lNodes.size()+nToExpand*3)>N)
+        else if(((int)vOrder.size()+nToExpand*3)>N)
         {
+            // Subdivide the largest nodes first until reaching N nodes. Nodes are now
+            // added and removed anywhere in the list, so keep its order as keys.
+            for(size_t i=0; i<vOrder.size(); i++)
+                vNodes[vOrder[i]].order = i;
+            int nFront = 0;
+            int nNodes = vOrder.size();
+            const int nFirstNew = vNodes.size();
+
+            vector<pair<int,int> > vPrevSizeAndNode;
 
             while(!bFinish)
             {
+                const int prevNodes = nNodes;
 
-                prevSize = lNodes.size();
+                vPrevSizeAndNode.swap(vSizeAndNode);
+                vSizeAndNode.clear();
 
-                vector<pair<int,ExtractorNode*> > vPrevSizeAndPointerToNode = vSizeAndPointerToNode;
-                vSizeAndPointerToNode.clear();
-
-                sort(vPrevSizeAndPointerToNode.begin(),vPrevSizeAndPointerToNode.end());
-                for(int j=vPrevSizeAndPointerToNode.size()-1;j>=0;j--)
+                // Ties are broken by creation order, latest first
+                sort(vPrevSizeAndNode.begin(),vPrevSizeAndNode.end());
+                for(int j=vPrevSizeAndNode.size()-1;j>=0;j--)
                 {
-                    ExtractorNode n1,n2,n3,n4;
-                    vPrevSizeAndPointerToNode[j].second->DivideNode(n1,n2,n3,n4);
+                    const int idx = vPrevSizeAndNode[j].second;
+                    ExtractorNode n[4];
+                    vNodes[idx].DivideNode(n[0],n[1],n[2],n[3],pKeys,&vKeyIdx[0],&vScratch[0]);
+                    vNodes[idx].bDivided = true;
+                    nNodes--;
 
-                    // Add childs if they contain points
-                    if(n1.vKeys.size()>0)
-                    {
-                        lNodes.push_front(n1);
-                        if(n1.vKeys.size()>1)
-                        {
-                            vSizeAndPointerToNode.push_back(make_pair(n1.vKeys.size(),&lNodes.front()));
-                            lNodes.front().lit = lNodes.begin();
-                        }
-                    }
-                    if(n2.vKeys.size()>0)
-                    {
-                        lNodes.push_front(n2);
-                        if(n2.vKeys.size()>1)
-                        {
-                            vSizeAndPointerToNode.push_back(make_pair(n2.vKeys.size(),&lNodes.front()));
-                            lNodes.front().lit = lNodes.begin();
-                        }
-                    }
-                    if(n3.vKeys.size()>0)
-                    {
-                        lNodes.push_front(n3);
-                        if(n3.vKeys.size()>1)
-                        {
-                            vSizeAndPointerToNode.push_back(make_pair(n3.vKeys.size(),&lNodes.front()));
-                            lNodes.front().lit = lNodes.begin();
-                        }
-                    }
-                    if(n4.vKeys.size()>0)
+                    for(int c=0; c<4; c++)
                     {
-                        lNodes.push_front(n4);
-                        if(n4.vKeys.size()>1)
-                        {
-                            vSizeAndPointerToNode.push_back(make_pair(n4.vKeys.size(),&lNodes.front()));
-                            lNodes.front().lit = lNodes.begin();
-                        }
+                        if(n[c].Size()==0)
+                            continue;
+                        if(n[c].Size()>1)
+                            vSizeAndNode.push_back(make_pair(n[c].Size(),(int)vNodes.size()));
+                        n[c].order = --nFront;
+                        vNodes.push_back(n[c]);
+                        nNodes++;
                     }
 
-                    lNodes.erase(vPrevSizeAndPointerToNode[j].second->lit);
-
-                    if((int)lNodes.size()>=N)
+                    if(nNodes>=N)
                         break;
                 }
 
-                if((int)lNodes.size()>=N || (int)lNodes.size()==prevSize)
+                if(nNodes>=N || nNodes==prevNodes)
                     bFinish = true;
+            }
 
+            // Remaining nodes in list order
+            vector<pair<int,int> > vOrderAndNode;
+            vOrderAndNode.reserve(nNodes);
+            for(size_t i=0; i<vOrder.size(); i++)
+            {
+                if(!vNodes[vOrder[i]].bDivided)
+                    vOrderAndNode.push_back(make_pair(vNodes[vOrder[i]].order,vOrder[i]));
             }
+            for(int i=nFirstNew; i<(int)vNodes.size(); i++)
+            {
+                if(!vNodes[i].bDivided)
+                    vOrderAndNode.push_back(make_pair(vNodes[i].order,i));
+            }
+            sort(vOrderAndNode.begin(),vOrderAndNode.end());
+
+            vOrder.resize(vOrderAndNode.size());
+            for(size_t i=0; i<vOrderAndNode.size(); i++)
+                vOrder[i] = vOrderAndNode[i].second;
         }
     }
 
     // Retain the best point in each node
     vector<cv::KeyPoint> vResultKeys;
     vResultKeys.reserve(nfeatures);
-    for(list<ExtractorNode>::iterator lit=lNodes.begin(); lit!=lNodes.end(); lit++)
+    for(size_t i=0; i<vOrder.size(); i++)
     {
-        vector<cv::KeyPoint> &vNodeKeys = lit->vKeys;
-        cv::KeyPoint* pKP = &vNodeKeys[0];
+        const ExtractorNode &node = vNodes[vOrder[i]];
+        const cv::KeyPoint* pKP = &pKeys[vKeyIdx[node.begin]];
         float maxResponse = pKP->response;
 
-        for(size_t k=1;k<vNodeKeys.size();k++)
+        for(int k=node.begin+1;k<node.end;k++)
         {
-            if(vNodeKeys[k].response>maxResponse)
+            const cv::KeyPoint &kp = pKeys[vKeyIdx[k]];
+            if(kp.response>maxResponse)
             {
-                pKP = &vNodeKeys[k];
-                maxResponse = vNodeKeys[k].response;
+                pKP = &kp;
+                maxResponse = kp.response;
             }
         }
 
@@ -766,90 +1029,84 @@ void ORBextractor::ComputeKeyPointsOctTree(vector<vector<KeyPoint> >& allKeypoin
 {
     allKeypoints.resize(nlevels);
 
-    const float W = 30;
-
     for (int level = 0; level < nlevels; ++level)
-    {
-        const int minBorderX = EDGE_THRESHOLD-3;
-        const int minBorderY = minBorderX;
-        const int maxBorderX = mvImagePyramid[level].cols-EDGE_THRESHOLD+3;
-        const int maxBorderY = mvImagePyramid[level].rows-EDGE_THRESHOLD+3;
+        ComputeKeyPointsOctTree(level, allKeypoints[level]);
+}
 
-        vector<cv::KeyPoint> vToDistributeKeys;
-        vToDistributeKeys.reserve(nfeatures*10);
+void ORBextractor::ComputeKeyPointsOctTree(const int level, vector<KeyPoint>& keypoints)
+{
+    const float W = 30;
 
-        const float width = (maxBorderX-minBorderX);
-        const float height = (maxBorderY-minBorderY);
+    const int minBorderX = EDGE_THRESHOLD-3;
+    const int minBorderY = minBorderX;
+    const int maxBorderX = mvImagePyramid[level].cols-EDGE_THRESHOLD+3;
+    const int maxBorderY = mvImagePyramid[level].rows-EDGE_THRESHOLD+3;
 
-        const int nCols = width/W;
-        const int nRows = height/W;
-        const int wCell = ceil(width/nCols);
-        const int hCell = ceil(height/nRows);
+    vector<cv::KeyPoint> vToDistributeKeys;
+    vToDistributeKeys.reserve(nfeatures*10);
 
-        for(int i=0; i<nRows; i++)
-        {
-            const float iniY =minBorderY+i*hCell;
-            float maxY = iniY+hCell+6;
+    const float width = (maxBorderX-minBorderX);
+    const float height = (maxBorderY-minBorderY);
 
-            if(iniY>=maxBorderY-3)
-                continue;
-            if(maxY>maxBorderY)
-                maxY = maxBorderY;
+    const int nCols = width/W;
+    const int nRows = height/W;
+    const int wCell = ceil(width/nCols);
+    const int hCell = ceil(height/nRows);
 
-            for(int j=0; j<nCols; j++)
-            {
-                const float iniX =minBorderX+j*wCell;
-                float maxX = iniX+wCell+6;
-                if(iniX>=maxBorderX-6)
-                    continue;
-                if(maxX>maxBorderX)
-                    maxX = maxBorderX;
+    // Score the whole level once, cells only threshold and suppress non-maxima
+    const Mat &image = mvImagePyramid[level];
+    Mat &scores = mvFastScores[level];
+    scores.create(image.size(),CV_8U);
+    computeFastScores(image.ptr<uchar>(),image.step,scores.ptr<uchar>(),scores.step,
+                      minBorderX+3,minBorderY+3,maxBorderX-3,maxBorderY-3,min(iniThFAST,minThFAST));
 
-                vector<cv::KeyPoint> vKeysCell;
-                FAST(mvImagePyramid[level].rowRange(iniY,maxY).colRange(iniX,maxX),
-                     vKeysCell,iniThFAST,true);
+    for(int i=0; i<nRows; i++)
+    {
+        const float iniY =minBorderY+i*hCell;
+        float maxY = iniY+hCell+6;
 
-                if(vKeysCell.empty())
-                {
-                    FAST(mvImagePyramid[level].rowRange(iniY,maxY).colRange(iniX,maxX),
-                         vKeysCell,minThFAST,true);
-                }
+        if(iniY>=maxBorderY-3)
+            continue;
+        if(maxY>maxBorderY)
+            maxY = maxBorderY;
 
-                if(!vKeysCell.empty())
-                {
-                    for(vector<cv::KeyPoint>::iterator vit=vKeysCell.begin(); vit!=vKeysCell.end();vit++)
-                    {
-                        (*vit).pt.x+=j*wCell;
-                        (*vit).pt.y+=i*hCell;
-                        vToDistributeKeys.push_back(*vit);
-                    }
-                }
+        for(int j=0; j<nCols; j++)
+        {
+            const float iniX =minBorderX+j*wCell;
+            float maxX = iniX+wCell+6;
+            if(iniX>=maxBorderX-6)
+                continue;
+            if(maxX>maxBorderX)
+                maxX = maxBorderX;
 
+            // Same keypoints as FAST on the cell window, relative to the border
+            if(!detectFastInWindow(scores.ptr<uchar>(),scores.step,iniX,iniY,maxX,maxY,
+                                   iniThFAST,minBorderX,minBorderY,vToDistributeKeys))
+            {
+                detectFastInWindow(scores.ptr<uchar>(),scores.step,iniX,iniY,maxX,maxY,
+                                   minThFAST,minBorderX,minBorderY,vToDistributeKeys);
             }
-        }
 
-        vector<KeyPoint> & keypoints = allKeypoints[level];
-        keypoints.reserve(nfeatures);
+        }
+    }
 
-        keypoints = DistributeOctTree(vToDistributeKeys, minBorderX, maxBorderX,
-                                      minBorderY, maxBorderY,mnFeaturesPerLevel[level], level);
+    keypoints = DistributeKeyPoints(vToDistributeKeys, minBorderX, maxBorderX,
+                                    minBorderY, maxBorderY,mnFeaturesPerLevel[level], level);
 
-        const int scaledPatchSize = PATCH_SIZE*mvScaleFactor[level];
+    const int scaledPatchSize = PATCH_SIZE*mvScaleFactor[level];
 
-        // Add border to coordinates and scale information
-        const int nkps = keypoints.size();
-        for(int i=0; i<nkps ; i++)
-        {
-            keypoints[i].pt.x+=minBorderX;
-            keypoints[i].pt.y+=minBorderY;
-            keypoints[i].octave=level;
-            keypoints[i].size = scaledPatchSize;
-        }
+    // Add border to coordinates and scale information
+    const int nkps = keypoints.size();
+    for(int i=0; i<nkps ; i++)
+    {
+        keypoints[i].pt.x+=minBorderX;
+        keypoints[i].pt.y+=minBorderY;
+        keypoints[i].octave=level;
+        keypoints[i].size = scaledPatchSize;
     }
 
     // compute orientations
-    for (int level = 0; level < nlevels; ++level)
-        computeOrientation(mvImagePyramid[level], allKeypoints[level], umax);
+    computeOrientation(mvImagePyramid[level], keypoints, umax);
 }
 
 void ORBextractor::ComputeKeyPointsOld(std::vector<std::vector<KeyPoint> > &allKeypoints)
@@ -1036,8 +1293,67 @@ static void computeDescriptors(const Mat& image, vector<KeyPoint>& keypoints, Ma
 {
     descriptors = Mat::zeros((int)keypoints.size(), 32, CV_8UC1);
 
+#ifdef __AVX2__
+    // Pattern coordinates as floats, shared by all keypoints of the level
+    alignas(32) float px[512], py[512];
+    for (int i = 0; i < 512; i++)
+    {
+        px[i] = (float)pattern[i].x;
+        py[i] = (float)pattern[i].y;
+    }
+
+    const int step = (int)image.step;
+    for (size_t i = 0; i < keypoints.size(); i++)
+    {
+        const KeyPoint& kpt = keypoints[i];
+        const float angle = (float)kpt.angle*factorPI;
+        const float a = (float)cos(angle), b = (float)sin(angle);
+        computeOrbDescriptor(&image.at<uchar>(cvRound(kpt.pt.y), cvRound(kpt.pt.x)), step, a, b,
+                             px, py, descriptors.ptr((int)i));
+    }
+#else
     for (size_t i = 0; i < keypoints.size(); i++)
         computeOrbDescriptor(keypoints[i], image, &pattern[0], descriptors.ptr((int)i));
+#endif
+}
+
+void ORBextractor::ComputeFeaturesPerLevel()
+{
+    mnFeaturesPerLevel.resize(nlevels);
+    float factor = 1.0f / scaleFactor;
+    float nDesiredFeaturesPerScale = nfeatures*(1 - factor)/(1 - (float)pow((double)factor, (double)nlevels));
+
+    int sumFeatures = 0;
+    for( int level = 0; level < nlevels-1; level++ )
+    {
+        mnFeaturesPerLevel[level] = cvRound(nDesiredFeaturesPerScale);
+        sumFeatures += mnFeaturesPerLevel[level];
+        nDesiredFeaturesPerScale *= factor;
+    }
+    mnFeaturesPerLevel[nlevels-1] = std::max(nfeatures - sumFeatures, 0);
+}
+
+void ORBextractor::SetFeatureBudget(int _nfeatures, int _iniThFAST, int _minThFAST)
+{
+    unique_lock<mutex> lock(mMutexBudget);
+    mnRequestedFeatures = _nfeatures;
+    mnRequestedIniThFAST = _iniThFAST;
+    mnRequestedMinThFAST = _minThFAST;
+    mbBudgetRequested = true;
+}
+
+void ORBextractor::ApplyFeatureBudget()
+{
+    unique_lock<mutex> lock(mMutexBudget);
+    if(!mbBudgetRequested)
+        return;
+
+    nfeatures = mnRequestedFeatures;
+    iniThFAST = mnRequestedIniThFAST;
+    minThFAST = mnRequestedMinThFAST;
+    mbBudgetRequested = false;
+
+    ComputeFeaturesPerLevel();
 }
 
 void ORBextractor::operator()( InputArray _image, InputArray _mask, vector<KeyPoint>& _keypoints,
@@ -1049,59 +1365,110 @@ void ORBextractor::operator()( InputArray _image, InputArray _mask, vector<KeyPo
     Mat image = _image.getMat();
     assert(image.type() == CV_8UC1 );
 
+    BeginExtraction(image);
+
+    ForEachLevel([&](int level)
+    {
+        DetectLevel(level);
+    });
+
+    AllocateDescriptors(_descriptors);
+
+    ForEachLevel([&](int level)
+    {
+        DescribeLevel(level);
+    });
+
+    EndExtraction(_keypoints);
+}
+
+void ORBextractor::BeginExtraction(const cv::Mat &image)
+{
+    ApplyFeatureBudget();
+
     // Pre-compute the scale pyramid
     ComputePyramid(image);
 
-    vector < vector<KeyPoint> > allKeypoints;
-    ComputeKeyPointsOctTree(allKeypoints);
+    mvAllKeypoints.resize(nlevels);
+}
+
+void ORBextractor::DetectLevel(int level)
+{
+    // Levels are independent once the pyramid is built. Keypoints, orientations
+    // and the blurred images are computed level by level, optionally in parallel.
+    ComputeKeyPointsOctTree(level, mvAllKeypoints[level]);
     //ComputeKeyPointsOld(allKeypoints);
 
-    Mat descriptors;
+    if(mvAllKeypoints[level].empty() || !mbBlurLevels)
+        return;
+
+    // preprocess the resized image (isolated, as if the level was a standalone image)
+    GaussianBlur(mvImagePyramid[level], mvBlurredPyramid[level], Size(7, 7), 2, 2,
+                 BORDER_REFLECT_101+BORDER_ISOLATED);
+}
 
+void ORBextractor::AllocateDescriptors(OutputArray _descriptors)
+{
     int nkeypoints = 0;
     for (int level = 0; level < nlevels; ++level)
-        nkeypoints += (int)allKeypoints[level].size();
+        nkeypoints += (int)mvAllKeypoints[level].size();
     if( nkeypoints == 0 )
+    {
         _descriptors.release();
+        mDescriptorsOut.release();
+    }
     else
     {
-        _descriptors.create(nkeypoints, 32, CV_8U);
-        descriptors = _descriptors.getMat();
+        // Descriptors are stored in one contiguous, 32-byte aligned block
+        if(_descriptors.kind() == _InputArray::MAT)
+            _descriptors.getMatRef() = DescriptorStore::Allocate(nkeypoints);
+        else
+            _descriptors.create(nkeypoints, 32, CV_8U);
+        mDescriptorsOut = _descriptors.getMat();
     }
 
-    _keypoints.clear();
-    _keypoints.reserve(nkeypoints);
+    // Each level writes its own block of descriptor rows
+    mvDescriptorOffsets.assign(nlevels,0);
+    for (int level = 1; level < nlevels; ++level)
+        mvDescriptorOffsets[level] = mvDescriptorOffsets[level-1] + (int)mvAllKeypoints[level-1].size();
+}
 
-    int offset = 0;
-    for (int level = 0; level < nlevels; ++level)
-    {
-        vector<KeyPoint>& keypoints = allKeypoints[level];
-        int nkeypointsLevel = (int)keypoints.size();
+void ORBextractor::DescribeLevel(int level)
+{
+    vector<KeyPoint>& keypoints = mvAllKeypoints[level];
+    int nkeypointsLevel = (int)keypoints.size();
 
-        if(nkeypointsLevel==0)
-            continue;
+    if(nkeypointsLevel==0)
+        return;
 
-        // preprocess the resized image
-        Mat workingMat = mvImagePyramid[level].clone();
-        GaussianBlur(workingMat, workingMat, Size(7, 7), 2, 2, BORDER_REFLECT_101);
+    // Compute the descriptors
+    Mat desc = mDescriptorsOut.rowRange(mvDescriptorOffsets[level], mvDescriptorOffsets[level] + nkeypointsLevel);
+    computeDescriptors(mbBlurLevels ? mvBlurredPyramid[level] : mvImagePyramid[level], keypoints, desc, pattern);
 
-        // Compute the descriptors
-        Mat desc = descriptors.rowRange(offset, offset + nkeypointsLevel);
-        computeDescriptors(workingMat, keypoints, desc, pattern);
+    // Scale keypoint coordinates
+    if (level != 0)
+    {
+        float scale = mvScaleFactor[level]; //getScale(level, firstLevel, scaleFactor);
+        for (vector<KeyPoint>::iterator keypoint = keypoints.begin(),
+             keypointEnd = keypoints.end(); keypoint != keypointEnd; ++keypoint)
+            keypoint->pt *= scale;
+    }
+}
 
-        offset += nkeypointsLevel;
+void ORBextractor::EndExtraction(vector<KeyPoint> &_keypoints)
+{
+    // The output owns the descriptors
+    mDescriptorsOut.release();
 
-        // Scale keypoint coordinates
-        if (level != 0)
-        {
-            float scale = mvScaleFactor[level]; //getScale(level, firstLevel, scaleFactor);
-            for (vector<KeyPoint>::iterator keypoint = keypoints.begin(),
-                 keypointEnd = keypoints.end(); keypoint != keypointEnd; ++keypoint)
-                keypoint->pt *= scale;
-        }
-        // And add the keypoints to the output
-        _keypoints.insert(_keypoints.end(), keypoints.begin(), keypoints.end());
-    }
+    // And add the keypoints to the output
+    int nkeypoints = 0;
+    for (int level = 0; level < nlevels; ++level)
+        nkeypoints += (int)mvAllKeypoints[level].size();
+
+    _keypoints.clear();
+    _keypoints.reserve(nkeypoints);
+    for (int level = 0; level < nlevels; ++level)
+        _keypoints.insert(_keypoints.end(), mvAllKeypoints[level].begin(), mvAllKeypoints[level].end());
 }
 
 void ORBextractor::ComputePyramid(cv::Mat image)
@@ -1111,10 +1478,16 @@ void ORBextractor::ComputePyramid(cv::Mat image)
         float scale = mvInvScaleFactor[level];
         Size sz(cvRound((float)image.cols*scale), cvRound((float)image.rows*scale));
         Size wholeSize(sz.width + EDGE_THRESHOLD*2, sz.height + EDGE_THRESHOLD*2);
-        Mat temp(wholeSize, image.type()), masktemp;
-        mvImagePyramid[level] = temp(Rect(EDGE_THRESHOLD, EDGE_THRESHOLD, sz.width, sz.height));
 
-        // Compute the resized image
+        // Bordered buffers persist across frames, they are only reallocated if the image size changes
+        Mat &temp = mvPyramidBuffers[level];
+        if(temp.size()!=wholeSize || temp.type()!=image.type())
+        {
+            temp.create(wholeSize, image.type());
+            mvImagePyramid[level] = temp(Rect(EDGE_THRESHOLD, EDGE_THRESHOLD, sz.width, sz.height));
+        }
+
+        // Compute the resized image directly inside the bordered buffer and reflect the border in place
         if( level != 0 )
         {
             resize(mvImagePyramid[level-1], mvImagePyramid[level], sz, 0, 0, INTER_LINEAR);
@@ -27,6 +27,9 @@
 
 #include "Thirdparty/DBoW2/DBoW2/FeatureVector.h"
 
+#include "HammingDistance.h"
+#include "ThreadPool.h"
+
 #include<stdint-gcc.h>
 
 using namespace std;
@@ -42,15 +45,81 @@ ORBmatcher::ORBmatcher(float nnratio, bool checkOri): mfNNratio(nnratio), mbChec
 {
 }
 
-int ORBmatcher::SearchByProjection(Frame &F, const vector<MapPoint*> &vpMapPoints, const float th)
+int ORBmatcher::SearchByProjection(Frame &F, const vector<MapPoint*> &vpMapPoints, const vector<const unsigned char*> &vpDescriptors,
+                                   const vector<int> &vCells, const float th, ThreadPool* pThreadPool)
 {
     int nmatches=0;
 
-    const bool bFactor = th!=1.0;
+    const int nMPs = vpMapPoints.size();
+    if(nMPs==0)
+        return 0;
+
+    // Points of a cell are consecutive
+    vector<int> vCellStart;
+    for(int iMP=0; iMP<nMPs; iMP++)
+        if(iMP==0 || vCells[iMP]!=vCells[iMP-1])
+            vCellStart.push_back(iMP);
+    vCellStart.push_back(nMPs);
+    const int nCells = vCellStart.size()-1;
+
+    // Search every point against the keypoints free before the search, cell by cell
+    vector<ProjectionMatch> vMatches(nMPs);
+    const function<void(int)> searchCell = [&](int c)
+    {
+        FindProjectionMatches(F,vpMapPoints,vpDescriptors,vCellStart[c],vCellStart[c+1],th,&vMatches[0]);
+    };
+
+    if(pThreadPool && pThreadPool->GetNumThreads()>1)
+        pThreadPool->ParallelFor(nCells,searchCell);
+    else
+    {
+        for(int c=0; c<nCells; c++)
+            searchCell(c);
+    }
+
+    // Keypoints matched in this search
+    vector<unsigned char> vbTaken(F.N,0);
+    vector<int> vDistances;
 
-    for(size_t iMP=0; iMP<vpMapPoints.size(); iMP++)
+    for(int iMP=0; iMP<nMPs; iMP++)
     {
         MapPoint* pMP = vpMapPoints[iMP];
+
+        // If a previous point took the best or second keypoint, search again
+        ProjectionMatch &match = vMatches[iMP];
+        if(match.bestIdx>=0 && (vbTaken[match.bestIdx] || (match.bestIdx2>=0 && vbTaken[match.bestIdx2])))
+            FindProjectionMatch(F,pMP,vpDescriptors[iMP],th,vDistances,match);
+
+        // Apply ratio to second match (only if best and second are in the same scale level)
+        if(match.bestDist<=TH_HIGH)
+        {
+            if(match.bestLevel==match.bestLevel2 && match.bestDist>mfNNratio*match.bestDist2)
+                continue;
+
+            F.mvpMapPoints[match.bestIdx]=pMP;
+            vbTaken[match.bestIdx]=1;
+            nmatches++;
+        }
+    }
+
+    return nmatches;
+}
+
+void ORBmatcher::FindProjectionMatches(const Frame &F, const vector<MapPoint*> &vpMapPoints,
+                                       const vector<const unsigned char*> &vpDescriptors, const int i0, const int i1,
+                                       const float th, ProjectionMatch* pMatches)
+{
+    // Search radius of each point (negative if it is not searched) and union of the windows
+    vector<float> vRadius(i1-i0,-1.0f);
+    float minX=0, maxX=0, minY=0, maxY=0;
+    int minLevel=0, maxLevel=0;
+    bool bFirst = true;
+
+    for(int i=i0; i<i1; i++)
+    {
+        pMatches[i] = ProjectionMatch();
+
+        MapPoint* pMP = vpMapPoints[i];
         if(!pMP->mbTrackInView)
             continue;
 
@@ -62,70 +131,151 @@ int ORBmatcher::SearchByProjection(Frame &F, const vector<MapPoint*> &vpMapPoint
         // The size of the window will depend on the viewing direction
         float r = RadiusByViewingCos(pMP->mTrackViewCos);
 
-        if(bFactor)
+        if(th!=1.0)
             r*=th;
 
-        const vector<size_t> vIndices =
-                F.GetFeaturesInArea(pMP->mTrackProjX,pMP->mTrackProjY,r*F.mvScaleFactors[nPredictedLevel],nPredictedLevel-1,nPredictedLevel);
+        r*=F.mvScaleFactors[nPredictedLevel];
+        vRadius[i-i0] = r;
+
+        if(bFirst)
+        {
+            minX = pMP->mTrackProjX-r;
+            maxX = pMP->mTrackProjX+r;
+            minY = pMP->mTrackProjY-r;
+            maxY = pMP->mTrackProjY+r;
+            minLevel = nPredictedLevel-1;
+            maxLevel = nPredictedLevel;
+            bFirst = false;
+        }
+        else
+        {
+            minX = min(minX,pMP->mTrackProjX-r);
+            maxX = max(maxX,pMP->mTrackProjX+r);
+            minY = min(minY,pMP->mTrackProjY-r);
+            maxY = max(maxY,pMP->mTrackProjY+r);
+            minLevel = min(minLevel,nPredictedLevel-1);
+            maxLevel = max(maxLevel,nPredictedLevel);
+        }
+    }
+
+    if(bFirst)
+        return;
+
+    // Keypoints around the cell, gathered once for all its points. The window has a margin of
+    // one pixel, the exact window of each point is tested below.
+    const float R = 0.5f*max(maxX-minX,maxY-minY)+1.0f;
+    const vector<size_t> vCandidates = F.GetFeaturesInArea(0.5f*(minX+maxX),0.5f*(minY+maxY),R,minLevel,maxLevel);
+
+    if(vCandidates.empty())
+        return;
+
+    // Same keypoints, in the same order, as Frame::GetFeaturesInArea on the window of the point
+    vector<size_t> vIndices;
+    vIndices.reserve(vCandidates.size());
+    vector<int> vDistances;
+
+    for(int i=i0; i<i1; i++)
+    {
+        const float r = vRadius[i-i0];
+        if(r<0)
+            continue;
+
+        MapPoint* pMP = vpMapPoints[i];
+        const float x = pMP->mTrackProjX;
+        const float y = pMP->mTrackProjY;
+        const int nPredictedLevel = pMP->mnTrackScaleLevel;
+
+        vIndices.clear();
+        for(size_t k=0, kend=vCandidates.size(); k<kend; k++)
+        {
+            const size_t idx = vCandidates[k];
+            const cv::KeyPoint &kpUn = F.mvKeysUn[idx];
+            if(kpUn.octave<nPredictedLevel-1 || kpUn.octave>nPredictedLevel)
+                continue;
+
+            if(fabs(kpUn.pt.x-x)<r && fabs(kpUn.pt.y-y)<r)
+                vIndices.push_back(idx);
+        }
 
         if(vIndices.empty())
             continue;
 
-        const cv::Mat MPdescriptor = pMP->GetDescriptor();
+        ScoreProjectionCandidates(F,pMP,vpDescriptors[i],r,vIndices,vDistances,pMatches[i]);
+    }
+}
 
-        int bestDist=256;
-        int bestLevel= -1;
-        int bestDist2=256;
-        int bestLevel2 = -1;
-        int bestIdx =-1 ;
+void ORBmatcher::FindProjectionMatch(const Frame &F, MapPoint* pMP, const unsigned char* pDescriptor, const float th,
+                                     vector<int> &vDistances, ProjectionMatch &match)
+{
+    match = ProjectionMatch();
 
-        // Get best and second matches with near keypoints
-        for(vector<size_t>::const_iterator vit=vIndices.begin(), vend=vIndices.end(); vit!=vend; vit++)
-        {
-            const size_t idx = *vit;
+    if(!pMP->mbTrackInView)
+        return;
 
-            if(F.mvpMapPoints[idx])
-                if(F.mvpMapPoints[idx]->Observations()>0)
-                    continue;
+    if(pMP->isBad())
+        return;
 
-            if(F.mvuRight[idx]>0)
-            {
-                const float er = fabs(pMP->mTrackProjXR-F.mvuRight[idx]);
-                if(er>r*F.mvScaleFactors[nPredictedLevel])
-                    continue;
-            }
+    const int &nPredictedLevel = pMP->mnTrackScaleLevel;
 
-            const cv::Mat &d = F.mDescriptors.row(idx);
+    // The size of the window will depend on the viewing direction
+    float r = RadiusByViewingCos(pMP->mTrackViewCos);
 
-            const int dist = DescriptorDistance(MPdescriptor,d);
+    if(th!=1.0)
+        r*=th;
 
-            if(dist<bestDist)
-            {
-                bestDist2=bestDist;
-                bestDist=dist;
-                bestLevel2 = bestLevel;
-                bestLevel = F.mvKeysUn[idx].octave;
-                bestIdx=idx;
-            }
-            else if(dist<bestDist2)
-            {
-                bestLevel2 = F.mvKeysUn[idx].octave;
-                bestDist2=dist;
-            }
-        }
+    r*=F.mvScaleFactors[nPredictedLevel];
 
-        // Apply ratio to second match (only if best and second are in the same scale level)
-        if(bestDist<=TH_HIGH)
+    const vector<size_t> vIndices =
+            F.GetFeaturesInArea(pMP->mTrackProjX,pMP->mTrackProjY,r,nPredictedLevel-1,nPredictedLevel);
+
+    if(vIndices.empty())
+        return;
+
+    ScoreProjectionCandidates(F,pMP,pDescriptor,r,vIndices,vDistances,match);
+}
+
+void ORBmatcher::ScoreProjectionCandidates(const Frame &F, MapPoint* pMP, const unsigned char* pDescriptor, const float r,
+                                           const vector<size_t> &vIndices, vector<int> &vDistances, ProjectionMatch &match)
+{
+    if(vDistances.size()<vIndices.size())
+        vDistances.resize(vIndices.size());
+    HammingDistance::ComputeOneToMany(pDescriptor,F.mDescriptors.ptr<uchar>(),F.mDescriptors.step[0],
+                                      &vIndices[0],vIndices.size(),&vDistances[0]);
+
+    // Get best and second matches with near keypoints
+    for(size_t k=0, kend=vIndices.size(); k<kend; k++)
+    {
+        const size_t idx = vIndices[k];
+
+        if(F.mvpMapPoints[idx])
+            if(F.mvpMapPoints[idx]->Observations()>0)
+                continue;
+
+        if(F.mvuRight[idx]>0)
         {
-            if(bestLevel==bestLevel2 && bestDist>mfNNratio*bestDist2)
+            const float er = fabs(pMP->mTrackProjXR-F.mvuRight[idx]);
+            if(er>r)
                 continue;
+        }
 
-            F.mvpMapPoints[bestIdx]=pMP;
-            nmatches++;
+        const int dist = vDistances[k];
+
+        if(dist<match.bestDist)
+        {
+            match.bestDist2=match.bestDist;
+            match.bestDist=dist;
+            match.bestLevel2 = match.bestLevel;
+            match.bestLevel = F.mvKeysUn[idx].octave;
+            match.bestIdx2 = match.bestIdx;
+            match.bestIdx=idx;
+        }
+        else if(dist<match.bestDist2)
+        {
+            match.bestLevel2 = F.mvKeysUn[idx].octave;
+            match.bestDist2=dist;
+            match.bestIdx2=idx;
         }
     }
-
-    return nmatches;
 }
 
 float ORBmatcher::RadiusByViewingCos(const float &viewCos)
@@ -181,8 +331,8 @@ int ORBmatcher::SearchByBoW(KeyFrame* pKF,Frame &F, vector<MapPoint*> &vpMapPoin
     {
         if(KFit->first == Fit->first)
         {
-            const vector<unsigned int> vIndicesKF = KFit->second;
-            const vector<unsigned int> vIndicesF = Fit->second;
+            const vector<unsigned int> &vIndicesKF = KFit->second;
+            const vector<unsigned int> &vIndicesF = Fit->second;
 
             for(size_t iKF=0; iKF<vIndicesKF.size(); iKF++)
             {
@@ -196,7 +346,7 @@ int ORBmatcher::SearchByBoW(KeyFrame* pKF,Frame &F, vector<MapPoint*> &vpMapPoin
                 if(pMP->isBad())
                     continue;                
 
-                const cv::Mat &dKF= pKF->mDescriptors.row(realIdxKF);
+                const int* pDists = ComputeDistances(pKF->mDescriptors.ptr<uchar>(realIdxKF),F.mDescriptors,vIndicesF);
 
                 int bestDist1=256;
                 int bestIdxF =-1 ;
@@ -209,9 +359,7 @@ int ORBmatcher::SearchByBoW(KeyFrame* pKF,Frame &F, vector<MapPoint*> &vpMapPoin
                     if(vpMapPointMatches[realIdxF])
                         continue;
 
-                    const cv::Mat &dF = F.mDescriptors.row(realIdxF);
-
-                    const int dist =  DescriptorDistance(dKF,dF);
+                    const int dist = pDists[iF];
 
                     if(dist<bestDist1)
                     {
@@ -365,13 +513,16 @@ int ORBmatcher::SearchByProjection(KeyFrame* pKF, cv::Mat Scw, const vector<MapP
             continue;
 
         // Match to the most similar keypoint in the radius
-        const cv::Mat dMP = pMP->GetDescriptor();
+        alignas(32) unsigned char dMP[DescriptorStore::DESCRIPTOR_BYTES];
+        pMP->GetDescriptor(dMP);
+
+        const int* pDists = ComputeDistances(dMP,pKF->mDescriptors,vIndices);
 
         int bestDist = 256;
         int bestIdx = -1;
-        for(vector<size_t>::const_iterator vit=vIndices.begin(), vend=vIndices.end(); vit!=vend; vit++)
+        for(size_t k=0, kend=vIndices.size(); k<kend; k++)
         {
-            const size_t idx = *vit;
+            const size_t idx = vIndices[k];
             if(vpMatched[idx])
                 continue;
 
@@ -380,9 +531,7 @@ int ORBmatcher::SearchByProjection(KeyFrame* pKF, cv::Mat Scw, const vector<MapP
             if(kpLevel<nPredictedLevel-1 || kpLevel>nPredictedLevel)
                 continue;
 
-            const cv::Mat &dKF = pKF->mDescriptors.row(idx);
-
-            const int dist = DescriptorDistance(dMP,dKF);
+            const int dist = pDists[k];
 
             if(dist<bestDist)
             {
@@ -427,19 +576,17 @@ int ORBmatcher::SearchForInitialization(Frame &F1, Frame &F2, vector<cv::Point2f
         if(vIndices2.empty())
             continue;
 
-        cv::Mat d1 = F1.mDescriptors.row(i1);
+        const int* pDists = ComputeDistances(F1.mDescriptors.ptr<uchar>(i1),F2.mDescriptors,vIndices2);
 
         int bestDist = INT_MAX;
         int bestDist2 = INT_MAX;
         int bestIdx2 = -1;
 
-        for(vector<size_t>::iterator vit=vIndices2.begin(); vit!=vIndices2.end(); vit++)
+        for(size_t k=0, kend=vIndices2.size(); k<kend; k++)
         {
-            size_t i2 = *vit;
+            size_t i2 = vIndices2[k];
 
-            cv::Mat d2 = F2.mDescriptors.row(i2);
-
-            int dist = DescriptorDistance(d1,d2);
+            int dist = pDists[k];
 
             if(vMatchedDistance[i2]<=dist)
                 continue;
@@ -561,7 +708,7 @@ int ORBmatcher::SearchByBoW(KeyFrame *pKF1, KeyFrame *pKF2, vector<MapPoint *> &
                 if(pMP1->isBad())
                     continue;
 
-                const cv::Mat &d1 = Descriptors1.row(idx1);
+                const int* pDists = ComputeDistances(Descriptors1.ptr<uchar>(idx1),Descriptors2,f2it->second);
 
                 int bestDist1=256;
                 int bestIdx2 =-1 ;
@@ -579,9 +726,7 @@ int ORBmatcher::SearchByBoW(KeyFrame *pKF1, KeyFrame *pKF2, vector<MapPoint *> &
                     if(pMP2->isBad())
                         continue;
 
-                    const cv::Mat &d2 = Descriptors2.row(idx2);
-
-                    int dist = DescriptorDistance(d1,d2);
+                    int dist = pDists[i2];
 
                     if(dist<bestDist1)
                     {
@@ -710,7 +855,7 @@ int ORBmatcher::SearchForTriangulation(KeyFrame *pKF1, KeyFrame *pKF2, cv::Mat F
                 
                 const cv::KeyPoint &kp1 = pKF1->mvKeysUn[idx1];
                 
-                const cv::Mat &d1 = pKF1->mDescriptors.row(idx1);
+                const int* pDists = ComputeDistances(pKF1->mDescriptors.ptr<uchar>(idx1),pKF2->mDescriptors,f2it->second);
                 
                 int bestDist = TH_LOW;
                 int bestIdx2 = -1;
@@ -731,9 +876,7 @@ int ORBmatcher::SearchForTriangulation(KeyFrame *pKF1, KeyFrame *pKF2, cv::Mat F
                         if(!bStereo2)
                             continue;
                     
-                    const cv::Mat &d2 = pKF2->mDescriptors.row(idx2);
-                    
-                    const int dist = DescriptorDistance(d1,d2);
+                    const int dist = pDists[i2];
                     
                     if(dist>TH_LOW || dist>bestDist)
                         continue;
@@ -898,13 +1041,16 @@ int ORBmatcher::Fuse(KeyFrame *pKF, const vector<MapPoint *> &vpMapPoints, const
 
         // Match to the most similar keypoint in the radius
 
-        const cv::Mat dMP = pMP->GetDescriptor();
+        alignas(32) unsigned char dMP[DescriptorStore::DESCRIPTOR_BYTES];
+        pMP->GetDescriptor(dMP);
+
+        const int* pDists = ComputeDistances(dMP,pKF->mDescriptors,vIndices);
 
         int bestDist = 256;
         int bestIdx = -1;
-        for(vector<size_t>::const_iterator vit=vIndices.begin(), vend=vIndices.end(); vit!=vend; vit++)
+        for(size_t k=0, kend=vIndices.size(); k<kend; k++)
         {
-            const size_t idx = *vit;
+            const size_t idx = vIndices[k];
 
             const cv::KeyPoint &kp = pKF->mvKeysUn[idx];
 
@@ -939,9 +1085,7 @@ int ORBmatcher::Fuse(KeyFrame *pKF, const vector<MapPoint *> &vpMapPoints, const
                     continue;
             }
 
-            const cv::Mat &dKF = pKF->mDescriptors.row(idx);
-
-            const int dist = DescriptorDistance(dMP,dKF);
+            const int dist = pDists[k];
 
             if(dist<bestDist)
             {
@@ -1057,21 +1201,22 @@ int ORBmatcher::Fuse(KeyFrame *pKF, cv::Mat Scw, const vector<MapPoint *> &vpPoi
 
         // Match to the most similar keypoint in the radius
 
-        const cv::Mat dMP = pMP->GetDescriptor();
+        alignas(32) unsigned char dMP[DescriptorStore::DESCRIPTOR_BYTES];
+        pMP->GetDescriptor(dMP);
+
+        const int* pDists = ComputeDistances(dMP,pKF->mDescriptors,vIndices);
 
         int bestDist = INT_MAX;
         int bestIdx = -1;
-        for(vector<size_t>::const_iterator vit=vIndices.begin(); vit!=vIndices.end(); vit++)
+        for(size_t k=0, kend=vIndices.size(); k<kend; k++)
         {
-            const size_t idx = *vit;
+            const size_t idx = vIndices[k];
             const int &kpLevel = pKF->mvKeysUn[idx].octave;
 
             if(kpLevel<nPredictedLevel-1 || kpLevel>nPredictedLevel)
                 continue;
 
-            const cv::Mat &dKF = pKF->mDescriptors.row(idx);
-
-            int dist = DescriptorDistance(dMP,dKF);
+            int dist = pDists[k];
 
             if(dist<bestDist)
             {
@@ -1196,22 +1341,23 @@ int ORBmatcher::SearchBySim3(KeyFrame *pKF1, KeyFrame *pKF2, vector<MapPoint*> &
             continue;
 
         // Match to the most similar keypoint in the radius
-        const cv::Mat dMP = pMP->GetDescriptor();
+        alignas(32) unsigned char dMP[DescriptorStore::DESCRIPTOR_BYTES];
+        pMP->GetDescriptor(dMP);
+
+        const int* pDists = ComputeDistances(dMP,pKF2->mDescriptors,vIndices);
 
         int bestDist = INT_MAX;
         int bestIdx = -1;
-        for(vector<size_t>::const_iterator vit=vIndices.begin(), vend=vIndices.end(); vit!=vend; vit++)
+        for(size_t k=0, kend=vIndices.size(); k<kend; k++)
         {
-            const size_t idx = *vit;
+            const size_t idx = vIndices[k];
 
             const cv::KeyPoint &kp = pKF2->mvKeysUn[idx];
 
             if(kp.octave<nPredictedLevel-1 || kp.octave>nPredictedLevel)
                 continue;
 
-            const cv::Mat &dKF = pKF2->mDescriptors.row(idx);
-
-            const int dist = DescriptorDistance(dMP,dKF);
+            const int dist = pDists[k];
 
             if(dist<bestDist)
             {
@@ -1276,22 +1422,23 @@ int ORBmatcher::SearchBySim3(KeyFrame *pKF1, KeyFrame *pKF2, vector<MapPoint*> &
             continue;
 
         // Match to the most similar keypoint in the radius
-        const cv::Mat dMP = pMP->GetDescriptor();
+        alignas(32) unsigned char dMP[DescriptorStore::DESCRIPTOR_BYTES];
+        pMP->GetDescriptor(dMP);
+
+        const int* pDists = ComputeDistances(dMP,pKF1->mDescriptors,vIndices);
 
         int bestDist = INT_MAX;
         int bestIdx = -1;
-        for(vector<size_t>::const_iterator vit=vIndices.begin(), vend=vIndices.end(); vit!=vend; vit++)
+        for(size_t k=0, kend=vIndices.size(); k<kend; k++)
         {
-            const size_t idx = *vit;
+            const size_t idx = vIndices[k];
 
             const cv::KeyPoint &kp = pKF1->mvKeysUn[idx];
 
             if(kp.octave<nPredictedLevel-1 || kp.octave>nPredictedLevel)
                 continue;
 
-            const cv::Mat &dKF = pKF1->mDescriptors.row(idx);
-
-            const int dist = DescriptorDistance(dMP,dKF);
+            const int dist = pDists[k];
 
             if(dist<bestDist)
             {
@@ -1394,14 +1541,17 @@ int ORBmatcher::SearchByProjection(Frame &CurrentFrame, const Frame &LastFrame,
                 if(vIndices2.empty())
                     continue;
 
-                const cv::Mat dMP = pMP->GetDescriptor();
+                alignas(32) unsigned char dMP[DescriptorStore::DESCRIPTOR_BYTES];
+                pMP->GetDescriptor(dMP);
+
+                const int* pDists = ComputeDistances(dMP,CurrentFrame.mDescriptors,vIndices2);
 
                 int bestDist = 256;
                 int bestIdx2 = -1;
 
-                for(vector<size_t>::const_iterator vit=vIndices2.begin(), vend=vIndices2.end(); vit!=vend; vit++)
+                for(size_t k=0, kend=vIndices2.size(); k<kend; k++)
                 {
-                    const size_t i2 = *vit;
+                    const size_t i2 = vIndices2[k];
                     if(CurrentFrame.mvpMapPoints[i2])
                         if(CurrentFrame.mvpMapPoints[i2]->Observations()>0)
                             continue;
@@ -1414,9 +1564,7 @@ int ORBmatcher::SearchByProjection(Frame &CurrentFrame, const Frame &LastFrame,
                             continue;
                     }
 
-                    const cv::Mat &d = CurrentFrame.mDescriptors.row(i2);
-
-                    const int dist = DescriptorDistance(dMP,d);
+                    const int dist = pDists[k];
 
                     if(dist<bestDist)
                     {
@@ -1532,20 +1680,21 @@ int ORBmatcher::SearchByProjection(Frame &CurrentFrame, KeyFrame *pKF, const set
                 if(vIndices2.empty())
                     continue;
 
-                const cv::Mat dMP = pMP->GetDescriptor();
+                alignas(32) unsigned char dMP[DescriptorStore::DESCRIPTOR_BYTES];
+                pMP->GetDescriptor(dMP);
+
+                const int* pDists = ComputeDistances(dMP,CurrentFrame.mDescriptors,vIndices2);
 
                 int bestDist = 256;
                 int bestIdx2 = -1;
 
-                for(vector<size_t>::const_iterator vit=vIndices2.begin(); vit!=vIndices2.end(); vit++)
+                for(size_t k=0, kend=vIndices2.size(); k<kend; k++)
                 {
-                    const size_t i2 = *vit;
+                    const size_t i2 = vIndices2[k];
                     if(CurrentFrame.mvpMapPoints[i2])
                         continue;
 
-                    const cv::Mat &d = CurrentFrame.mDescriptors.row(i2);
-
-                    const int dist = DescriptorDistance(dMP,d);
+                    const int dist = pDists[k];
 
                     if(dist<bestDist)
                     {
@@ -1644,24 +1793,33 @@ void ORBmatcher::ComputeThreeMaxima(vector<int>* histo, const int L, int &ind1,
 }
 
 
-// Bit set count operation from
-// http://graphics.stanford.edu/~seander/bithacks.html#CountBitsSetParallel
-int ORBmatcher::DescriptorDistance(const cv::Mat &a, const cv::Mat &b)
+const int* ORBmatcher::ComputeDistances(const unsigned char* pDesc, const cv::Mat &Descriptors, const vector<size_t> &vIndices)
 {
-    const int *pa = a.ptr<int32_t>();
-    const int *pb = b.ptr<int32_t>();
+    if(mvDistances.size()<vIndices.size())
+        mvDistances.resize(vIndices.size());
 
-    int dist=0;
+    if(!vIndices.empty())
+        HammingDistance::ComputeOneToMany(pDesc,Descriptors.ptr<uchar>(),Descriptors.step[0],
+                                          &vIndices[0],vIndices.size(),&mvDistances[0]);
 
-    for(int i=0; i<8; i++, pa++, pb++)
-    {
-        unsigned  int v = *pa ^ *pb;
-        v = v - ((v >> 1) & 0x55555555);
-        v = (v & 0x33333333) + ((v >> 2) & 0x33333333);
-        dist += (((v + (v >> 4)) & 0xF0F0F0F) * 0x1010101) >> 24;
-    }
+    return mvDistances.empty() ? NULL : &mvDistances[0];
+}
 
-    return dist;
+const int* ORBmatcher::ComputeDistances(const unsigned char* pDesc, const cv::Mat &Descriptors, const vector<unsigned int> &vIndices)
+{
+    if(mvDistances.size()<vIndices.size())
+        mvDistances.resize(vIndices.size());
+
+    if(!vIndices.empty())
+        HammingDistance::ComputeOneToMany(pDesc,Descriptors.ptr<uchar>(),Descriptors.step[0],
+                                          &vIndices[0],vIndices.size(),&mvDistances[0]);
+
+    return mvDistances.empty() ? NULL : &mvDistances[0];
+}
+
+int ORBmatcher::DescriptorDistance(const cv::Mat &a, const cv::Mat &b)
+{
+    return HammingDistance::Compute(a.ptr<uchar>(),b.ptr<uchar>());
 }
 
 } //namespace ORB_SLAM
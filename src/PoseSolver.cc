@@ -0,0 +1,387 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "PoseSolver.h"
+
+#include <cmath>
+#include <limits>
+#include <Eigen/Cholesky>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+namespace ORB_SLAM2
+{
+
+PoseSolver::PoseSolver(const float fx, const float fy, const float cx, const float cy, const float bf):
+    mfx(fx), mfy(fy), mcx(cx), mcy(cy), mbf(bf), mbRobust(true)
+{
+}
+
+void PoseSolver::Observations::resize(const size_t n)
+{
+    vX.resize(n); vY.resize(n); vZ.resize(n);
+    vU.resize(n); vV.resize(n); vUr.resize(n);
+    vInvSigma2.resize(n); vDelta.resize(n);
+}
+
+void PoseSolver::Reserve(const size_t n)
+{
+    mAll.vX.reserve(n); mAll.vY.reserve(n); mAll.vZ.reserve(n);
+    mAll.vU.reserve(n); mAll.vV.reserve(n); mAll.vUr.reserve(n);
+    mAll.vInvSigma2.reserve(n); mAll.vDelta.reserve(n);
+    mvbActive.reserve(n);
+}
+
+void PoseSolver::AddObservation(const float* pXw, const float u, const float v, const float ur,
+                                const float invSigma2, const float delta)
+{
+    mAll.vX.push_back(pXw[0]);
+    mAll.vY.push_back(pXw[1]);
+    mAll.vZ.push_back(pXw[2]);
+    mAll.vU.push_back(u);
+    mAll.vV.push_back(v);
+    mAll.vUr.push_back(ur);
+    mAll.vInvSigma2.push_back(invSigma2);
+    mAll.vDelta.push_back(delta);
+    mvbActive.push_back(true);
+}
+
+void PoseSolver::Optimize(g2o::SE3Quat &Tcw, const int nIterations)
+{
+    const int N = mvbActive.size();
+    mvChi2.resize(N);
+
+    // Pack the active observations
+    int nActive = 0;
+    for(int i=0; i<N; i++)
+        if(mvbActive[i])
+            nActive++;
+
+    mActive.resize(nActive);
+    mvActiveIdx.resize(nActive);
+    mvActiveChi2.resize(nActive);
+
+    for(int i=0, j=0; i<N; i++)
+    {
+        if(!mvbActive[i])
+            continue;
+
+        mActive.vX[j] = mAll.vX[i]; mActive.vY[j] = mAll.vY[i]; mActive.vZ[j] = mAll.vZ[i];
+        mActive.vU[j] = mAll.vU[i]; mActive.vV[j] = mAll.vV[i]; mActive.vUr[j] = mAll.vUr[i];
+        mActive.vInvSigma2[j] = mAll.vInvSigma2[i]; mActive.vDelta[j] = mAll.vDelta[i];
+        mvActiveIdx[j] = i;
+        j++;
+    }
+
+    // Levenberg-Marquardt as g2o::OptimizationAlgorithmLevenberg (tau 1e-5, 10 trials per iteration)
+    if(nActive>0)
+    {
+        Matrix6d H;
+        Vector6d b;
+        double lambda = 0;
+        int ni = 2;
+        int nBad = 0;
+
+        for(int it=0; it<nIterations; it++)
+        {
+            double currentChi = Evaluate<true>(Tcw,H,b);
+            const double iniChi = currentChi;
+
+            if(it==0)
+            {
+                lambda = 1e-5*H.diagonal().cwiseAbs().maxCoeff();
+                ni = 2;
+                nBad = 0;
+            }
+
+            double rho = 0;
+            int q = 0;
+            do
+            {
+                Matrix6d Hl = H;
+                Hl.diagonal().array() += lambda;
+                Eigen::LDLT<Matrix6d> ldlt(Hl);
+                const bool bSolved = ldlt.isPositive();
+                const Vector6d dx = bSolved ? Vector6d(ldlt.solve(b)) : Vector6d::Zero();
+
+                const g2o::SE3Quat Tnew = g2o::SE3Quat::exp(dx)*Tcw;
+
+                Matrix6d Hu;
+                Vector6d bu;
+                double tempChi = Evaluate<false>(Tnew,Hu,bu);
+                if(!bSolved)
+                    tempChi = numeric_limits<double>::max();
+
+                rho = (currentChi-tempChi)/(dx.dot(lambda*dx+b)+1e-3);
+
+                if(rho>0 && std::isfinite(tempChi))
+                {
+                    const double alpha = min(1.0-pow(2*rho-1,3),2.0/3.0);
+                    lambda *= max(1.0/3.0,alpha);
+                    ni = 2;
+                    currentChi = tempChi;
+                    Tcw = Tnew;
+                }
+                else
+                {
+                    lambda *= ni;
+                    ni *= 2;
+                }
+                q++;
+            }
+            while(rho<0 && q<10);
+
+            if(q==10 || rho==0)
+                break;
+
+            if((iniChi-currentChi)*1e3<iniChi)
+                nBad++;
+            else
+                nBad=0;
+
+            if(nBad>=3)
+                break;
+        }
+    }
+
+    for(int j=0; j<nActive; j++)
+        mvChi2[mvActiveIdx[j]] = mvActiveChi2[j];
+
+    const Eigen::Matrix3d R = Tcw.rotation().toRotationMatrix();
+    const Eigen::Vector3d t = Tcw.translation();
+    for(int i=0; i<N; i++)
+        if(!mvbActive[i])
+            mvChi2[i] = ComputeChi2(R,t,i);
+}
+
+template<bool bLinearize>
+double PoseSolver::Evaluate(const g2o::SE3Quat &Tcw, Matrix6d &H, Vector6d &b)
+{
+    const Eigen::Matrix3d R = Tcw.rotation().toRotationMatrix();
+    const Eigen::Vector3d t = Tcw.translation();
+    const int n = mvActiveIdx.size();
+
+    // Upper triangle of H row by row, then b
+    double acc[27];
+    for(int k=0; k<27; k++)
+        acc[k] = 0;
+    double chi = 0;
+
+    int i=0;
+
+#ifdef __AVX2__
+    {
+        const __m256d r00 = _mm256_set1_pd(R(0,0)), r01 = _mm256_set1_pd(R(0,1)), r02 = _mm256_set1_pd(R(0,2)), t0 = _mm256_set1_pd(t[0]);
+        const __m256d r10 = _mm256_set1_pd(R(1,0)), r11 = _mm256_set1_pd(R(1,1)), r12 = _mm256_set1_pd(R(1,2)), t1 = _mm256_set1_pd(t[1]);
+        const __m256d r20 = _mm256_set1_pd(R(2,0)), r21 = _mm256_set1_pd(R(2,1)), r22 = _mm256_set1_pd(R(2,2)), t2 = _mm256_set1_pd(t[2]);
+        const __m256d fx = _mm256_set1_pd(mfx), fy = _mm256_set1_pd(mfy), cx = _mm256_set1_pd(mcx), cy = _mm256_set1_pd(mcy);
+        const __m256d bf = _mm256_set1_pd(mbf);
+        const __m256d one = _mm256_set1_pd(1.0), two = _mm256_set1_pd(2.0), zero = _mm256_setzero_pd();
+
+        __m256d vAcc[27];
+        for(int k=0; k<27; k++)
+            vAcc[k] = zero;
+        __m256d vChi = zero;
+
+        for(; i+4<=n; i+=4)
+        {
+            const __m256d X = _mm256_loadu_pd(&mActive.vX[i]), Y = _mm256_loadu_pd(&mActive.vY[i]), Z = _mm256_loadu_pd(&mActive.vZ[i]);
+            const __m256d U = _mm256_loadu_pd(&mActive.vU[i]), V = _mm256_loadu_pd(&mActive.vV[i]), Ur = _mm256_loadu_pd(&mActive.vUr[i]);
+            const __m256d invSigma2 = _mm256_loadu_pd(&mActive.vInvSigma2[i]);
+
+            const __m256d x = r00*X + r01*Y + r02*Z + t0;
+            const __m256d y = r10*X + r11*Y + r12*Z + t1;
+            const __m256d z = r20*X + r21*Y + r22*Z + t2;
+
+            const __m256d invz = one/z;
+            // The stereo edge projects with a float inverse depth
+            const __m256d invzf = _mm256_cvtps_pd(_mm256_cvtpd_ps(invz));
+            const __m256d stereo = _mm256_cmp_pd(Ur,zero,_CMP_GE_OQ);
+
+            const __m256d us = x*invzf*fx + cx;
+            const __m256d eu = U - _mm256_blendv_pd(x/z*fx + cx,us,stereo);
+            const __m256d ev = V - _mm256_blendv_pd(y/z*fy + cy,y*invzf*fy + cy,stereo);
+            const __m256d er = _mm256_and_pd(stereo,Ur - (us - bf*invzf));
+
+            const __m256d chi2 = invSigma2*(eu*eu + ev*ev + er*er);
+            _mm256_storeu_pd(&mvActiveChi2[i],chi2);
+
+            __m256d rho1 = one;
+            if(mbRobust)
+            {
+                const __m256d delta = _mm256_loadu_pd(&mActive.vDelta[i]);
+                const __m256d dsqr = delta*delta;
+                const __m256d sqrte = _mm256_sqrt_pd(chi2);
+                const __m256d inlier = _mm256_cmp_pd(chi2,dsqr,_CMP_LE_OQ);
+                vChi = vChi + _mm256_blendv_pd(two*sqrte*delta - dsqr,chi2,inlier);
+                rho1 = _mm256_blendv_pd(delta/sqrte,one,inlier);
+            }
+            else
+                vChi = vChi + chi2;
+
+            if(!bLinearize)
+                continue;
+
+            const __m256d invz2 = invz*invz;
+            const __m256d J0[6] = {x*y*invz2*fx, -(one+x*x*invz2)*fx, y*invz*fx, -invz*fx, zero, x*invz2*fx};
+            const __m256d J1[6] = {(one+y*y*invz2)*fy, -x*y*invz2*fy, -x*invz*fy, zero, -invz*fy, y*invz2*fy};
+            const __m256d J2[6] = {_mm256_and_pd(stereo,J0[0]-bf*y*invz2), _mm256_and_pd(stereo,J0[1]+bf*x*invz2),
+                                   _mm256_and_pd(stereo,J0[2]), _mm256_and_pd(stereo,J0[3]), zero,
+                                   _mm256_and_pd(stereo,J0[5]-bf*invz2)};
+            const __m256d w = rho1*invSigma2;
+
+            int k=0;
+            for(int r=0; r<6; r++)
+                for(int c=r; c<6; c++)
+                    vAcc[k++] += w*(J0[r]*J0[c] + J1[r]*J1[c] + J2[r]*J2[c]);
+            for(int r=0; r<6; r++)
+                vAcc[21+r] -= w*(J0[r]*eu + J1[r]*ev + J2[r]*er);
+        }
+
+        double lanes[4];
+        _mm256_storeu_pd(lanes,vChi);
+        chi += lanes[0]+lanes[1]+lanes[2]+lanes[3];
+        if(bLinearize)
+        {
+            for(int k=0; k<27; k++)
+            {
+                _mm256_storeu_pd(lanes,vAcc[k]);
+                acc[k] += lanes[0]+lanes[1]+lanes[2]+lanes[3];
+            }
+        }
+    }
+#endif
+
+    for(; i<n; i++)
+    {
+        const double X = mActive.vX[i], Y = mActive.vY[i], Z = mActive.vZ[i];
+        const double U = mActive.vU[i], V = mActive.vV[i], Ur = mActive.vUr[i];
+        const double invSigma2 = mActive.vInvSigma2[i];
+
+        const double x = R(0,0)*X + R(0,1)*Y + R(0,2)*Z + t[0];
+        const double y = R(1,0)*X + R(1,1)*Y + R(1,2)*Z + t[1];
+        const double z = R(2,0)*X + R(2,1)*Y + R(2,2)*Z + t[2];
+
+        const double invz = 1.0/z;
+        const bool bStereo = Ur>=0;
+
+        double eu, ev, er=0;
+        if(bStereo)
+        {
+            const double invzf = static_cast<float>(invz);
+            const double us = x*invzf*mfx + mcx;
+            eu = U - us;
+            ev = V - (y*invzf*mfy + mcy);
+            er = Ur - (us - mbf*invzf);
+        }
+        else
+        {
+            eu = U - (x/z*mfx + mcx);
+            ev = V - (y/z*mfy + mcy);
+        }
+
+        const double chi2 = invSigma2*(eu*eu + ev*ev + er*er);
+        mvActiveChi2[i] = chi2;
+
+        double rho1 = 1;
+        if(mbRobust)
+        {
+            const double delta = mActive.vDelta[i];
+            const double dsqr = delta*delta;
+            if(chi2<=dsqr)
+                chi += chi2;
+            else
+            {
+                const double sqrte = sqrt(chi2);
+                chi += 2*sqrte*delta - dsqr;
+                rho1 = delta/sqrte;
+            }
+        }
+        else
+            chi += chi2;
+
+        if(!bLinearize)
+            continue;
+
+        const double invz2 = invz*invz;
+        const double J0[6] = {x*y*invz2*mfx, -(1+x*x*invz2)*mfx, y*invz*mfx, -invz*mfx, 0, x*invz2*mfx};
+        const double J1[6] = {(1+y*y*invz2)*mfy, -x*y*invz2*mfy, -x*invz*mfy, 0, -invz*mfy, y*invz2*mfy};
+        double J2[6] = {0, 0, 0, 0, 0, 0};
+        if(bStereo)
+        {
+            J2[0] = J0[0]-mbf*y*invz2;
+            J2[1] = J0[1]+mbf*x*invz2;
+            J2[2] = J0[2];
+            J2[3] = J0[3];
+            J2[5] = J0[5]-mbf*invz2;
+        }
+        const double w = rho1*invSigma2;
+
+        int k=0;
+        for(int r=0; r<6; r++)
+            for(int c=r; c<6; c++)
+                acc[k++] += w*(J0[r]*J0[c] + J1[r]*J1[c] + J2[r]*J2[c]);
+        for(int r=0; r<6; r++)
+            acc[21+r] -= w*(J0[r]*eu + J1[r]*ev + J2[r]*er);
+    }
+
+    if(bLinearize)
+    {
+        int k=0;
+        for(int r=0; r<6; r++)
+        {
+            for(int c=r; c<6; c++)
+            {
+                H(r,c) = acc[k];
+                H(c,r) = acc[k];
+                k++;
+            }
+            b[r] = acc[21+r];
+        }
+    }
+
+    return chi;
+}
+
+double PoseSolver::ComputeChi2(const Eigen::Matrix3d &R, const Eigen::Vector3d &t, const int i) const
+{
+    const Eigen::Vector3d Xc = R*Eigen::Vector3d(mAll.vX[i],mAll.vY[i],mAll.vZ[i]) + t;
+    const double invSigma2 = mAll.vInvSigma2[i];
+
+    if(mAll.vUr[i]>=0)
+    {
+        const double invzf = static_cast<float>(1.0/Xc[2]);
+        const double us = Xc[0]*invzf*mfx + mcx;
+        const double eu = mAll.vU[i] - us;
+        const double ev = mAll.vV[i] - (Xc[1]*invzf*mfy + mcy);
+        const double er = mAll.vUr[i] - (us - mbf*invzf);
+        return invSigma2*(eu*eu + ev*ev + er*er);
+    }
+
+    const double eu = mAll.vU[i] - (Xc[0]/Xc[2]*mfx + mcx);
+    const double ev = mAll.vV[i] - (Xc[1]/Xc[2]*mfy + mcy);
+    return invSigma2*(eu*eu + ev*ev);
+}
+
+} //namespace ORB_SLAM
@@ -122,11 +122,11 @@ System::System(const string &strVocFile, const string &strSettingsFile, const eS
                              mpMap, mpKeyFrameDatabase, strSettingsFile, mSensor, bReuseMap);
 
     //Initialize the Local Mapping thread and launch
-    mpLocalMapper = new LocalMapping(mpMap, mSensor==MONOCULAR);
+    mpLocalMapper = new LocalMapping(mpMap, mSensor==MONOCULAR, strSettingsFile);
     mptLocalMapping = new thread(&ORB_SLAM2::LocalMapping::Run,mpLocalMapper);
 
     //Initialize the Loop Closing thread and launch
-    mpLoopCloser = new LoopClosing(mpMap, mpKeyFrameDatabase, mpVocabulary, mSensor!=MONOCULAR);
+    mpLoopCloser = new LoopClosing(mpMap, mpKeyFrameDatabase, mpVocabulary, mSensor!=MONOCULAR, strSettingsFile);
     mptLoopClosing = new thread(&ORB_SLAM2::LoopClosing::Run, mpLoopCloser);
 
     //Initialize the Viewer thread and launch
@@ -330,11 +330,11 @@ cv::Mat System::TrackMonocular(const cv::Mat &im, const double &timestamp)
 							mpMap, mpKeyFrameDatabase, settings, mSensor, bReuseMap);
 			//		cout << " 3" << endl;
 					//Initialize the Local Mapping thread and launch
-					mpLocalMapper = new LocalMapping(mpMap, mSensor==MONOCULAR);
+					mpLocalMapper = new LocalMapping(mpMap, mSensor==MONOCULAR, settings);
 		//			mptLocalMapping = new thread(&ORB_SLAM2::LocalMapping::Run,mpLocalMapper);
 			//		cout << "4 " << endl;
 					//Initialize the Loop Closing thread and launch
-					mpLoopCloser = new LoopClosing(mpMap, mpKeyFrameDatabase, mpVocabulary, mSensor!=MONOCULAR);
+					mpLoopCloser = new LoopClosing(mpMap, mpKeyFrameDatabase, mpVocabulary, mSensor!=MONOCULAR, settings);
 				//	mptLoopClosing = new thread(&ORB_SLAM2::LoopClosing::Run, mpLoopCloser);
 			//		cout << " 5" << endl;
 					//Initialize the Viewer thread and launch
@@ -423,6 +423,9 @@ void System::Reset()
 
 void System::Shutdown()
 {
+	// Frames still being preprocessed belong to the trajectory
+	mpTracker->FlushPipeline();
+
 	mpLocalMapper->RequestFinish();
 	mpLoopCloser->RequestFinish();
 	if(mpViewer)
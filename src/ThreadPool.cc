@@ -0,0 +1,125 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ThreadPool.h"
+
+using namespace std;
+
+namespace ORB_SLAM2
+{
+
+// Set in worker threads and in a thread running a loop, so that nested loops run inline
+static thread_local bool stbInsideLoop = false;
+
+ThreadPool::ThreadPool(int nThreads):
+    mnGeneration(0), mnBusy(0), mbStop(false), mpJob(NULL), mnJobSize(0), mnNext(0)
+{
+    for(int i=1; i<nThreads; i++)
+        mvWorkers.push_back(thread(&ThreadPool::Run,this));
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        unique_lock<mutex> lock(mMutex);
+        mbStop = true;
+    }
+    mCondWork.notify_all();
+
+    for(size_t i=0; i<mvWorkers.size(); i++)
+        mvWorkers[i].join();
+}
+
+void ThreadPool::ParallelFor(int n, const function<void(int)> &f)
+{
+    if(n<=0)
+        return;
+
+    unique_lock<mutex> lockJob(mMutexJob,defer_lock);
+    if(mvWorkers.empty() || n==1 || stbInsideLoop || !lockJob.try_lock())
+    {
+        for(int i=0; i<n; i++)
+            f(i);
+        return;
+    }
+
+    {
+        unique_lock<mutex> lock(mMutex);
+        mpJob = &f;
+        mnJobSize = n;
+        mnNext = 0;
+        mnGeneration++;
+    }
+    mCondWork.notify_all();
+
+    stbInsideLoop = true;
+    RunJob();
+    stbInsideLoop = false;
+
+    // Wait until the workers have left the job, f must outlive every call
+    unique_lock<mutex> lock(mMutex);
+    while(mnBusy>0)
+        mCondDone.wait(lock);
+    mpJob = NULL;
+}
+
+void ThreadPool::RunJob()
+{
+    while(true)
+    {
+        const int i = mnNext++;
+        if(i>=mnJobSize)
+            break;
+        (*mpJob)(i);
+    }
+}
+
+void ThreadPool::Run()
+{
+    stbInsideLoop = true;
+
+    unsigned long nSeenGeneration = 0;
+
+    while(true)
+    {
+        {
+            unique_lock<mutex> lock(mMutex);
+            while(!mbStop && nSeenGeneration==mnGeneration)
+                mCondWork.wait(lock);
+            if(mbStop)
+                return;
+            nSeenGeneration = mnGeneration;
+            if(!mpJob)
+                continue;
+            mnBusy++;
+        }
+
+        RunJob();
+
+        {
+            unique_lock<mutex> lock(mMutex);
+            mnBusy--;
+            if(mnBusy==0)
+                mCondDone.notify_all();
+        }
+    }
+}
+
+} //namespace ORB_SLAM
@@ -36,6 +36,8 @@
 #include<iostream>
 
 #include<mutex>
+#include<algorithm>
+#include<functional>
 
 
 using namespace std;
@@ -43,10 +45,28 @@ using namespace std;
 namespace ORB_SLAM2
 {
 
+// Falls back to ORB (and updates backend) if the backend name is unknown
+static FeatureExtractor* CreateExtractor(string &backend, int nFeatures, float fScaleFactor, int nLevels,
+                                         int fIniThFAST, int fMinThFAST)
+{
+    FeatureExtractor* pExtractor = FeatureExtractor::Create(backend,nFeatures,fScaleFactor,nLevels,fIniThFAST,fMinThFAST);
+    if(!pExtractor)
+    {
+        cerr << "Unknown ORBextractor backend " << backend << ", using " << FeatureExtractor::ORB_BACKEND << endl;
+        backend = FeatureExtractor::ORB_BACKEND;
+        pExtractor = FeatureExtractor::Create(backend,nFeatures,fScaleFactor,nLevels,fIniThFAST,fMinThFAST);
+    }
+    return pExtractor;
+}
+
 Tracking::Tracking(System *pSys, ORBVocabulary* pVoc, FrameDrawer *pFrameDrawer, MapDrawer *pMapDrawer, Map *pMap, KeyFrameDatabase* pKFDB, const string &strSettingPath, const int sensor, bool bReuseMap):
-    mState(NO_IMAGES_YET), mSensor(sensor), mbOnlyTracking(false), mbVO(false), mpORBVocabulary(pVoc),
-    mpKeyFrameDB(pKFDB), mpInitializer(static_cast<Initializer*>(NULL)), mpSystem(pSys), mpViewer(NULL),
-    mpFrameDrawer(pFrameDrawer), mpMapDrawer(pMapDrawer), mpMap(pMap), mnLastRelocFrameId(0)
+    mState(NO_IMAGES_YET), mSensor(sensor), mbOnlyTracking(false), mbVO(false), mpExtractorPool(NULL), mpBudgetController(NULL), mpPipeline(NULL), mnPipelineDepth(0),
+    mfMaxFrameLatency(0), mdLastSubmittedTimestamp(-numeric_limits<double>::max()), mnDroppedFrames(0), mpTrackingPool(NULL), mpORBVocabulary(pVoc),
+    mpKeyFrameDB(pKFDB), mpInitializer(static_cast<Initializer*>(NULL)), mpLocalMapReferenceKF(NULL),
+    mnLocalMapGraphChangeIdx(0), mnLocalMapFrameId(0), mpSystem(pSys), mpViewer(NULL),
+    mpFrameDrawer(pFrameDrawer), mpMapDrawer(pMapDrawer), mpMap(pMap), mnLastRelocFrameId(0),
+    mfRelocalizationBudget(0), mnNextRelocCandidate(0), mnLastRelocAttemptFrameId(0),
+    mnMotionModel(1), mnVelocityFrameId(0), mnLastVelocityFrameId(0), mfPredictionError(0), mnTemporalPoints(0)
 {
     // Load camera parameters from settings file
 
@@ -99,6 +119,16 @@ Tracking::Tracking(System *pSys, ORBVocabulary* pVoc, FrameDrawer *pFrameDrawer,
     cout << "- p2: " << DistCoef.at<float>(3) << endl;
     cout << "- fps: " << fps << endl;
 
+    // Keypoint undistortion table. Without the image size it is built from the first image.
+    int nWidth = fSettings["Camera.width"];
+    int nHeight = fSettings["Camera.height"];
+    Frame::mUndistortionMap.Clear();
+    if(DistCoef.at<float>(0)!=0.0 && nWidth>0 && nHeight>0)
+    {
+        Frame::mUndistortionMap.Build(mK,mDistCoef,cv::Size(nWidth,nHeight));
+        cout << "- undistortion table: " << nWidth << "x" << nHeight << endl;
+    }
+
 
     int nRGB = fSettings["Camera.RGB"];
     mbRGB = nRGB;
@@ -116,20 +146,85 @@ Tracking::Tracking(System *pSys, ORBVocabulary* pVoc, FrameDrawer *pFrameDrawer,
     int fIniThFAST = fSettings["ORBextractor.iniThFAST"];
     int fMinThFAST = fSettings["ORBextractor.minThFAST"];
 
-    mpORBextractorLeft = new ORBextractor(nFeatures,fScaleFactor,nLevels,fIniThFAST,fMinThFAST);
+    // Extraction backend of each camera: ORB (default) or FAST
+    string strBackend = (string)fSettings["ORBextractor.backend"];
+    if(strBackend.empty())
+        strBackend = FeatureExtractor::ORB_BACKEND;
+    string strBackendRight = (string)fSettings["ORBextractor.backendRight"];
+    if(strBackendRight.empty())
+        strBackendRight = strBackend;
+
+    mpORBextractorLeft = CreateExtractor(strBackend,nFeatures,fScaleFactor,nLevels,fIniThFAST,fMinThFAST);
 
     if(sensor==System::STEREO)
-        mpORBextractorRight = new ORBextractor(nFeatures,fScaleFactor,nLevels,fIniThFAST,fMinThFAST);
+    {
+        mpORBextractorRight = CreateExtractor(strBackendRight,nFeatures,fScaleFactor,nLevels,fIniThFAST,fMinThFAST);
+
+        // Stereo matching compares the same pyramid level in both images
+        if(mpORBextractorRight->GetLevels()!=mpORBextractorLeft->GetLevels())
+        {
+            cerr << "Backends " << strBackend << " and " << strBackendRight << " use different scale levels, "
+                 << "using " << strBackend << " for both cameras" << endl;
+            delete mpORBextractorRight;
+            strBackendRight = strBackend;
+            mpORBextractorRight = CreateExtractor(strBackendRight,nFeatures,fScaleFactor,nLevels,fIniThFAST,fMinThFAST);
+        }
+    }
 
     if(sensor==System::MONOCULAR)
-        mpIniORBextractor = new ORBextractor(2*nFeatures,fScaleFactor,nLevels,fIniThFAST,fMinThFAST);
+        mpIniORBextractor = CreateExtractor(strBackend,2*nFeatures,fScaleFactor,nLevels,fIniThFAST,fMinThFAST);
+
+    // Optional: extract the pyramid levels in parallel (0 or 1: sequential)
+    int nExtractorThreads = fSettings["ORBextractor.nThreads"];
+    // Stereo frames extract both images and match row bands on the pool
+    if(sensor==System::STEREO)
+        nExtractorThreads = max(nExtractorThreads,2);
+    if(nExtractorThreads>1)
+    {
+        mpExtractorPool = new ThreadPool(nExtractorThreads);
+        Frame::mpThreadPool = mpExtractorPool;
+        mpORBextractorLeft->SetThreadPool(mpExtractorPool);
+        if(sensor==System::STEREO)
+            mpORBextractorRight->SetThreadPool(mpExtractorPool);
+        if(sensor==System::MONOCULAR)
+            mpIniORBextractor->SetThreadPool(mpExtractorPool);
+    }
+    else
+        nExtractorThreads = 1;
+
+    // Optional: adapt the number of features to the tracking quality and frame time
+    int nAdaptiveBudget = fSettings["ORBextractor.adaptiveBudget"];
+    int nMinFeatures = fSettings["ORBextractor.minFeatures"];
+    int nTargetInliers = fSettings["ORBextractor.targetInliers"];
+    float fTargetFrameTime = fSettings["ORBextractor.targetFrameTime"];
+    if(nAdaptiveBudget)
+    {
+        if(nMinFeatures<=0)
+            nMinFeatures = nFeatures/2;
+        if(nTargetInliers<=0)
+            nTargetInliers = 100;
+        if(fTargetFrameTime<=0)
+            fTargetFrameTime = 1000.0f/fps;
+        mpBudgetController = new FeatureBudgetController(nMinFeatures,nFeatures,fIniThFAST,fMinThFAST,
+                                                         nTargetInliers,fTargetFrameTime/1000.0f);
+    }
 
     cout << endl  << "ORB Extractor Parameters: " << endl;
+    cout << "- Backend: " << strBackend << endl;
+    if(sensor==System::STEREO)
+        cout << "- Right Backend: " << strBackendRight << endl;
     cout << "- Number of Features: " << nFeatures << endl;
-    cout << "- Scale Levels: " << nLevels << endl;
+    cout << "- Scale Levels: " << mpORBextractorLeft->GetLevels() << endl;
     cout << "- Scale Factor: " << fScaleFactor << endl;
     cout << "- Initial Fast Threshold: " << fIniThFAST << endl;
     cout << "- Minimum Fast Threshold: " << fMinThFAST << endl;
+    cout << "- Extraction Threads: " << nExtractorThreads << endl;
+    if(mpBudgetController)
+    {
+        cout << "- Adaptive Budget: " << nMinFeatures << " to " << nFeatures << " features" << endl;
+        cout << "- Target Inliers: " << nTargetInliers << endl;
+        cout << "- Target Frame Time: " << fTargetFrameTime << "ms" << endl;
+    }
 
     if(sensor==System::STEREO || sensor==System::RGBD)
     {
@@ -144,7 +239,54 @@ Tracking::Tracking(System *pSys, ORBVocabulary* pVoc, FrameDrawer *pFrameDrawer,
             mDepthMapFactor=1;
         else
             mDepthMapFactor = 1.0f/mDepthMapFactor;
+
+        int nRawDepth = fSettings["DepthMapRaw"];
+        int nDepthMedianRadius = fSettings["DepthMedianRadius"];
+        mbRawDepth = nRawDepth;
+        mnDepthMedianRadius = max(nDepthMedianRadius,0);
+        cout << "- Raw Depthmap Sampling: " << (mbRawDepth ? "yes" : "no") << endl;
+        if(mnDepthMedianRadius>0)
+            cout << "- Depth Median Radius: " << mnDepthMedianRadius << endl;
+    }
+
+    // Optional: build frame N+1 on a worker while frame N is tracked
+    int nPipelineDepth = fSettings["Tracking.pipelineDepth"];
+    float fMaxFrameLatency = fSettings["Tracking.maxFrameLatency"];
+    if(nPipelineDepth>0)
+    {
+        mnPipelineDepth = nPipelineDepth;
+        mfMaxFrameLatency = max(fMaxFrameLatency,0.0f)/1000.0f;
+        mpPipeline = new FramePipeline(nPipelineDepth+1);
+
+        cout << endl << "Frame Pipeline Depth: " << mnPipelineDepth << endl;
+        if(mfMaxFrameLatency>0)
+            cout << "- Max Frame Latency: " << fMaxFrameLatency << "ms" << endl;
+    }
+
+    // Optional: project and match the local map in parallel (0 or 1: sequential)
+    int nTrackingThreads = fSettings["Tracking.nThreads"];
+    if(nTrackingThreads>1)
+    {
+        mpTrackingPool = new ThreadPool(nTrackingThreads);
+        cout << endl << "Local Map Tracking Threads: " << nTrackingThreads << endl;
+    }
+
+    // Optional: constant acceleration motion model, with a search window sized by its last error
+    int nMotionModel = fSettings["Tracking.motionModel"];
+    if(nMotionModel==2)
+    {
+        mnMotionModel = 2;
+        cout << endl << "Motion Model: constant acceleration" << endl;
     }
+
+    // Optional: bound the time spent relocalizing each lost frame
+    float fRelocalizationBudget = fSettings["Tracking.relocalizationBudget"];
+    if(fRelocalizationBudget>0)
+    {
+        mfRelocalizationBudget = fRelocalizationBudget;
+        cout << endl << "Relocalization Budget: " << mfRelocalizationBudget << " ms" << endl;
+    }
+
     if (bReuseMap)
         mState = LOST;
 }
@@ -165,104 +307,242 @@ void Tracking::SetViewer(Viewer *pViewer)
 }
 
 
-cv::Mat Tracking::GrabImageStereo(const cv::Mat &imRectLeft, const cv::Mat &imRectRight, const double &timestamp)
+// Color images are converted to a new grayscale buffer
+static void ConvertToGray(cv::Mat &im, const bool bRGB)
 {
-    mImGray = imRectLeft;
-    cv::Mat imGrayRight = imRectRight;
-
-    if(mImGray.channels()==3)
+    if(im.channels()==3)
     {
-        if(mbRGB)
-        {
-            cvtColor(mImGray,mImGray,CV_RGB2GRAY);
-            cvtColor(imGrayRight,imGrayRight,CV_RGB2GRAY);
-        }
+        if(bRGB)
+            cvtColor(im,im,CV_RGB2GRAY);
         else
-        {
-            cvtColor(mImGray,mImGray,CV_BGR2GRAY);
-            cvtColor(imGrayRight,imGrayRight,CV_BGR2GRAY);
-        }
+            cvtColor(im,im,CV_BGR2GRAY);
     }
-    else if(mImGray.channels()==4)
+    else if(im.channels()==4)
     {
-        if(mbRGB)
-        {
-            cvtColor(mImGray,mImGray,CV_RGBA2GRAY);
-            cvtColor(imGrayRight,imGrayRight,CV_RGBA2GRAY);
-        }
+        if(bRGB)
+            cvtColor(im,im,CV_RGBA2GRAY);
         else
-        {
-            cvtColor(mImGray,mImGray,CV_BGRA2GRAY);
-            cvtColor(imGrayRight,imGrayRight,CV_BGRA2GRAY);
-        }
+            cvtColor(im,im,CV_BGRA2GRAY);
     }
+}
 
-    mCurrentFrame = Frame(mImGray,imGrayRight,timestamp,mpORBextractorLeft,mpORBextractorRight,mpORBVocabulary,mK,mDistCoef,mbf,mThDepth);
-
-    Track();
+cv::Mat Tracking::GrabImageStereo(const cv::Mat &imRectLeft, const cv::Mat &imRectRight, const double &timestamp)
+{
+    // The pipeline builds the frame after the caller may have reused its buffers
+    const cv::Mat imLeft = mpPipeline ? imRectLeft.clone() : imRectLeft;
+    const cv::Mat imRight = mpPipeline ? imRectRight.clone() : imRectRight;
+
+    // The job may run on the pipeline worker, it only reads copies of the tracking settings
+    const bool bRGB = mbRGB;
+    cv::Mat K = mpPipeline ? mK.clone() : mK;
+    cv::Mat DistCoef = mpPipeline ? mDistCoef.clone() : mDistCoef;
+    const float bf = mbf;
+    const float thDepth = mThDepth;
+    FeatureExtractor* pExtractorLeft = mpORBextractorLeft;
+    FeatureExtractor* pExtractorRight = mpORBextractorRight;
+    ORBVocabulary* pVocabulary = mpORBVocabulary;
+
+    PrepareUndistortion(imLeft.size());
+
+    return GrabFrame([=](Frame &frame, cv::Mat &imGray) mutable
+    {
+        imGray = imLeft;
+        cv::Mat imGrayRight = imRight;
+        ConvertToGray(imGray,bRGB);
+        ConvertToGray(imGrayRight,bRGB);
 
-    return mCurrentFrame.mTcw.clone();
+        frame = Frame(imGray,imGrayRight,timestamp,pExtractorLeft,pExtractorRight,pVocabulary,K,DistCoef,bf,thDepth);
+    }, timestamp);
 }
 
 
 cv::Mat Tracking::GrabImageRGBD(const cv::Mat &imRGB,const cv::Mat &imD, const double &timestamp)
 {
-    mImGray = imRGB;
-    cv::Mat imDepth = imD;
+    const cv::Mat imColor = mpPipeline ? imRGB.clone() : imRGB;
+    const cv::Mat imDepthIn = mpPipeline ? imD.clone() : imD;
+
+    const bool bRGB = mbRGB;
+    cv::Mat K = mpPipeline ? mK.clone() : mK;
+    cv::Mat DistCoef = mpPipeline ? mDistCoef.clone() : mDistCoef;
+    const float bf = mbf;
+    const float thDepth = mThDepth;
+    const float depthMapFactor = mDepthMapFactor;
+    const bool bRawDepth = mbRawDepth;
+    const int nDepthMedianRadius = mnDepthMedianRadius;
+    FeatureExtractor* pExtractor = mpORBextractorLeft;
+    ORBVocabulary* pVocabulary = mpORBVocabulary;
+
+    PrepareUndistortion(imColor.size());
+
+    return GrabFrame([=](Frame &frame, cv::Mat &imGray) mutable
+    {
+        imGray = imColor;
+        cv::Mat imDepth = imDepthIn;
+        ConvertToGray(imGray,bRGB);
 
-    if(mImGray.channels()==3)
+        if(bRawDepth && imDepth.type()==CV_16U)
+        {
+            frame = Frame(imGray,imDepth,timestamp,pExtractor,pVocabulary,K,DistCoef,bf,thDepth,
+                          depthMapFactor,nDepthMedianRadius);
+            return;
+        }
+
+        if((fabs(depthMapFactor-1.0f)>1e-5) || imDepth.type()!=CV_32F)
+            imDepth.convertTo(imDepth,CV_32F,depthMapFactor);
+
+        frame = Frame(imGray,imDepth,timestamp,pExtractor,pVocabulary,K,DistCoef,bf,thDepth,
+                      1.0f,nDepthMedianRadius);
+    }, timestamp);
+}
+
+
+cv::Mat Tracking::GrabImageMonocular(const cv::Mat &im, const double &timestamp)
+{
+    const cv::Mat imColor = mpPipeline ? im.clone() : im;
+
+    // GrabFrame does not build frames ahead before the initialization, so the state is the
+    // one left by the previous frame
+    FeatureExtractor* pExtractor = (mState==NOT_INITIALIZED || mState==NO_IMAGES_YET) ? mpIniORBextractor : mpORBextractorLeft;
+
+    const bool bRGB = mbRGB;
+    cv::Mat K = mpPipeline ? mK.clone() : mK;
+    cv::Mat DistCoef = mpPipeline ? mDistCoef.clone() : mDistCoef;
+    const float bf = mbf;
+    const float thDepth = mThDepth;
+    ORBVocabulary* pVocabulary = mpORBVocabulary;
+
+    PrepareUndistortion(imColor.size());
+
+    return GrabFrame([=](Frame &frame, cv::Mat &imGray) mutable
     {
-        if(mbRGB)
-            cvtColor(mImGray,mImGray,CV_RGB2GRAY);
-        else
-            cvtColor(mImGray,mImGray,CV_BGR2GRAY);
-    }
-    else if(mImGray.channels()==4)
+        imGray = imColor;
+        ConvertToGray(imGray,bRGB);
+
+        frame = Frame(imGray,timestamp,pExtractor,pVocabulary,K,DistCoef,bf,thDepth);
+    }, timestamp);
+}
+
+cv::Mat Tracking::GrabFrame(const FramePipeline::Job &job, const double &timestamp)
+{
+    if(!mpPipeline)
     {
-        if(mbRGB)
-            cvtColor(mImGray,mImGray,CV_RGBA2GRAY);
-        else
-            cvtColor(mImGray,mImGray,CV_BGRA2GRAY);
+        const chrono::steady_clock::time_point tStart = chrono::steady_clock::now();
+
+        job(mCurrentFrame,mImGray);
+        mCurrentFrame.AssignId();
+
+        Track();
+
+        UpdateFeatureBudget(chrono::duration_cast<chrono::duration<double> >(chrono::steady_clock::now()-tStart).count());
+
+        return mCurrentFrame.mTcw.clone();
     }
 
-    if((fabs(mDepthMapFactor-1.0f)>1e-5) || imDepth.type()!=CV_32F)
-        imDepth.convertTo(imDepth,CV_32F,mDepthMapFactor);
+    // Frames are tracked in timestamp order
+    if(timestamp>mdLastSubmittedTimestamp)
+    {
+        mpPipeline->Submit(job);
+        mdLastSubmittedTimestamp = timestamp;
+    }
+    else
+        cerr << "Frame " << timestamp << " is older than the previous one, dropped" << endl;
 
-    mCurrentFrame = Frame(mImGray,imDepth,timestamp,mpORBextractorLeft,mpORBVocabulary,mK,mDistCoef,mbf,mThDepth);
+    // Track frame N while frame N+1 is being built. Until the map is initialized the monocular
+    // extractor depends on the state left by frame N, so frames are tracked as they come.
+    int nDepth = mnPipelineDepth;
+    if(mSensor==System::MONOCULAR && (mState==NOT_INITIALIZED || mState==NO_IMAGES_YET))
+        nDepth = 0;
 
-    Track();
+    while(mpPipeline->Size()>nDepth)
+        TrackNextFrame(true);
 
     return mCurrentFrame.mTcw.clone();
 }
 
-
-cv::Mat Tracking::GrabImageMonocular(const cv::Mat &im, const double &timestamp)
+bool Tracking::TrackNextFrame(const bool bAllowDrop)
 {
-    mImGray = im;
+    shared_ptr<FramePipeline::Output> pOutput = mpPipeline->Retrieve();
+    if(!pOutput)
+        return false;
 
-    if(mImGray.channels()==3)
-    {
-        if(mbRGB)
-            cvtColor(mImGray,mImGray,CV_RGB2GRAY);
-        else
-            cvtColor(mImGray,mImGray,CV_BGR2GRAY);
-    }
-    else if(mImGray.channels()==4)
+    const chrono::steady_clock::time_point tStart = chrono::steady_clock::now();
+
+    // Drop policy: tracking is behind, skip frames that waited too long if newer ones are queued
+    if(bAllowDrop && mfMaxFrameLatency>0 && mpPipeline->Size()>0)
     {
-        if(mbRGB)
-            cvtColor(mImGray,mImGray,CV_RGBA2GRAY);
-        else
-            cvtColor(mImGray,mImGray,CV_BGRA2GRAY);
+        const double latency = chrono::duration_cast<chrono::duration<double> >(tStart-pOutput->tSubmitted).count();
+        if(latency>mfMaxFrameLatency)
+        {
+            mnDroppedFrames++;
+
+            // The trajectory keeps an entry per frame, a dropped frame is saved as lost.
+            // It takes no frame id, so the frame distances (relocalization, keyframe insertion)
+            // count tracked frames.
+            if(!mlRelativeFramePoses.empty())
+            {
+                mlRelativeFramePoses.push_back(mlRelativeFramePoses.back());
+                mlpReferences.push_back(mlpReferences.back());
+                mlFrameTimes.push_back(pOutput->frame.mTimeStamp);
+                mlbLost.push_back(true);
+            }
+            return true;
+        }
     }
 
-    if(mState==NOT_INITIALIZED || mState==NO_IMAGES_YET)
-        mCurrentFrame = Frame(mImGray,timestamp,mpIniORBextractor,mpORBVocabulary,mK,mDistCoef,mbf,mThDepth);
-    else
-        mCurrentFrame = Frame(mImGray,timestamp,mpORBextractorLeft,mpORBVocabulary,mK,mDistCoef,mbf,mThDepth);
+    mCurrentFrame = std::move(pOutput->frame);
+    mCurrentFrame.AssignId();
+    mImGray = pOutput->imGray;
 
     Track();
 
-    return mCurrentFrame.mTcw.clone();
+    // Building and tracking overlap, the slowest of both bounds the frame rate
+    const double trackTime = chrono::duration_cast<chrono::duration<double> >(chrono::steady_clock::now()-tStart).count();
+    UpdateFeatureBudget(max(trackTime,pOutput->dPreprocessTime));
+
+    return true;
+}
+
+void Tracking::PrepareUndistortion(const cv::Size &imSize)
+{
+    if(mDistCoef.at<float>(0)==0.0 || Frame::mUndistortionMap.IsBuilt(imSize))
+        return;
+
+    // Queued frames read the table being replaced
+    if(mpPipeline)
+        while(TrackNextFrame(false));
+
+    Frame::mUndistortionMap.Build(mK,mDistCoef,imSize);
+    cout << "Undistortion table: " << imSize.width << "x" << imSize.height << endl;
+}
+
+void Tracking::FlushPipeline()
+{
+    if(!mpPipeline)
+        return;
+
+    while(TrackNextFrame(false));
+
+    if(mnDroppedFrames>0)
+        cout << "Frame pipeline dropped " << mnDroppedFrames << " frames" << endl;
+}
+
+void Tracking::UpdateFeatureBudget(const double frameTime)
+{
+    if(!mpBudgetController || mState==NOT_INITIALIZED || mState==NO_IMAGES_YET)
+        return;
+
+    // Visual odometry (localization mode) does not track the local map
+    const int nInliers = (mState==OK && !(mbOnlyTracking && mbVO)) ? mnMatchesInliers : 0;
+
+    if(mpBudgetController->Update(nInliers,frameTime))
+    {
+        const int nFeatures = mpBudgetController->GetNumFeatures();
+        const int iniThFAST = mpBudgetController->GetIniThFAST();
+        const int minThFAST = mpBudgetController->GetMinThFAST();
+        mpORBextractorLeft->SetFeatureBudget(nFeatures,iniThFAST,minThFAST);
+        if(mSensor==System::STEREO)
+            mpORBextractorRight->SetFeatureBudget(nFeatures,iniThFAST,minThFAST);
+    }
 }
 
 void Tracking::Track()
@@ -428,10 +708,16 @@ void Tracking::Track()
                 cv::Mat LastTwc = cv::Mat::eye(4,4,CV_32F);
                 mLastFrame.GetRotationInverse().copyTo(LastTwc.rowRange(0,3).colRange(0,3));
                 mLastFrame.GetCameraCenter().copyTo(LastTwc.rowRange(0,3).col(3));
+                mLastVelocity = mVelocity;
+                mnLastVelocityFrameId = mnVelocityFrameId;
                 mVelocity = mCurrentFrame.mTcw*LastTwc;
+                mnVelocityFrameId = mCurrentFrame.mnId;
             }
             else
+            {
                 mVelocity = cv::Mat();
+                mfPredictionError = 0;
+            }
 
             mpMapDrawer->SetCurrentCameraPose(mCurrentFrame.mTcw);
 
@@ -447,13 +733,8 @@ void Tracking::Track()
                     }
             }
 
-            // Delete temporal MapPoints
-            for(list<MapPoint*>::iterator lit = mlpTemporalPoints.begin(), lend =  mlpTemporalPoints.end(); lit!=lend; lit++)
-            {
-                MapPoint* pMP = *lit;
-                delete pMP;
-            }
-            mlpTemporalPoints.clear();
+            // Release temporal MapPoints, they are reused by the next frames
+            mnTemporalPoints = 0;
 
             // Check if we need to insert a new keyframe
             if(NeedNewKeyFrame())
@@ -549,6 +830,7 @@ void Tracking::StereoInitialization()
 
         mvpLocalKeyFrames.push_back(pKFini);
         mvpLocalMapPoints=mpMap->GetAllMapPoints();
+        mpLocalMapReferenceKF = static_cast<KeyFrame*>(NULL);
         mpReferenceKF = pKFini;
         mCurrentFrame.mpReferenceKF = pKFini;
 
@@ -685,7 +967,7 @@ void Tracking::CreateInitialMapMonocular()
     // Bundle Adjustment
     cout << "New Map created with " << mpMap->MapPointsInMap() << " points" << endl;
 
-    Optimizer::GlobalBundleAdjustemnt(mpMap,20);
+    Optimizer::GlobalBundleAdjustemnt(mpMap,20,NULL,0,true,mpTrackingPool);
 
     // Set median depth to 1
     float medianDepth = pKFini->ComputeSceneMedianDepth(2);
@@ -724,6 +1006,7 @@ void Tracking::CreateInitialMapMonocular()
     mvpLocalKeyFrames.push_back(pKFcur);
     mvpLocalKeyFrames.push_back(pKFini);
     mvpLocalMapPoints=mpMap->GetAllMapPoints();
+    mpLocalMapReferenceKF = static_cast<KeyFrame*>(NULL);
     mpReferenceKF = pKFcur;
     mCurrentFrame.mpReferenceKF = pKFcur;
 
@@ -849,11 +1132,21 @@ void Tracking::UpdateLastFrame()
         if(bCreateNew)
         {
             cv::Mat x3D = mLastFrame.UnprojectStereo(i);
-            MapPoint* pNewMP = new MapPoint(x3D,mpMap,&mLastFrame,i);
+            MapPoint* pNewMP;
+            if(mnTemporalPoints<mvpTemporalPoints.size())
+            {
+                pNewMP = mvpTemporalPoints[mnTemporalPoints];
+                pNewMP->ResetFromFrame(x3D,&mLastFrame,i);
+            }
+            else
+            {
+                pNewMP = new MapPoint(x3D,mpMap,&mLastFrame,i);
+                mvpTemporalPoints.push_back(pNewMP);
+            }
+            mnTemporalPoints++;
 
             mLastFrame.mvpMapPoints[i]=pNewMP;
 
-            mlpTemporalPoints.push_back(pNewMP);
             nPoints++;
         }
         else
@@ -874,7 +1167,8 @@ bool Tracking::TrackWithMotionModel()
     // Create "visual odometry" points if in Localization Mode
     UpdateLastFrame();
 
-    mCurrentFrame.SetPose(mVelocity*mLastFrame.mTcw);
+    const cv::Mat Tprior = PredictPose();
+    mCurrentFrame.SetPose(Tprior);
 
     fill(mCurrentFrame.mvpMapPoints.begin(),mCurrentFrame.mvpMapPoints.end(),static_cast<MapPoint*>(NULL));
 
@@ -884,6 +1178,11 @@ bool Tracking::TrackWithMotionModel()
         th=15;
     else
         th=7;
+
+    // Widen the window to twice the error of the last prediction, so that fast motion is found in the first search
+    if(mnMotionModel==2)
+        th = min(max(th,(int)ceil(2.0f*mfPredictionError)),2*th);
+
     int nmatches = matcher.SearchByProjection(mCurrentFrame,mLastFrame,th,mSensor==System::MONOCULAR);
 
     // If few matches, uses a wider window search
@@ -894,7 +1193,12 @@ bool Tracking::TrackWithMotionModel()
     }
 
     if(nmatches<20)
+    {
+        // The prediction was off by more than the window, start wider next time
+        if(mnMotionModel==2)
+            mfPredictionError = th;
         return false;
+    }
 
     // Optimize frame pose with all matches
     Optimizer::PoseOptimization(&mCurrentFrame);
@@ -920,6 +1224,9 @@ bool Tracking::TrackWithMotionModel()
         }
     }    
 
+    if(mnMotionModel==2)
+        mfPredictionError = ComputePredictionError(Tprior);
+
     if(mbOnlyTracking)
     {
         mbVO = nmatchesMap<10;
@@ -929,6 +1236,50 @@ bool Tracking::TrackWithMotionModel()
     return nmatchesMap>=10;
 }
 
+cv::Mat Tracking::PredictPose()
+{
+    // Constant acceleration if the last two velocities are from consecutive frames
+    if(mnMotionModel==2 && !mLastVelocity.empty() && mnVelocityFrameId==mLastFrame.mnId &&
+            mnLastVelocityFrameId+1==mnVelocityFrameId)
+        return mVelocity*mLastVelocity.inv()*mVelocity*mLastFrame.mTcw;
+
+    return mVelocity*mLastFrame.mTcw;
+}
+
+float Tracking::ComputePredictionError(const cv::Mat &Tcw)
+{
+    const cv::Mat Rcw = Tcw.rowRange(0,3).colRange(0,3);
+    const cv::Mat tcw = Tcw.rowRange(0,3).col(3);
+
+    // Reprojection error of the inliers with the predicted pose
+    vector<float> vErrors;
+    vErrors.reserve(mCurrentFrame.N);
+    for(int i=0; i<mCurrentFrame.N; i++)
+    {
+        MapPoint* pMP = mCurrentFrame.mvpMapPoints[i];
+        if(!pMP || mCurrentFrame.mvbOutlier[i])
+            continue;
+
+        const cv::Mat x3Dc = Rcw*pMP->GetWorldPos()+tcw;
+        const float z = x3Dc.at<float>(2);
+        if(z<=0)
+            continue;
+
+        const float u = Frame::fx*x3Dc.at<float>(0)/z+Frame::cx;
+        const float v = Frame::fy*x3Dc.at<float>(1)/z+Frame::cy;
+        const cv::KeyPoint &kp = mCurrentFrame.mvKeysUn[i];
+        const float du = u-kp.pt.x;
+        const float dv = v-kp.pt.y;
+        vErrors.push_back(sqrt(du*du+dv*dv));
+    }
+
+    if(vErrors.empty())
+        return 0;
+
+    nth_element(vErrors.begin(),vErrors.begin()+vErrors.size()/2,vErrors.end());
+    return vErrors[vErrors.size()/2];
+}
+
 bool Tracking::TrackLocalMap()
 {
     // We have an estimation of the camera pose and some map points tracked in the frame.
@@ -1163,23 +1514,12 @@ void Tracking::SearchLocalPoints()
         }
     }
 
-    int nToMatch=0;
+    // Project points in frame and check its visibility (this fills MapPoint variables for matching)
+    mLocalMapProjector.Project(mCurrentFrame,mvpLocalMapPoints,0.5,mvpLocalPointsInView,mpTrackingPool);
 
-    // Project points in frame and check its visibility
-    for(vector<MapPoint*>::iterator vit=mvpLocalMapPoints.begin(), vend=mvpLocalMapPoints.end(); vit!=vend; vit++)
-    {
-        MapPoint* pMP = *vit;
-        if(pMP->mnLastFrameSeen == mCurrentFrame.mnId)
-            continue;
-        if(pMP->isBad())
-            continue;
-        // Project (this fills MapPoint variables for matching)
-        if(mCurrentFrame.isInFrustum(pMP,0.5))
-        {
-            pMP->IncreaseVisible();
-            nToMatch++;
-        }
-    }
+    const int nToMatch = mvpLocalPointsInView.size();
+    for(int i=0; i<nToMatch; i++)
+        mvpLocalPointsInView[i]->IncreaseVisible();
 
     if(nToMatch>0)
     {
@@ -1190,7 +1530,8 @@ void Tracking::SearchLocalPoints()
         // If the camera has been relocalised recently, perform a coarser search
         if(mCurrentFrame.mnId<mnLastRelocFrameId+2)
             th=5;
-        matcher.SearchByProjection(mCurrentFrame,mvpLocalMapPoints,th);
+        matcher.SearchByProjection(mCurrentFrame,mvpLocalPointsInView,mLocalMapProjector.GetInViewDescriptors(),
+                                   mLocalMapProjector.GetInViewCells(),th,mpTrackingPool);
     }
 }
 
@@ -1199,9 +1540,9 @@ void Tracking::UpdateLocalMap()
     // This is for visualization
     mpMap->SetReferenceMapPoints(mvpLocalMapPoints);
 
-    // Update
-    UpdateLocalKeyFrames();
-    UpdateLocalPoints();
+    // Update, the points only if the local keyframes were rebuilt
+    if(UpdateLocalKeyFrames())
+        UpdateLocalPoints();
 }
 
 void Tracking::UpdateLocalPoints()
@@ -1230,10 +1571,10 @@ void Tracking::UpdateLocalPoints()
 }
 
 
-void Tracking::UpdateLocalKeyFrames()
+bool Tracking::UpdateLocalKeyFrames()
 {
     // Each map point vote for the keyframes in which it has been observed
-    map<KeyFrame*,int> keyframeCounter;
+    mvpVotingKeyFrames.clear();
     for(int i=0; i<mCurrentFrame.N; i++)
     {
         if(mCurrentFrame.mvpMapPoints[i])
@@ -1241,9 +1582,19 @@ void Tracking::UpdateLocalKeyFrames()
             MapPoint* pMP = mCurrentFrame.mvpMapPoints[i];
             if(!pMP->isBad())
             {
-                const map<KeyFrame*,size_t> observations = pMP->GetObservations();
-                for(map<KeyFrame*,size_t>::const_iterator it=observations.begin(), itend=observations.end(); it!=itend; it++)
-                    keyframeCounter[it->first]++;
+                mvpObservingKeyFrames.clear();
+                pMP->GetObservingKeyFrames(mvpObservingKeyFrames);
+                for(size_t k=0; k<mvpObservingKeyFrames.size(); k++)
+                {
+                    KeyFrame* pKF = mvpObservingKeyFrames[k];
+                    if(pKF->mnTrackVoteForFrame!=mCurrentFrame.mnId)
+                    {
+                        pKF->mnTrackVoteForFrame = mCurrentFrame.mnId;
+                        pKF->mnTrackVotes = 0;
+                        mvpVotingKeyFrames.push_back(pKF);
+                    }
+                    pKF->mnTrackVotes++;
+                }
             }
             else
             {
@@ -1252,33 +1603,63 @@ void Tracking::UpdateLocalKeyFrames()
         }
     }
 
-    if(keyframeCounter.empty())
-        return;
+    if(mvpVotingKeyFrames.empty())
+        return false;
 
+    // Check which keyframe shares most points (ties to the lowest address) and if the local map covers all voting keyframes
     int max=0;
     KeyFrame* pKFmax= static_cast<KeyFrame*>(NULL);
+    bool bCovered = true;
 
-    mvpLocalKeyFrames.clear();
-    mvpLocalKeyFrames.reserve(3*keyframeCounter.size());
-
-    // All keyframes that observe a map point are included in the local map. Also check which keyframe shares most points
-    for(map<KeyFrame*,int>::const_iterator it=keyframeCounter.begin(), itEnd=keyframeCounter.end(); it!=itEnd; it++)
+    for(vector<KeyFrame*>::const_iterator it=mvpVotingKeyFrames.begin(), itEnd=mvpVotingKeyFrames.end(); it!=itEnd; it++)
     {
-        KeyFrame* pKF = it->first;
+        KeyFrame* pKF = *it;
 
         if(pKF->isBad())
             continue;
 
-        if(it->second>max)
+        if(pKF->mnTrackVotes>max || (pKF->mnTrackVotes==max && less<KeyFrame*>()(pKF,pKFmax)))
         {
-            max=it->second;
+            max=pKF->mnTrackVotes;
             pKFmax=pKF;
         }
 
-        mvpLocalKeyFrames.push_back(it->first);
+        if(pKF->mnTrackReferenceForFrame!=mnLocalMapFrameId)
+            bCovered = false;
+    }
+
+    if(pKFmax)
+    {
+        mpReferenceKF = pKFmax;
+        mCurrentFrame.mpReferenceKF = mpReferenceKF;
+    }
+
+    // Keep the local map while its reference keyframe and the graph do not change
+    const unsigned long nGraphChangeIdx = mpMap->GetLastGraphChangeIdx();
+    if(bCovered && pKFmax==mpLocalMapReferenceKF && nGraphChangeIdx==mnLocalMapGraphChangeIdx)
+        return false;
+
+    mpLocalMapReferenceKF = pKFmax;
+    mnLocalMapGraphChangeIdx = nGraphChangeIdx;
+    mnLocalMapFrameId = mCurrentFrame.mnId;
+
+    mvpLocalKeyFrames.clear();
+    mvpLocalKeyFrames.reserve(3*mvpVotingKeyFrames.size());
+
+    // All keyframes that observe a map point are included in the local map
+    for(vector<KeyFrame*>::const_iterator it=mvpVotingKeyFrames.begin(), itEnd=mvpVotingKeyFrames.end(); it!=itEnd; it++)
+    {
+        KeyFrame* pKF = *it;
+
+        if(pKF->isBad())
+            continue;
+
+        mvpLocalKeyFrames.push_back(pKF);
         pKF->mnTrackReferenceForFrame = mCurrentFrame.mnId;
     }
 
+    // Same expansion order as a keyframe-ordered counter
+    sort(mvpLocalKeyFrames.begin(),mvpLocalKeyFrames.end(),less<KeyFrame*>());
 
     // Include also some not-already-included keyframes that are neighbors to already-included keyframes
     for(vector<KeyFrame*>::const_iterator itKF=mvpLocalKeyFrames.begin(), itEndKF=mvpLocalKeyFrames.end(); itKF!=itEndKF; itKF++)
@@ -1333,11 +1714,7 @@ void Tracking::UpdateLocalKeyFrames()
 
     }
 
-    if(pKFmax)
-    {
-        mpReferenceKF = pKFmax;
-        mCurrentFrame.mpReferenceKF = mpReferenceKF;
-    }
+    return true;
 }
 
 bool Tracking::Relocalization()
@@ -1345,64 +1722,124 @@ bool Tracking::Relocalization()
     // Compute Bag of Words Vector
     mCurrentFrame.ComputeBoW();
 
-    // Relocalization is performed when tracking is lost
-    // Track Lost: Query KeyFrame Database for keyframe candidates for relocalisation
-    vector<KeyFrame*> vpCandidateKFs = mpKeyFrameDB->DetectRelocalizationCandidates(&mCurrentFrame);
+    bool bMatch = false;
+
+    if(mfRelocalizationBudget<=0)
+    {
+        // Relocalization is performed when tracking is lost
+        // Track Lost: Query KeyFrame Database for keyframe candidates for relocalisation
+        vector<KeyFrame*> vpCandidateKFs = mpKeyFrameDB->DetectRelocalizationCandidates(&mCurrentFrame);
+        bMatch = RelocalizeWithCandidates(vpCandidateKFs);
+    }
+    else
+    {
+        const chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
 
+        // Query again when all candidates have been checked or the previous frame did not relocalize
+        if(mnNextRelocCandidate>=mvpRelocCandidates.size() || mCurrentFrame.mnId!=mnLastRelocAttemptFrameId+1)
+        {
+            mvpRelocCandidates = mpKeyFrameDB->DetectRelocalizationCandidates(&mCurrentFrame,true);
+            mnNextRelocCandidate = 0;
+        }
+        mnLastRelocAttemptFrameId = mCurrentFrame.mnId;
+
+        // Best candidates first, as many at a time as threads. At least one batch is checked per frame.
+        const size_t nBatch = mpTrackingPool ? mpTrackingPool->GetNumThreads() : 1;
+        do
+        {
+            if(mnNextRelocCandidate>=mvpRelocCandidates.size())
+                break;
+
+            const size_t nEnd = min(mnNextRelocCandidate+nBatch,mvpRelocCandidates.size());
+            vector<KeyFrame*> vpBatch(mvpRelocCandidates.begin()+mnNextRelocCandidate,mvpRelocCandidates.begin()+nEnd);
+            mnNextRelocCandidate = nEnd;
+
+            bMatch = RelocalizeWithCandidates(vpBatch);
+        }
+        while(!bMatch && chrono::duration_cast<chrono::duration<float,milli> >(chrono::steady_clock::now()-t0).count()<mfRelocalizationBudget);
+
+        if(bMatch)
+            mvpRelocCandidates.clear();
+    }
+
+    if(!bMatch)
+    {
+        mCurrentFrame.mTcw = cv::Mat::zeros(0, 0, CV_32F); // set mTcw back to empty if relocation is failed
+        return false;
+    }
+    else
+    {
+        mnLastRelocFrameId = mCurrentFrame.mnId;
+        return true;
+    }
+}
+
+bool Tracking::RelocalizeWithCandidates(const vector<KeyFrame*> &vpCandidateKFs)
+{
     if(vpCandidateKFs.empty())
         return false;
 
     const int nKFs = vpCandidateKFs.size();
 
+    // Candidates are processed on the tracking pool if there is one
+    auto forEachCandidate = [&](const function<void(int)> &f)
+    {
+        if(mpTrackingPool)
+            mpTrackingPool->ParallelFor(nKFs,f);
+        else
+            for(int i=0; i<nKFs; i++)
+                f(i);
+    };
+
     // We perform first an ORB matching with each candidate
     // If enough matches are found we setup a PnP solver
-    ORBmatcher matcher(0.75,true);
-
-    vector<PnPsolver*> vpPnPsolvers;
-    vpPnPsolvers.resize(nKFs);
+    vector<vector<MapPoint*> > vvpMapPointMatches(nKFs);
+    vector<unsigned char> vbDiscarded(nKFs,1);
 
-    vector<vector<MapPoint*> > vvpMapPointMatches;
-    vvpMapPointMatches.resize(nKFs);
+    forEachCandidate([&](int i)
+    {
+        KeyFrame* pKF = vpCandidateKFs[i];
+        if(pKF->isBad())
+            return;
 
-    vector<bool> vbDiscarded;
-    vbDiscarded.resize(nKFs);
+        ORBmatcher matcher(0.75,true);
+        int nmatches = matcher.SearchByBoW(pKF,mCurrentFrame,vvpMapPointMatches[i]);
+        if(nmatches>=15)
+            vbDiscarded[i] = 0;
+    });
 
+    vector<PnPsolver*> vpPnPsolvers(nKFs,static_cast<PnPsolver*>(NULL));
     int nCandidates=0;
 
     for(int i=0; i<nKFs; i++)
     {
-        KeyFrame* pKF = vpCandidateKFs[i];
-        if(pKF->isBad())
-            vbDiscarded[i] = true;
-        else
-        {
-            int nmatches = matcher.SearchByBoW(pKF,mCurrentFrame,vvpMapPointMatches[i]);
-            if(nmatches<15)
-            {
-                vbDiscarded[i] = true;
-                continue;
-            }
-            else
-            {
-                PnPsolver* pSolver = new PnPsolver(mCurrentFrame,vvpMapPointMatches[i]);
-                pSolver->SetRansacParameters(0.99,10,300,4,0.5,5.991);
-                vpPnPsolvers[i] = pSolver;
-                nCandidates++;
-            }
-        }
+        if(vbDiscarded[i])
+            continue;
+
+        PnPsolver* pSolver = new PnPsolver(mCurrentFrame,vvpMapPointMatches[i]);
+        pSolver->SetRansacParameters(0.99,10,300,4,0.5,5.991);
+        vpPnPsolvers[i] = pSolver;
+        nCandidates++;
     }
 
-    // Alternatively perform some iterations of P4P RANSAC
+    // Alternatively perform some iterations of P4P RANSAC on every candidate
     // Until we found a camera pose supported by enough inliers
-    bool bMatch = false;
-    ORBmatcher matcher2(0.9,true);
+    int nMatchedKF = -1;
+
+    // Each candidate optimizes its hypotheses on its own copy of the frame, made once.
+    // Only the pose and the matches change between rounds.
+    vector<Frame> vFrames(nKFs);
+    vector<unsigned char> vbFrameCopied(nKFs,0);
+    vector<int> vnInliers(nKFs);
 
-    while(nCandidates>0 && !bMatch)
+    while(nCandidates>0 && nMatchedKF<0)
     {
-        for(int i=0; i<nKFs; i++)
+        fill(vnInliers.begin(),vnInliers.end(),0);
+
+        forEachCandidate([&](int i)
         {
             if(vbDiscarded[i])
-                continue;
+                return;
 
             // Perform 5 Ransac Iterations
             vector<bool> vbInliers;
@@ -1414,98 +1851,133 @@ bool Tracking::Relocalization()
 
             // If Ransac reachs max. iterations discard keyframe
             if(bNoMore)
+                vbDiscarded[i]=1;
+
+            // If a Camera Pose is computed, optimize on the copy of the frame
+            if(!Tcw.empty())
             {
-                vbDiscarded[i]=true;
-                nCandidates--;
+                Frame &F = vFrames[i];
+                if(!vbFrameCopied[i])
+                {
+                    F = Frame(mCurrentFrame);
+                    vbFrameCopied[i] = 1;
+                }
+                else
+                {
+                    F.mTcw = cv::Mat();
+                    F.mvpMapPoints = mCurrentFrame.mvpMapPoints;
+                    F.mvbOutlier = mCurrentFrame.mvbOutlier;
+                }
+
+                vnInliers[i] = CheckRelocalizationPose(F,vpCandidateKFs[i],Tcw,vbInliers,vvpMapPointMatches[i]);
             }
+        });
 
-            // If a Camera Pose is computed, optimize
-            if(!Tcw.empty())
+        // If a pose is supported by enough inliers stop ransacs and continue. The first candidate
+        // in order is taken, as in the sequential search, whatever the number of threads.
+        for(int i=0; i<nKFs; i++)
+        {
+            if(vnInliers[i]>=50)
             {
-                Tcw.copyTo(mCurrentFrame.mTcw);
+                nMatchedKF = i;
+                break;
+            }
+        }
 
-                set<MapPoint*> sFound;
+        nCandidates = 0;
+        for(int i=0; i<nKFs; i++)
+            if(!vbDiscarded[i])
+                nCandidates++;
+    }
 
-                const int np = vbInliers.size();
+    for(int i=0; i<nKFs; i++)
+        delete vpPnPsolvers[i];
 
-                for(int j=0; j<np; j++)
-                {
-                    if(vbInliers[j])
-                    {
-                        mCurrentFrame.mvpMapPoints[j]=vvpMapPointMatches[i][j];
-                        sFound.insert(vvpMapPointMatches[i][j]);
-                    }
-                    else
-                        mCurrentFrame.mvpMapPoints[j]=NULL;
-                }
+    if(nMatchedKF<0)
+        return false;
 
-                int nGood = Optimizer::PoseOptimization(&mCurrentFrame);
+    const Frame &F = vFrames[nMatchedKF];
+    mCurrentFrame.SetPose(F.mTcw);
+    mCurrentFrame.mvpMapPoints = F.mvpMapPoints;
+    mCurrentFrame.mvbOutlier = F.mvbOutlier;
 
-                if(nGood<10)
-                    continue;
+    return true;
+}
 
-                for(int io =0; io<mCurrentFrame.N; io++)
-                    if(mCurrentFrame.mvbOutlier[io])
-                        mCurrentFrame.mvpMapPoints[io]=static_cast<MapPoint*>(NULL);
+int Tracking::CheckRelocalizationPose(Frame &F, KeyFrame* pKF, const cv::Mat &Tcw, const vector<bool> &vbInliers,
+                                      const vector<MapPoint*> &vpMapPointMatches)
+{
+    ORBmatcher matcher2(0.9,true);
 
-                // If few inliers, search by projection in a coarse window and optimize again
-                if(nGood<50)
-                {
-                    int nadditional =matcher2.SearchByProjection(mCurrentFrame,vpCandidateKFs[i],sFound,10,100);
+    Tcw.copyTo(F.mTcw);
 
-                    if(nadditional+nGood>=50)
-                    {
-                        nGood = Optimizer::PoseOptimization(&mCurrentFrame);
+    set<MapPoint*> sFound;
 
-                        // If many inliers but still not enough, search by projection again in a narrower window
-                        // the camera has been already optimized with many points
-                        if(nGood>30 && nGood<50)
-                        {
-                            sFound.clear();
-                            for(int ip =0; ip<mCurrentFrame.N; ip++)
-                                if(mCurrentFrame.mvpMapPoints[ip])
-                                    sFound.insert(mCurrentFrame.mvpMapPoints[ip]);
-                            nadditional =matcher2.SearchByProjection(mCurrentFrame,vpCandidateKFs[i],sFound,3,64);
-
-                            // Final optimization
-                            if(nGood+nadditional>=50)
-                            {
-                                nGood = Optimizer::PoseOptimization(&mCurrentFrame);
+    const int np = vbInliers.size();
 
-                                for(int io =0; io<mCurrentFrame.N; io++)
-                                    if(mCurrentFrame.mvbOutlier[io])
-                                        mCurrentFrame.mvpMapPoints[io]=NULL;
-                            }
-                        }
-                    }
-                }
+    for(int j=0; j<np; j++)
+    {
+        if(vbInliers[j])
+        {
+            F.mvpMapPoints[j]=vpMapPointMatches[j];
+            sFound.insert(vpMapPointMatches[j]);
+        }
+        else
+            F.mvpMapPoints[j]=NULL;
+    }
+
+    int nGood = Optimizer::PoseOptimization(&F);
 
+    if(nGood<10)
+        return nGood;
+
+    for(int io =0; io<F.N; io++)
+        if(F.mvbOutlier[io])
+            F.mvpMapPoints[io]=static_cast<MapPoint*>(NULL);
+
+    // If few inliers, search by projection in a coarse window and optimize again
+    if(nGood<50)
+    {
+        int nadditional =matcher2.SearchByProjection(F,pKF,sFound,10,100);
+
+        if(nadditional+nGood>=50)
+        {
+            nGood = Optimizer::PoseOptimization(&F);
 
-                // If the pose is supported by enough inliers stop ransacs and continue
-                if(nGood>=50)
+            // If many inliers but still not enough, search by projection again in a narrower window
+            // the camera has been already optimized with many points
+            if(nGood>30 && nGood<50)
+            {
+                sFound.clear();
+                for(int ip =0; ip<F.N; ip++)
+                    if(F.mvpMapPoints[ip])
+                        sFound.insert(F.mvpMapPoints[ip]);
+                nadditional =matcher2.SearchByProjection(F,pKF,sFound,3,64);
+
+                // Final optimization
+                if(nGood+nadditional>=50)
                 {
-                    bMatch = true;
-                    break;
+                    nGood = Optimizer::PoseOptimization(&F);
+
+                    for(int io =0; io<F.N; io++)
+                        if(F.mvbOutlier[io])
+                            F.mvpMapPoints[io]=NULL;
                 }
             }
         }
     }
 
-    if(!bMatch)
-    {
-        mCurrentFrame.mTcw = cv::Mat::zeros(0, 0, CV_32F); // set mTcw back to empty if relocation is failed
-        return false;
-    }
-    else
-    {
-        mnLastRelocFrameId = mCurrentFrame.mnId;
-        return true;
-    }
-
+    return nGood;
 }
 
 void Tracking::Reset()
 {
+    // Frames being built were set up for the state before the reset
+    if(mpPipeline)
+    {
+        mpPipeline->Clear();
+        mdLastSubmittedTimestamp = -numeric_limits<double>::max();
+    }
 
     cout << "System Reseting" << endl;
     if(mpViewer)
@@ -1550,6 +2022,12 @@ void Tracking::Reset()
     mlFrameTimes.clear();
     mlbLost.clear();
 
+    mpLocalMapReferenceKF = static_cast<KeyFrame*>(NULL);
+    mvpRelocCandidates.clear();
+    mVelocity = cv::Mat();
+    mLastVelocity = cv::Mat();
+    mfPredictionError = 0;
+
     if(mpViewer)
         mpViewer->Release();
 }
@@ -1588,12 +2066,22 @@ std::this_thread::sleep_for(std::chrono::microseconds(3000));
     mlFrameTimes.clear();
     mlbLost.clear();
 
+    mpLocalMapReferenceKF = static_cast<KeyFrame*>(NULL);
+    mvpRelocCandidates.clear();
+    mVelocity = cv::Mat();
+    mLastVelocity = cv::Mat();
+    mfPredictionError = 0;
+
     if(mpViewer)
         mpViewer->Release();
 }
 
 void Tracking::ChangeCalibration(const string &strSettingPath)
 {
+    // Queued frames were built with the previous calibration and read its undistortion table
+    if(mpPipeline)
+        while(TrackNextFrame(false));
+
     cv::FileStorage fSettings(strSettingPath, cv::FileStorage::READ);
     float fx = fSettings["Camera.fx"];
     float fy = fSettings["Camera.fy"];
@@ -1623,6 +2111,7 @@ void Tracking::ChangeCalibration(const string &strSettingPath)
     mbf = fSettings["Camera.bf"];
 
     Frame::mbInitialComputations = true;
+    Frame::mUndistortionMap.Clear();
 }
 
 void Tracking::InformOnlyTracking(const bool &flag)
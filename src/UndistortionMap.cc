@@ -0,0 +1,160 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "UndistortionMap.h"
+
+#include <algorithm>
+#include <cmath>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+namespace ORB_SLAM2
+{
+
+UndistortionMap::UndistortionMap():
+    mnCols(0), mnRows(0)
+{
+}
+
+void UndistortionMap::Build(const cv::Mat &K, const cv::Mat &distCoef, const cv::Size &imSize)
+{
+    mImSize = imSize;
+    mnCols = (imSize.width+GRID_STEP-1)/GRID_STEP+1;
+    mnRows = (imSize.height+GRID_STEP-1)/GRID_STEP+1;
+
+    cv::Mat mat(mnCols*mnRows,2,CV_32F);
+    for(int r=0; r<mnRows; r++)
+        for(int c=0; c<mnCols; c++)
+        {
+            mat.at<float>(r*mnCols+c,0)=c*GRID_STEP;
+            mat.at<float>(r*mnCols+c,1)=r*GRID_STEP;
+        }
+
+    mat=mat.reshape(2);
+    cv::undistortPoints(mat,mat,K,distCoef,cv::Mat(),K);
+    mat=mat.reshape(1);
+
+    mvMapX.resize(mnCols*mnRows);
+    mvMapY.resize(mnCols*mnRows);
+    for(int i=0; i<mnCols*mnRows; i++)
+    {
+        mvMapX[i]=mat.at<float>(i,0);
+        mvMapY[i]=mat.at<float>(i,1);
+    }
+}
+
+void UndistortionMap::Clear()
+{
+    mvMapX.clear();
+    mvMapY.clear();
+    mnCols = mnRows = 0;
+}
+
+cv::Point2f UndistortionMap::Undistort(const float x, const float y) const
+{
+    const float gx = x*(1.0f/GRID_STEP);
+    const float gy = y*(1.0f/GRID_STEP);
+    const int c = min(max((int)floor(gx),0),mnCols-2);
+    const int r = min(max((int)floor(gy),0),mnRows-2);
+    const float ax = gx-c;
+    const float ay = gy-r;
+
+    const int i = r*mnCols+c;
+    const float* pX = &mvMapX[i];
+    const float* pY = &mvMapY[i];
+
+    const float x0 = pX[0]+ax*(pX[1]-pX[0]);
+    const float x1 = pX[mnCols]+ax*(pX[mnCols+1]-pX[mnCols]);
+    const float y0 = pY[0]+ax*(pY[1]-pY[0]);
+    const float y1 = pY[mnCols]+ax*(pY[mnCols+1]-pY[mnCols]);
+
+    return cv::Point2f(x0+ay*(x1-x0),y0+ay*(y1-y0));
+}
+
+void UndistortionMap::Undistort(const vector<cv::KeyPoint> &vKeys, vector<cv::KeyPoint> &vKeysUn) const
+{
+    vKeysUn = vKeys;
+
+    const int N = vKeys.size();
+    int i=0;
+
+#ifdef __AVX2__
+    // Eight keypoints at a time, coordinates and table nodes are gathered
+    const int stride = sizeof(cv::KeyPoint)/sizeof(float);
+    const __m256i vStride = _mm256_mullo_epi32(_mm256_setr_epi32(0,1,2,3,4,5,6,7),_mm256_set1_epi32(stride));
+    const __m256 vInvStep = _mm256_set1_ps(1.0f/GRID_STEP);
+    const __m256i vMaxC = _mm256_set1_epi32(mnCols-2);
+    const __m256i vMaxR = _mm256_set1_epi32(mnRows-2);
+    const __m256i vZero = _mm256_setzero_si256();
+    const __m256i vCols = _mm256_set1_epi32(mnCols);
+    const __m256i vOne = _mm256_set1_epi32(1);
+
+    for(; i+8<=N; i+=8)
+    {
+        const float* pPts = &vKeys[i].pt.x;
+        const __m256 x = _mm256_i32gather_ps(pPts,vStride,4);
+        const __m256 y = _mm256_i32gather_ps(pPts+1,vStride,4);
+
+        const __m256 gx = x*vInvStep;
+        const __m256 gy = y*vInvStep;
+        const __m256i c = _mm256_min_epi32(_mm256_max_epi32(_mm256_cvttps_epi32(_mm256_floor_ps(gx)),vZero),vMaxC);
+        const __m256i r = _mm256_min_epi32(_mm256_max_epi32(_mm256_cvttps_epi32(_mm256_floor_ps(gy)),vZero),vMaxR);
+        const __m256 ax = gx-_mm256_cvtepi32_ps(c);
+        const __m256 ay = gy-_mm256_cvtepi32_ps(r);
+
+        const __m256i i00 = _mm256_add_epi32(_mm256_mullo_epi32(r,vCols),c);
+        const __m256i i01 = _mm256_add_epi32(i00,vOne);
+        const __m256i i10 = _mm256_add_epi32(i00,vCols);
+        const __m256i i11 = _mm256_add_epi32(i10,vOne);
+
+        const float* pX = &mvMapX[0];
+        const float* pY = &mvMapY[0];
+        const __m256 px00 = _mm256_i32gather_ps(pX,i00,4), px01 = _mm256_i32gather_ps(pX,i01,4);
+        const __m256 px10 = _mm256_i32gather_ps(pX,i10,4), px11 = _mm256_i32gather_ps(pX,i11,4);
+        const __m256 py00 = _mm256_i32gather_ps(pY,i00,4), py01 = _mm256_i32gather_ps(pY,i01,4);
+        const __m256 py10 = _mm256_i32gather_ps(pY,i10,4), py11 = _mm256_i32gather_ps(pY,i11,4);
+
+        // Same operations as the scalar path, so that both give the same values
+        const __m256 x0 = px00+ax*(px01-px00);
+        const __m256 x1 = px10+ax*(px11-px10);
+        const __m256 y0 = py00+ax*(py01-py00);
+        const __m256 y1 = py10+ax*(py11-py10);
+
+        alignas(32) float ux[8], uy[8];
+        _mm256_store_ps(ux,x0+ay*(x1-x0));
+        _mm256_store_ps(uy,y0+ay*(y1-y0));
+        for(int k=0; k<8; k++)
+        {
+            vKeysUn[i+k].pt.x = ux[k];
+            vKeysUn[i+k].pt.y = uy[k];
+        }
+    }
+#endif
+
+    for(; i<N; i++)
+        vKeysUn[i].pt = Undistort(vKeys[i].pt.x,vKeys[i].pt.y);
+}
+
+} //namespace ORB_SLAM